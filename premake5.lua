@@ -33,6 +33,40 @@ function default_build_options()
     filter {}
 end
 
+newoption {
+    trigger = "vm-dispatch",
+    value = "STRATEGY",
+    description = "Instruction dispatch strategy used by the interpreter loop",
+    default = "goto",
+    allowed = {
+        { "switch", "Portable switch statement" },
+        { "goto", "Computed goto (GCC/Clang, falls back to switch elsewhere)" },
+        { "tailcall", "Handler per opcode chained with [[clang::musttail]] (Clang only)" },
+    }
+}
+
+newoption {
+    trigger = "vm-profile-pairs",
+    description = "Count the opcode pairs the interpreter runs, for 'wfbench pairs'. Slows every instruction down",
+}
+
+function vm_dispatch_config()
+    filter { "options:vm-dispatch=goto", "toolset:gcc or clang" }
+        defines { "WF_VM_DISPATCH_COMPUTED_GOTO" }
+
+    -- Keep GCC from merging the per-handler dispatch jumps back into a single shared one.
+    filter { "options:vm-dispatch=goto", "toolset:gcc", "files:**/Vm/Vm.cpp" }
+        buildoptions { "-fno-crossjumping" }
+
+    filter { "options:vm-dispatch=tailcall", "toolset:clang" }
+        defines { "WF_VM_DISPATCH_TAIL_CALL" }
+
+    filter { "options:vm-profile-pairs" }
+        defines { "WF_VM_PROFILE_PAIRS" }
+
+    filter {}
+end
+
 workspace "windflower-lang"
     configurations { "Debug", "Release", "Dist" }
 
@@ -48,6 +82,7 @@ project "windflower"
         "%{prj.name}/include/**.hpp",
         "%{prj.name}/src/**.hpp",
         "%{prj.name}/src/**.cpp",
+        "%{prj.name}/src/**.inl",
     }
 
     includedirs {
@@ -61,6 +96,7 @@ project "windflower"
 
     defines { "FMT_HEADER_ONLY" }
 
+    vm_dispatch_config()
     default_build_options()
     default_config_info()
 
@@ -87,3 +123,61 @@ project "wftool"
 
     default_build_options()
     default_config_info()
+
+-- Ahead-of-time compiler, translates scripts into C++ that is linked into the host application
+-- together with the windflower library.
+project "wfc"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+
+    targetdir "bin/%{cfg.buildcfg}"
+    objdir "obj/%{cfg.buildcfg}/%{prj.name}"
+
+    files {
+        "%{prj.name}/src/**.hpp",
+        "%{prj.name}/src/**.cpp",
+    }
+
+    externalincludedirs {
+        "windflower/include"
+    }
+
+    links {
+        "windflower"
+    }
+
+    default_build_options()
+    default_config_info()
+
+-- Benchmarks of the library internals, built against its private headers.
+project "wfbench"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+
+    targetdir "bin/%{cfg.buildcfg}"
+    objdir "obj/%{cfg.buildcfg}/%{prj.name}"
+
+    files {
+        "%{prj.name}/src/**.hpp",
+        "%{prj.name}/src/**.cpp",
+    }
+
+    includedirs {
+        "windflower/src"
+    }
+
+    externalincludedirs {
+        "windflower/include",
+        "windflower/vendor/fmt-9.1.0/include",
+    }
+
+    defines { "FMT_HEADER_ONLY" }
+
+    links {
+        "windflower"
+    }
+
+    default_build_options()
+    default_config_info()
@@ -0,0 +1,422 @@
+#include "Compiler/Tokenizer.hpp"
+#include "Vm/OpcodeProfile.hpp"
+#include "Vm/Peephole.hpp"
+#include "Windflower/Windflower.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+// Benchmarks for the windflower internals. They link against the library's private headers, so they
+// always measure the code in this tree.
+//
+// usage: wfbench tokenizer [script.wf]
+//        wfbench expressions [term count]
+//        wfbench peephole script.wf...
+//        wfbench pairs script.wf...
+//        wfbench batch script.wf [row count]
+namespace wfbench
+{
+    using Clock = std::chrono::steady_clock;
+
+    class MallocAllocator : public wf::Allocator
+    {
+    public:
+        void* operator()(void* buffer, std::size_t old_size, std::size_t new_size) noexcept final
+        {
+            (void)old_size;
+            if(new_size == 0)
+            {
+                std::free(buffer);
+                return nullptr;
+            }
+            return std::realloc(buffer, new_size);
+        }
+    };
+
+    std::string read_file(const std::string& path)
+    {
+        std::ifstream file(path);
+        if(!file.is_open())
+        {
+            std::cerr << "Could not open file '" << path << "'.\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        std::ostringstream file_text_stream;
+        file_text_stream << file.rdbuf();
+        return file_text_stream.str();
+    }
+
+    // About 16 MiB of declarations, arithmetic and comments.
+    std::string generate_source()
+    {
+        std::string source;
+        for(std::size_t i = 0; source.size() < 16 * 1024 * 1024; i++)
+        {
+            const std::string name = "variable_" + std::to_string(i);
+            source += "var " + name + ": Int := " + std::to_string(i * 7919) + "\n";
+            source += "var scaled_" + name + " := (" + name + " * 3 + 12) % 17 - 2.25 / 4.0\n";
+            source += "-- running total for " + name + "\n";
+            source += "\treturn   " + name + " + scaled_" + name + "\n";
+        }
+        return source;
+    }
+
+    int run_tokenizer(const std::string& source)
+    {
+        constexpr int ITERATIONS = 10;
+
+        double best_seconds = 0.0;
+        std::size_t token_count = 0;
+        for(int i = 0; i < ITERATIONS; i++)
+        {
+            wf::Tokenizer tokenizer(source);
+            tokenizer.set_newline_ignore(false);
+
+            token_count = 0;
+            const Clock::time_point start = Clock::now();
+            while(tokenizer.next().get_type() != wf::Token::Type::TT_EOF)
+            {
+                token_count++;
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            if(i == 0 || seconds < best_seconds) best_seconds = seconds;
+        }
+
+        const double megabytes = static_cast<double>(source.size()) / (1024.0 * 1024.0);
+        std::cout << "tokenizer: " << megabytes << " MiB, " << token_count << " tokens, "
+            << megabytes / best_seconds << " MiB/s, "
+            << static_cast<double>(token_count) / best_seconds / 1e6 << " Mtokens/s (best of " << ITERATIONS << ")\n";
+        return EXIT_SUCCESS;
+    }
+
+    enum class ExpressionShape
+    {
+        // x + 1 - y * 2 + ..., which nests to the left.
+        CHAIN,
+        // x + (y - (x + ...)), which nests to the right through parentheses.
+        NESTED,
+        // - - - ... x
+        NEGATIONS,
+    };
+
+    std::string generate_expression(ExpressionShape shape, std::size_t term_count)
+    {
+        static constexpr std::string_view OPERATORS[] = { " + ", " - ", " * " };
+
+        std::string source = "var x: Int := 3\nvar y: Int := 4\nreturn ";
+        for(std::size_t i = 0; i < term_count; i++)
+        {
+            const bool is_last = i + 1 == term_count;
+            const std::string_view op = OPERATORS[i % 3];
+            switch(shape)
+            {
+                case ExpressionShape::CHAIN:
+                    source += i % 2 == 0? "x" : std::to_string(i % 9 + 1);
+                    if(!is_last) source += op;
+                    break;
+                case ExpressionShape::NESTED:
+                    source += i % 2 == 0? "x" : "y";
+                    if(!is_last)
+                    {
+                        source += op;
+                        source += "(";
+                    }
+                    break;
+                case ExpressionShape::NEGATIONS:
+                    source += is_last? "x" : "- ";
+                    break;
+            }
+        }
+        if(shape == ExpressionShape::NESTED) source.append(term_count - 1, ')');
+        source += "\n";
+        return source;
+    }
+
+    // Compiles and runs the expression, returning the compile time in seconds or a negative value on failure.
+    double compile_expression(const std::string& source, std::uint32_t optimization_level)
+    {
+        MallocAllocator allocator;
+        wf::EnvironmentCreateInfo create_info = {
+            .allocator = &allocator
+        };
+
+        wf::Environment env(create_info);
+        env.reserve(2);
+
+        const Clock::time_point start = Clock::now();
+        if(!env.compile(0, { .name = "bench", .source = source, .optimization_level = optimization_level }))
+        {
+            std::cerr << env.get_string(0) << "\n";
+            return -1.0;
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        env.call(0, 1);
+        return seconds;
+    }
+
+    // Expressions nested as deep as they are long must compile without exhausting the native stack, in time
+    // linear in their size, with and without the optimizer. Each shape is compiled at a quarter and at the full
+    // term count, so a growing ns/term exposes superlinear passes.
+    int run_expressions(std::size_t term_count)
+    {
+        static constexpr std::pair<ExpressionShape, std::string_view> SHAPES[] = {
+            { ExpressionShape::CHAIN, "chain" },
+            { ExpressionShape::NESTED, "nested" },
+            { ExpressionShape::NEGATIONS, "negations" },
+        };
+
+        for(const auto& [shape, name] : SHAPES)
+        {
+            for(const std::uint32_t optimization_level : { 0u, 1u })
+            {
+                std::cout << "expressions " << name << " O" << optimization_level << ":";
+                for(const std::size_t terms : { term_count / 4, term_count })
+                {
+                    const double seconds = compile_expression(generate_expression(shape, terms), optimization_level);
+                    if(seconds < 0.0) return EXIT_FAILURE;
+
+                    std::cout << " " << terms << " terms " << seconds * 1e3 << " ms ("
+                        << seconds * 1e9 / static_cast<double>(terms) << " ns/term)";
+                }
+                std::cout << "\n";
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Shows which peephole rules match the code Environment::compile generates for a corpus of scripts, and how
+    // much code they remove. The pass only runs at optimization level 1 and above.
+    int run_peephole(std::span<const char* const> paths)
+    {
+        MallocAllocator allocator;
+        wf::PeepholeProfile& profile = wf::PeepholeProfile::get();
+        for(const bool fast_math : { false, true })
+        {
+            profile.reset();
+            for(const char* path : paths)
+            {
+                const std::string source = read_file(path);
+                wf::Environment env({ .allocator = &allocator });
+                env.reserve(1);
+                if(!env.compile(0, { .name = path, .source = source, .optimization_level = 1, .fast_math = fast_math }))
+                {
+                    std::cerr << env.get_string(0) << "\n";
+                    return EXIT_FAILURE;
+                }
+            }
+
+            std::cout << "peephole O1" << (fast_math? " fast-math" : "") << ": " << paths.size() << " scripts, "
+                << profile.get_code_size_before() << " -> " << profile.get_code_size_after() << " instructions\n";
+            for(std::size_t i = 0; i < profile.get_hit_counts().size(); i++)
+            {
+                std::cout << "    " << wf::get_peephole_rules()[i].name << ": " << profile.get_hit_counts()[i] << "\n";
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Prints the opcode pairs the interpreter ran most often while running each script once, the histogram that
+    // superinstructions are chosen from. Needs a library built with the "vm-profile-pairs" premake option.
+    int run_pairs(std::span<const char* const> paths)
+    {
+        constexpr std::size_t SHOWN_PAIR_COUNT = 20;
+
+        if(!wf::OpcodePairProfile::is_enabled())
+        {
+            std::cerr << "The library was built without opcode pair profiling, see premake5 --vm-profile-pairs.\n";
+            return EXIT_FAILURE;
+        }
+
+        MallocAllocator allocator;
+        wf::OpcodePairProfile& profile = wf::OpcodePairProfile::get();
+        for(const std::uint32_t optimization_level : { 0u, 1u })
+        {
+            profile.reset();
+            for(const char* path : paths)
+            {
+                const std::string source = read_file(path);
+                wf::Environment env({ .allocator = &allocator });
+                env.reserve(2);
+                if(!env.compile(0, { .name = path, .source = source, .optimization_level = optimization_level }))
+                {
+                    std::cerr << env.get_string(0) << "\n";
+                    return EXIT_FAILURE;
+                }
+
+                // Scripts that fail at runtime still count up to the failing instruction.
+                try
+                {
+                    env.call(0, 1);
+                }
+                catch(const std::exception&)
+                {
+                }
+            }
+
+            std::vector<std::pair<wf::Opcode, wf::Opcode>> pairs;
+            std::uint64_t total = 0;
+            for(std::size_t first = 0; first < wf::OPCODE_COUNT; first++)
+            {
+                for(std::size_t second = 0; second < wf::OPCODE_COUNT; second++)
+                {
+                    const std::pair pair = { wf::Opcode(static_cast<std::uint8_t>(first)),
+                        wf::Opcode(static_cast<std::uint8_t>(second)) };
+                    const std::uint64_t count = profile.get_count(pair.first, pair.second);
+                    if(count == 0) continue;
+
+                    pairs.push_back(pair);
+                    total += count;
+                }
+            }
+
+            std::sort(pairs.begin(), pairs.end(), [&](const auto& left, const auto& right) {
+                return profile.get_count(left.first, left.second) > profile.get_count(right.first, right.second);
+            });
+
+            std::cout << "pairs O" << optimization_level << ": " << paths.size() << " scripts, " << total
+                << " pairs run\n";
+            for(std::size_t i = 0; i < std::min(pairs.size(), SHOWN_PAIR_COUNT); i++)
+            {
+                const std::uint64_t count = profile.get_count(pairs[i].first, pairs[i].second);
+                std::cout << "    " << wf::get_opcode_name(pairs[i].first) << " " << wf::get_opcode_name(pairs[i].second)
+                    << ": " << count << " (" << 100.0 * static_cast<double>(count) / static_cast<double>(total)
+                    << "%)\n";
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+
+    template<typename T>
+    T get_result(wf::Environment& env, std::size_t idx)
+    {
+        if constexpr(std::is_same_v<T, wf::Float>) return env.get_float(idx);
+        else return env.get_int(idx);
+    }
+
+    // Runs the script once per row with call() and get(), the way hosts evaluate it without call_batch.
+    template<typename T>
+    double run_rows(wf::Environment& env, std::vector<T>& output)
+    {
+        const Clock::time_point start = Clock::now();
+        for(T& result : output)
+        {
+            env.call(0, 1);
+            result = get_result<T>(env, 1);
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    template<typename T>
+    int compare_batch(wf::Environment& env, wf::Environment& jit_env, std::size_t row_count)
+    {
+        std::vector<T> row_output(row_count);
+        std::vector<T> jit_row_output(row_count);
+        std::vector<T> batch_output(row_count);
+
+        const double row_seconds = run_rows(env, row_output);
+        const double jit_row_seconds = run_rows(jit_env, jit_row_output);
+
+        const Clock::time_point start = Clock::now();
+        env.call_batch(0, batch_output.data(), row_count);
+        const double batch_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        if(std::memcmp(row_output.data(), batch_output.data(), row_count * sizeof(T)) != 0
+            || std::memcmp(jit_row_output.data(), batch_output.data(), row_count * sizeof(T)) != 0)
+        {
+            std::cerr << "call_batch returned different results than call.\n";
+            return EXIT_FAILURE;
+        }
+
+        const double rows = static_cast<double>(row_count);
+        std::cout << "batch: " << row_count << " rows, call " << row_seconds * 1e9 / rows << " ns/row, call with jit "
+            << jit_row_seconds * 1e9 / rows << " ns/row, call_batch " << batch_seconds * 1e9 / rows << " ns/row ("
+            << row_seconds / batch_seconds << "x)\n";
+        return EXIT_SUCCESS;
+    }
+
+    // Compares call_batch against a loop calling the script once per row, with and without the JIT. Scripts cannot
+    // declare inputs yet, so every row computes the same value and only the cost of running the code is compared.
+    int run_batch(const std::string& path, std::size_t row_count)
+    {
+        const std::string source = read_file(path);
+        MallocAllocator allocator;
+        wf::Environment env({ .allocator = &allocator });
+        wf::Environment jit_env({ .allocator = &allocator, .enable_jit = true });
+
+        for(wf::Environment* environment : { &env, &jit_env })
+        {
+            environment->reserve(2);
+            if(!environment->compile(0, { .name = path, .source = source, .optimization_level = 1 }))
+            {
+                std::cerr << environment->get_string(0) << "\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        try
+        {
+            switch(env.get_bytecode_return_type(0))
+            {
+                case wf::TypeId::INT: return compare_batch<wf::Int>(env, jit_env, row_count);
+                case wf::TypeId::FLOAT: return compare_batch<wf::Float>(env, jit_env, row_count);
+                default:
+                    std::cerr << "The script must return an Int or a Float.\n";
+                    return EXIT_FAILURE;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    const std::string_view benchmark = argc > 1? argv[1] : "";
+    if(argc <= 3 && benchmark == "tokenizer")
+    {
+        const std::string source = argc == 3? wfbench::read_file(argv[2]) : wfbench::generate_source();
+        return wfbench::run_tokenizer(source);
+    }
+    if(argc <= 3 && benchmark == "expressions")
+    {
+        const std::size_t term_count = argc == 3? std::strtoull(argv[2], nullptr, 10) : 1000000;
+        if(term_count >= 4) return wfbench::run_expressions(term_count);
+    }
+    if(argc >= 3 && benchmark == "peephole")
+    {
+        return wfbench::run_peephole(std::span<const char* const>(argv + 2, static_cast<std::size_t>(argc - 2)));
+    }
+    if(argc >= 3 && benchmark == "pairs")
+    {
+        return wfbench::run_pairs(std::span<const char* const>(argv + 2, static_cast<std::size_t>(argc - 2)));
+    }
+
+    if((argc == 3 || argc == 4) && benchmark == "batch")
+    {
+        const std::size_t row_count = argc == 4? std::strtoull(argv[3], nullptr, 10) : 1000000;
+        if(row_count > 0) return wfbench::run_batch(argv[2], row_count);
+    }
+
+    std::cerr << "usage: wfbench tokenizer [script.wf]\n"
+        "       wfbench expressions [term count]\n"
+        "       wfbench peephole script.wf...\n"
+        "       wfbench pairs script.wf...\n"
+        "       wfbench batch script.wf [row count]\n";
+    return EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include <Windflower/Windflower.hpp>
+
+#include <cstdlib>
+#include <string>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+// Ahead-of-time compiler: translates a script into a C++ translation unit that registers itself with the
+// windflower library, so that Environment::call runs native code for that script.
+//
+// usage: wfc [-O<level>] [--fast-math] <script.wf> <output.cpp> <function name>
+//
+// The options mirror CompileInfo::optimization_level and CompileInfo::fast_math. The generated function only
+// replaces bytecode identical to the one compiled here, so they must match the settings the host compiles the
+// script with, otherwise the host keeps interpreting it.
+namespace wfc
+{
+    class MallocAllocator : public wf::Allocator
+    {
+    public:
+        void* operator()(void* buffer, std::size_t old_size, std::size_t new_size) noexcept final
+        {
+            (void)old_size;
+            if(new_size == 0)
+            {
+                std::free(buffer);
+                return nullptr;
+            }
+            return std::realloc(buffer, new_size);
+        }
+    };
+
+    std::string read_file(const std::string& path)
+    {
+        std::ifstream file(path);
+        if(!file.is_open())
+        {
+            std::cerr << "Could not open file '" << path << "'.\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        std::ostringstream file_text_stream;
+        file_text_stream << file.rdbuf();
+        return file_text_stream.str();
+    }
+
+    bool is_identifier(std::string_view name)
+    {
+        if(name.empty() || (name[0] >= '0' && name[0] <= '9')) return false;
+
+        for(char c : name)
+        {
+            const bool is_alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+            const bool is_digit = c >= '0' && c <= '9';
+            if(!is_alpha && !is_digit && c != '_') return false;
+        }
+        return true;
+    }
+
+    bool parse_option(std::string_view option, wf::CompileInfo& compile_info)
+    {
+        if(option == "--fast-math")
+        {
+            compile_info.fast_math = true;
+            return true;
+        }
+
+        if(!option.starts_with("-O") || option.size() == 2) return false;
+        std::uint32_t level = 0;
+        for(char c : option.substr(2))
+        {
+            if(c < '0' || c > '9' || level > 9999) return false;
+            level = level * 10 + static_cast<std::uint32_t>(c - '0');
+        }
+        compile_info.optimization_level = level;
+        return true;
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    wf::CompileInfo compile_info;
+    int argument = 1;
+    for(; argument < argc && argv[argument][0] == '-'; argument++)
+    {
+        if(!wfc::parse_option(argv[argument], compile_info))
+        {
+            std::cerr << "Unknown option '" << argv[argument] << "'.\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(argc - argument != 3)
+    {
+        std::cerr << "usage: wfc [-O<level>] [--fast-math] <script.wf> <output.cpp> <function name>\n";
+        return EXIT_FAILURE;
+    }
+
+    const std::string input_path = argv[argument];
+    const std::string output_path = argv[argument + 1];
+    const std::string_view function_name = argv[argument + 2];
+
+    if(!wfc::is_identifier(function_name))
+    {
+        std::cerr << "'" << function_name << "' is not a valid C++ identifier.\n";
+        return EXIT_FAILURE;
+    }
+
+    wfc::MallocAllocator allocator;
+
+    wf::EnvironmentCreateInfo create_info = {
+        .allocator = &allocator
+    };
+
+    wf::Environment env(create_info);
+    env.reserve(2);
+
+    const std::string source = wfc::read_file(input_path);
+    compile_info.name = input_path;
+    compile_info.source = source;
+
+    if(!env.compile(0, compile_info))
+    {
+        std::cerr << "Could not compile file '" << input_path << "'.\n";
+        std::cerr << env.get_string(0) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    if(!env.transpile_bytecode(1, 0, function_name))
+    {
+        std::cerr << "Could not translate file '" << input_path << "'.\n";
+        std::cerr << env.get_string(1) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream output(output_path);
+    output << env.get_string(1);
+    if(!output)
+    {
+        std::cerr << "Could not write file '" << output_path << "'.\n";
+        return EXIT_FAILURE;
+    }
+}
\ No newline at end of file
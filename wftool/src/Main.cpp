@@ -1,12 +1,21 @@
 #include <Windflower/Windflower.hpp>
 
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <memory>
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
 namespace wftool
 {
     class MallocAllocator : public wf::Allocator
@@ -28,7 +37,7 @@ namespace wftool
     {
         std::string file_text;
         {
-            std::ifstream file(path);
+            std::ifstream file{ std::string(path) };
             if(!file.is_open())
             {
                 std::cerr << "Could not open file '" << path << "'.\n";
@@ -54,6 +63,85 @@ namespace wftool
         }
     }
 
+    // Read-only view of a whole file, mapped where the platform allows so that bytecode runs straight from it.
+    class FileView
+    {
+    public:
+        FileView(std::string_view path)
+        {
+#if !defined(_WIN32)
+            const int file = open(std::string(path).c_str(), O_RDONLY);
+            struct stat file_stat;
+            if(file >= 0 && fstat(file, &file_stat) == 0 && file_stat.st_size > 0)
+            {
+                m_size = static_cast<std::size_t>(file_stat.st_size);
+                void* memory = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+                m_data = memory == MAP_FAILED? nullptr : static_cast<const std::byte*>(memory);
+            }
+            if(file >= 0) close(file);
+#else
+            std::ifstream file(std::string(path), std::ios::binary | std::ios::ate);
+            if(file.is_open())
+            {
+                m_size = static_cast<std::size_t>(file.tellg());
+                // Bytecode must be 8 byte aligned.
+                m_buffer = std::make_unique<std::uint64_t[]>(m_size / 8 + 1);
+                file.seekg(0);
+                file.read(reinterpret_cast<char*>(m_buffer.get()), static_cast<std::streamsize>(m_size));
+                m_data = file? reinterpret_cast<const std::byte*>(m_buffer.get()) : nullptr;
+            }
+#endif
+            if(m_data == nullptr)
+            {
+                std::cerr << "Could not open file '" << path << "'.\n";
+                std::exit(EXIT_FAILURE);
+            }
+        }
+
+        FileView(const FileView&) = delete;
+        FileView& operator=(const FileView&) = delete;
+
+        ~FileView()
+        {
+#if !defined(_WIN32)
+            munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+        }
+
+        std::span<const std::byte> get_bytes() const { return { m_data, m_size }; }
+    private:
+        const std::byte* m_data = nullptr;
+        std::size_t m_size = 0;
+#if defined(_WIN32)
+        std::unique_ptr<std::uint64_t[]> m_buffer;
+#endif
+    };
+
+    void emit_bytecode_file(wf::Environment& env, std::string_view script_path, std::string_view output_path)
+    {
+        compile_from_file(env, 0, script_path);
+        env.emit_bytecode(1, 0);
+
+        const std::string_view bytecode = env.get_string(1);
+        std::ofstream output(std::string(output_path), std::ios::binary);
+        output.write(bytecode.data(), static_cast<std::streamsize>(bytecode.size()));
+        if(!output)
+        {
+            std::cerr << "Could not write file '" << output_path << "'.\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    void load_bytecode_file(wf::Environment& env, std::size_t idx, const FileView& file, std::string_view path)
+    {
+        if(!env.load_bytecode(idx, file.get_bytes()))
+        {
+            std::cerr << "Could not load file '" << path << "'.\n";
+            std::cerr << env.get_string(idx) << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
     wf::ReturnState print_int(wf::Environment& env)
     {
         wf::Int value = env.get_int(0);
@@ -75,12 +163,22 @@ namespace wftool
     }
 }
 
+// usage: wftool
+//        wftool --emit-bytecode <script.wf> <output.wfc>
+//        wftool --run-bytecode <file.wfc>
 int main(int argc, const char* argv[])
 {
-    (void)argc;
-    (void)argv;
+    const std::string_view mode = argc > 1? argv[1] : "";
+    if((mode == "--emit-bytecode" && argc != 4) || (mode == "--run-bytecode" && argc != 3)
+        || (!mode.empty() && mode != "--emit-bytecode" && mode != "--run-bytecode"))
+    {
+        std::cerr << "usage: wftool [--emit-bytecode <script.wf> <output.wfc> | --run-bytecode <file.wfc>]\n";
+        return EXIT_FAILURE;
+    }
 
     wftool::MallocAllocator allocator;
+    // Loaded bytecode runs straight from the file, so the view must outlive the Environment.
+    std::unique_ptr<wftool::FileView> bytecode_file;
 
     wf::EnvironmentCreateInfo create_info = {
         .allocator = &allocator
@@ -90,7 +188,20 @@ int main(int argc, const char* argv[])
     wftool::register_io_funcs(env);
     env.reserve(2);
 
-    wftool::compile_from_file(env, 0, "TestScripts/Main.wf");
+    if(mode == "--emit-bytecode")
+    {
+        wftool::emit_bytecode_file(env, argv[2], argv[3]);
+        return EXIT_SUCCESS;
+    }
+    else if(mode == "--run-bytecode")
+    {
+        bytecode_file = std::make_unique<wftool::FileView>(argv[2]);
+        wftool::load_bytecode_file(env, 0, *bytecode_file, argv[2]);
+    }
+    else
+    {
+        wftool::compile_from_file(env, 0, "TestScripts/Main.wf");
+    }
 
     env.disassemble_bytecode(1, 0);
     std::cout << env.get_string(1) << "\n";
@@ -1,12 +1,16 @@
 #ifndef WF_WINDFLOWER_HPP
 #define WF_WINDFLOWER_HPP
 
+#include <cstddef>
+#include <span>
 #include <string_view>
 #include <cstdint>
 
 namespace wf
 {
     struct State;
+    struct ModuleData;
+    struct BytecodeObject;
     class Environment;
 
     enum class ReturnState
@@ -25,21 +29,91 @@ namespace wf
     using Float = double;
     using NativeFunc = ReturnState(*)(Environment& env);
 
+    // Function generated ahead of time by wfc. Stores the returned value, if any, into `return_value` and
+    // returns 0, or the bytecode offset following an integer division by zero.
+    using AotFunc = std::size_t(*)(UInt* return_value);
+
     class Allocator
     {
     public:
         virtual void* operator()(void* buffer, std::size_t old_size, std::size_t new_size) noexcept = 0;
     };
 
+    // Bytecode a wfc generated function was produced from. `code` holds the instruction words, `constants` the
+    // bits of each constant and `constant_types` their ConstantType.
+    struct AotBytecode
+    {
+        std::uint64_t fingerprint;
+        std::uint32_t return_type;
+        std::span<const std::uint32_t> code;
+        std::span<const std::uint8_t> constant_types;
+        std::span<const UInt> constants;
+    };
+
+    // Code generated by wfc declares one static AotRegistration per function. Environment::call runs the
+    // registered function instead of interpreting bytecode that is identical to the registered one. The
+    // fingerprint only rules out most registrations quickly, the code and constants are compared in full.
+    class AotRegistration
+    {
+    public:
+        AotRegistration(const AotBytecode& bytecode, AotFunc function);
+        AotRegistration(const AotRegistration&) = delete;
+        AotRegistration& operator=(const AotRegistration&) = delete;
+
+        static AotFunc find(const BytecodeObject* code);
+    private:
+        static AotRegistration* s_first_registration;
+
+        const AotBytecode m_bytecode;
+        const AotFunc m_function;
+        const AotRegistration* const m_next;
+
+        bool matches(const BytecodeObject* code) const;
+    };
+
+    // Frozen, reference counted compiled code. Copies share the same code, which can be loaded into any number of
+    // Environments on any thread. The allocator of the Environment that compiled it frees the code once the last
+    // copy is destroyed, so it must outlive every copy and be safe to call from the threads that release them.
+    class CompiledModule
+    {
+    public:
+        CompiledModule() = default;
+        CompiledModule(const CompiledModule& other);
+        CompiledModule(CompiledModule&& other) noexcept;
+        CompiledModule& operator=(const CompiledModule& other);
+        CompiledModule& operator=(CompiledModule&& other) noexcept;
+        ~CompiledModule();
+
+        bool is_empty() const { return m_data == nullptr; }
+    private:
+        friend class Environment;
+        friend struct BytecodeObject;
+
+        explicit CompiledModule(ModuleData* data);
+
+        ModuleData* m_data = nullptr;
+    };
+
     struct EnvironmentCreateInfo
     {
         Allocator* allocator = nullptr;
+
+        // Compile functions to native code on their first call. Ignored on platforms without JIT support,
+        // functions the JIT cannot handle keep being interpreted.
+        bool enable_jit = false;
     };
 
     struct CompileInfo
     {
         std::string_view name;
         std::string_view source;
+        // 0 generates code straight from the checked program, which compiles fastest. 1 and above first optimize
+        // it, removing repeated and unused computations, and then clean up the generated code. The result of the
+        // program is the same either way.
+        std::uint32_t optimization_level = 0;
+        // Lets float arithmetic round differently than written for speed, for now by fusing a * b + c into a
+        // single fused multiply-add.
+        bool fast_math = false;
     };
 
     class Environment
@@ -57,13 +131,34 @@ namespace wf
         std::size_t get_reserved_register_count() const;
 
         bool compile(std::size_t idx, const CompileInfo& compile_info);
+        // The compiled code at `idx`, shared rather than copied.
+        CompiledModule get_compiled_module(std::size_t idx);
+        // Stores a function running `module` at `idx`, without copying its code.
+        void load_module(std::size_t idx, const CompiledModule& module);
+        // Stores the bytecode at `idx` in the precompiled (.wfc) file format.
+        void emit_bytecode(std::size_t return_idx, std::size_t idx);
+        // Verifies a file written by emit_bytecode() and stores a function running it at `idx`, or an error message
+        // if the file is malformed. Code and constants are used in place: `bytecode` must start at an 8 byte
+        // aligned address, such as a mapped file, and stay unchanged for as long as the code is in use.
+        bool load_bytecode(std::size_t idx, std::span<const std::byte> bytecode);
         void disassemble_bytecode(std::size_t return_idx, std::size_t idx);
+        // Stores a C++ translation unit implementing the bytecode at `idx` as `function_name`, or an error
+        // message if it cannot be translated. The generated function only replaces bytecode identical to the one
+        // at `idx`, so the script must be compiled with the same CompileInfo settings in both places.
+        bool transpile_bytecode(std::size_t return_idx, std::size_t idx, std::string_view function_name);
 
         TypeId get_bytecode_return_type(std::size_t idx);
 
         void call(std::size_t idx, std::size_t return_idx);
         void call(std::size_t idx);
 
+        // Runs the function at `idx` n times, storing the result of each run into output_column[row]. Instructions
+        // run over blocks of rows, so dispatch is paid once per block instead of once per row. Scripts cannot
+        // declare inputs yet, so for now every row computes the same value. If a row divides an integer by 0, the
+        // VmError names the first such row and the rows before it hold their results.
+        void call_batch(std::size_t idx, Int* output_column, std::size_t n);
+        void call_batch(std::size_t idx, Float* output_column, std::size_t n);
+
         void store_int(std::size_t idx, Int value);
         void store_uint(std::size_t idx, UInt value);
         void store_float(std::size_t idx, Float value);
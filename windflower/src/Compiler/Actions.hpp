@@ -1,9 +1,11 @@
 #ifndef WF_ACTIONS_HPP
 #define WF_ACTIONS_HPP
 
+#include <limits>
+#include <span>
+
 #include "Compiler/SymbolTable.hpp"
 #include "Compiler/Token.hpp"
-#include "Utils/Allocate.hpp"
 #include "Utils/Array.hpp"
 #include "Windflower/Windflower.hpp"
 
@@ -59,222 +61,115 @@ namespace wf
         WF_NUMERIC_UNARY_OPERATIONS
     };
 
-    class Action
-    {
-    public:
-        using polymorphic_size_enable = std::true_type;
-        WF_POLYMORPHIC_SIZING
-
-        enum class Type
-        {
-            STATEMENT_BLOCK,
-            CREATE_STACK_VAR,
-            RETURN,
-
-            INT_UNARY,
-            FLOAT_UNARY,
-            INT_BINARY,
-            FLOAT_BINARY,
-
-            NUMERIC_CONVERSION,
-
-            INT_CONSTANT,
-            FLOAT_CONSTANT,
+    using ActionIndex = std::uint32_t;
+    // Marks an absent optional child, such as the value of a bare return.
+    constexpr ActionIndex NO_ACTION = std::numeric_limits<ActionIndex>::max();
 
-            STACK_VARIABLE_ACCESS,
-        };
-
-        Action(const SourcePosition& position, Type type)
-            : type(type), position(position)
-        {
-        }
-
-        virtual ~Action() = default;
-
-        const Type type;
-        const SourcePosition position;
-    };
-
-    class ExprAction : public Action
+    enum class ActionType : std::uint8_t
     {
-    public:
-        WF_POLYMORPHIC_SIZING
-        ExprAction(const SourcePosition& position, Type type, TypeId result_type)
-            : Action(position, type), m_result_type(result_type)
-        {
-        }
+        STATEMENT_BLOCK,
+        CREATE_STACK_VAR,
+        RETURN,
 
-        TypeId get_result_type() const { return m_result_type; }
-    private:
-        TypeId m_result_type;
-    };
+        INT_UNARY,
+        FLOAT_UNARY,
+        INT_BINARY,
+        FLOAT_BINARY,
 
-    class StatementBlockAction : public Action
-    {
-    public:
-        WF_POLYMORPHIC_SIZING
+        NUMERIC_CONVERSION,
 
-        StatementBlockAction(const SourcePosition& position, DynamicArray<Action*>&& statements,
-                std::uint32_t register_count)
-            : Action(position, Type::STATEMENT_BLOCK), m_statements(std::move(statements)),
-                m_register_count(register_count)
-        {
-        }
+        INT_CONSTANT,
+        FLOAT_CONSTANT,
 
-        const DynamicArray<Action*>& get_statements() const { return m_statements; }
-        std::uint32_t get_register_count() const { return m_register_count; }
-    private:
-        DynamicArray<Action*> m_statements;
-        std::uint32_t m_register_count;
+        STACK_VARIABLE_ACCESS,
     };
 
-    class CreateStackVariableAction : public Action
-    {
-    public:
-        WF_POLYMORPHIC_SIZING
-
-        CreateStackVariableAction(const SourcePosition& position, RegisterAddress address, ExprAction* initializer)
-            : Action(position, Type::CREATE_STACK_VAR), m_address(address), m_initializer(initializer)
-        {
-        }
-
-        RegisterAddress get_address() const { return m_address; }
-        ExprAction* get_initializer() { return m_initializer; }
-        const ExprAction* get_initializer() const { return m_initializer; }
-    private:
-        RegisterAddress m_address;
-        ExprAction* m_initializer;
+    // Operands of an action. Their meaning depends on the action type:
+    //
+    //  STATEMENT_BLOCK           lhs: first statement in extra, rhs: statement count, data: register count
+    //  CREATE_STACK_VAR          lhs: initializer, data: variable address
+    //  RETURN                    lhs: value or NO_ACTION
+    //  INT_UNARY, FLOAT_UNARY    lhs: operand, data: NumericUnaryOperation
+    //  INT_BINARY                lhs: left operand, rhs: right operand, data: IntBinaryOperation
+    //  FLOAT_BINARY              lhs: left operand, rhs: right operand, data: FloatBinaryOperation
+    //  NUMERIC_CONVERSION        lhs: operand
+    //  INT_CONSTANT              data: index into the int constants
+    //  FLOAT_CONSTANT            data: index into the float constants
+    //  STACK_VARIABLE_ACCESS     data: variable address
+    struct ActionOperands
+    {
+        ActionIndex lhs = NO_ACTION;
+        ActionIndex rhs = NO_ACTION;
+        std::uint32_t data = 0;
     };
 
-    class ReturnAction : public Action
+    // Typed program produced by the resolver, stored flat in parallel arrays. Children always precede their
+    // parent. Statements have a VOID result type.
+    class ActionTree
     {
     public:
-        WF_POLYMORPHIC_SIZING
-
-        ReturnAction(const SourcePosition& position, ExprAction* return_value)
-            : Action(position, Type::RETURN), m_return_value(return_value)
+        explicit ActionTree(State* state)
+            : m_types(state), m_result_types(state), m_offsets(state), m_operands(state), m_extra(state),
+                m_int_constants(state), m_float_constants(state)
         {
         }
 
-        ExprAction* get_return_value() { return m_return_value; }
-        const ExprAction* get_return_value() const { return m_return_value; }
-    private:
-        ExprAction* m_return_value;
-    };
-
-    template<typename OperationEnum, Action::Type ActionType>
-    class UnaryAction : public ExprAction
-    {
-    public:
-        WF_POLYMORPHIC_SIZING
-
-        using Operation = OperationEnum;
-
-        UnaryAction(const SourcePosition& position, Operation operation, ExprAction* operand)
-            : ExprAction(position, ActionType, operand->get_result_type()), m_operation(operation), m_operand(operand)
+        ActionIndex add_action(ActionType type, TypeId result_type, SourceOffset offset, const ActionOperands& operands)
         {
+            const ActionIndex index = static_cast<ActionIndex>(m_types.size());
+            m_types.push_back(type);
+            m_result_types.push_back(result_type);
+            m_offsets.push_back(offset);
+            m_operands.push_back(operands);
+            return index;
         }
 
-        Operation get_operation() const { return m_operation; }
-        ExprAction* get_operand() { return m_operand; }
-        const ExprAction* get_operand() const { return m_operand; }
-    private:
-        Operation m_operation;
-        ExprAction* m_operand;
-    };
-
-    template<typename OperationEnum, Action::Type ActionType>
-    class BinaryAction : public ExprAction
-    {
-    public:
-        WF_POLYMORPHIC_SIZING
-        using Operation = OperationEnum;
-
-        BinaryAction(const SourcePosition& position, Operation operation, TypeId result_type,
-                ExprAction* left_operand, ExprAction* right_operand)
-            : ExprAction(position, ActionType, result_type), m_operation(operation), m_left_operand(left_operand), m_right_operand(right_operand)
+        // Appends a list of children to the extra array and returns the index of its first element.
+        std::uint32_t add_extra(std::span<const ActionIndex> actions)
         {
+            const std::uint32_t index = static_cast<std::uint32_t>(m_extra.size());
+            m_extra.insert(m_extra.end(), actions.begin(), actions.end());
+            return index;
         }
 
-        Operation get_operation() const { return m_operation; }
-        ExprAction* get_left_operand() { return m_left_operand; }
-        const ExprAction* get_left_operand() const { return m_left_operand; }
-        ExprAction* get_right_operand() { return m_right_operand; }
-        const ExprAction* get_right_operand() const { return m_right_operand; }
-    private:
-        Operation m_operation;
-        ExprAction* m_left_operand;
-        ExprAction* m_right_operand;
-    };
-
-    using IntUnaryAction = UnaryAction<NumericUnaryOperation, Action::Type::INT_UNARY>;
-    using FloatUnaryAction = UnaryAction<NumericUnaryOperation, Action::Type::FLOAT_UNARY>;
-
-    using IntBinaryAction = BinaryAction<IntBinaryOperation, Action::Type::INT_BINARY>;
-    using FloatBinaryAction = BinaryAction<FloatBinaryOperation, Action::Type::FLOAT_BINARY>;
-
-    class NumericConversionAction : public ExprAction
-    {
-    public:
-        WF_POLYMORPHIC_SIZING
-
-        NumericConversionAction(const SourcePosition& position, TypeId result_type, ExprAction* operand)
-            : ExprAction(position, Type::NUMERIC_CONVERSION, result_type), m_operand(operand)
+        ActionIndex add_int_constant(SourceOffset offset, UInt value)
         {
+            m_int_constants.push_back(value);
+            return add_action(ActionType::INT_CONSTANT, TypeId::INT, offset,
+                    { .data = static_cast<std::uint32_t>(m_int_constants.size() - 1) });
         }
 
-        ExprAction* get_operand() { return m_operand; }
-        const ExprAction* get_operand() const { return m_operand; }
-
-        TypeId get_from_type() const { return m_operand->get_result_type(); }
-    private:
-        ExprAction* m_operand;
-    };
-
-    class IntConstantAction : public ExprAction
-    {
-    public:
-        WF_POLYMORPHIC_SIZING
-
-        IntConstantAction(const SourcePosition& position, TypeId result_type, UInt value)
-            : ExprAction(position, Type::INT_CONSTANT, result_type), m_value(value)
+        ActionIndex add_float_constant(SourceOffset offset, Float value)
         {
+            m_float_constants.push_back(value);
+            return add_action(ActionType::FLOAT_CONSTANT, TypeId::FLOAT, offset,
+                    { .data = static_cast<std::uint32_t>(m_float_constants.size() - 1) });
         }
 
-        UInt get_value() const { return m_value; }
-
-    private:
-        UInt m_value;
-    };
-
-    class FloatConstantAction : public ExprAction
-    {
-    public:
-        WF_POLYMORPHIC_SIZING
+        std::size_t get_action_count() const { return m_types.size(); }
 
-        FloatConstantAction(const SourcePosition& position, TypeId result_type, Float value)
-            : ExprAction(position, Type::FLOAT_CONSTANT, result_type), m_value(value)
-        {
-        }
+        ActionType get_type(ActionIndex action) const { return m_types[action]; }
+        TypeId get_result_type(ActionIndex action) const { return m_result_types[action]; }
+        const ActionOperands& get_operands(ActionIndex action) const { return m_operands[action]; }
 
-        Float get_value() const { return m_value; }
-    private:
-        Float m_value;
-    };
-
-    class StackVariableAccessAction : public ExprAction
-    {
-    public:
-        WF_POLYMORPHIC_SIZING
+        SourceOffset get_offset(ActionIndex action) const { return m_offsets[action]; }
 
-        StackVariableAccessAction(const SourcePosition& position, TypeId result_type, RegisterAddress address)
-            : ExprAction(position, Type::STACK_VARIABLE_ACCESS, result_type), m_address(address)
+        std::span<const ActionIndex> get_extra(std::uint32_t index, std::uint32_t count) const
         {
+            return { m_extra.data() + index, count };
         }
 
-        RegisterAddress get_address() const { return m_address; }
+        UInt get_int_constant(ActionIndex action) const { return m_int_constants[m_operands[action].data]; }
+        Float get_float_constant(ActionIndex action) const { return m_float_constants[m_operands[action].data]; }
     private:
-        RegisterAddress m_address;
+        DynamicArray<ActionType> m_types;
+        DynamicArray<TypeId> m_result_types;
+        DynamicArray<SourceOffset> m_offsets;
+        DynamicArray<ActionOperands> m_operands;
+        DynamicArray<ActionIndex> m_extra;
+
+        DynamicArray<UInt> m_int_constants;
+        DynamicArray<Float> m_float_constants;
     };
 }
 
@@ -1,19 +1,31 @@
 #include "CodeGen.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <functional>
+
 namespace wf
 {
-    CodeGen::CodeGen(State* state, BytecodeObject* output_code)
-        : m_output_code(output_code), int_constant_map(state), float_constant_map(state)
+    CodeGen::CodeGen(State* state, const Source& source, BytecodeBuilder* output_code, bool fast_math)
+        : m_source(source), m_error_manager(state, source), m_output_code(output_code), m_fast_math(fast_math),
+            m_expr_stack(state), m_operand_registers(state), m_action_stack(state), m_variable_registers(state),
+            m_last_uses(state), m_first_dead_variables(state), m_next_dead_variables(state), m_free_registers(state),
+            m_ranges(state), int_constant_map(state), float_constant_map(state), division_magic_map(state)
     {
     }
 
-    void CodeGen::generate(const Action* action_tree)
+    bool CodeGen::generate(const ActionTree& actions, ActionIndex root)
     {
+        m_actions = &actions;
+
         // WARNING: This is EXTREMELY temporary. Top-level returns should most likely not be able to return values.
         m_output_code->return_type = TypeId::FLOAT;
-        std::uint32_t expr_position = m_next_available_register;
-        gen_action(action_tree);
-        push_instruction_long_op(Opcode::RETURN_VALUE, expr_position, SourcePosition::no_pos());
+        // The return appended below reads register 0, so it is reserved even if nothing else uses it.
+        m_register_count = 1;
+        gen_action(root);
+        push_instruction_one_op(Opcode::RETURN_VALUE, 0, NO_SOURCE_OFFSET);
+        m_output_code->frame_size = m_register_count;
+        return !m_error_manager.has_errors();
     }
 
     std::uint32_t CodeGen::push_constant(UInt value)
@@ -33,247 +45,826 @@ namespace wf
 
     std::uint32_t CodeGen::push_constant(Float value)
     {
-        if(auto it = float_constant_map.find(value); it != float_constant_map.end())
+        const UInt bits = std::bit_cast<UInt>(value);
+        if(auto it = float_constant_map.find(bits); it != float_constant_map.end())
         {
             return it->second;
         }
 
         std::uint32_t position = static_cast<std::uint32_t>(m_output_code->constants.size());
-        float_constant_map[value] = position;
+        float_constant_map[bits] = position;
 
         m_output_code->constants.push_back(value);
         m_output_code->constant_type_infos.push_back(ConstantType::FLOAT);
         return position;
     }
 
-    void CodeGen::push_instruction(Opcode opcode, const SourcePosition& position)
+    std::uint32_t CodeGen::push_division_magic(UInt divisor)
     {
-        if(m_last_line != position.line && position != SourcePosition::no_pos())
+        if(auto it = division_magic_map.find(divisor); it != division_magic_map.end())
         {
-            m_output_code->line_info.emplace_back((BytecodeLineInfo){
-                .offset = m_output_code->code.size(),
-                .line = static_cast<std::uint16_t>(position.line)
-            });
+            return it->second;
         }
-        m_output_code->code.emplace_back(Instruction(opcode));
+
+        std::uint32_t position = static_cast<std::uint32_t>(m_output_code->constants.size());
+        division_magic_map[divisor] = position;
+
+        m_output_code->constants.push_back(divisor);
+        m_output_code->constants.push_back(get_division_magic(divisor));
+        m_output_code->constant_type_infos.push_back(ConstantType::INT);
+        m_output_code->constant_type_infos.push_back(ConstantType::INT);
+        return position;
+    }
+
+    std::uint32_t CodeGen::allocate_register()
+    {
+        const std::uint32_t result = m_next_available_register++;
+        m_register_count = std::max(m_register_count, m_next_available_register);
+        return result;
     }
 
-    void CodeGen::push_instruction_two_op(Opcode opcode, std::uint32_t op_a, std::uint32_t op_b,
-            const SourcePosition& position)
+    void CodeGen::push_instruction(Instruction instruction, SourceOffset offset)
     {
-        if(m_last_line != position.line && position != SourcePosition::no_pos())
+        if(offset != NO_SOURCE_OFFSET)
         {
-            m_output_code->line_info.emplace_back((BytecodeLineInfo){
-                .offset = m_output_code->code.size(),
-                .line = static_cast<std::uint16_t>(position.line)
-            });
+            const std::uint32_t line = m_source.get_line(offset);
+            if(m_last_line != line)
+            {
+                m_output_code->line_info.emplace_back((BytecodeLineInfo){
+                    .offset = static_cast<std::uint32_t>(m_output_code->code.size()),
+                    .line = line
+                });
+                m_last_line = line;
+            }
         }
-        m_output_code->code.emplace_back(Instruction(opcode, op_a, op_b));
+        m_output_code->code.emplace_back(instruction);
     }
 
-    void CodeGen::push_instruction_long_op(Opcode opcode, std::uint32_t operand,
-            const SourcePosition& position)
+    void CodeGen::push_wide_instruction(Instruction prefix, Instruction instruction, SourceOffset offset)
     {
-        if(m_last_line != position.line && position != SourcePosition::no_pos())
+        push_instruction(prefix, offset);
+        m_output_code->code.emplace_back(instruction);
+    }
+
+    void CodeGen::push_instruction(Opcode opcode, SourceOffset offset)
+    {
+        push_instruction(Instruction(opcode), offset);
+    }
+
+    void CodeGen::push_instruction_one_op(Opcode opcode, std::uint32_t op_a, SourceOffset offset)
+    {
+        push_instruction_three_op(opcode, op_a, 0, 0, offset);
+    }
+
+    void CodeGen::push_instruction_two_op(Opcode opcode, std::uint32_t op_a, std::uint32_t op_d, SourceOffset offset)
+    {
+        if(op_a <= Instruction::MAX_OP_A && op_d <= Instruction::MAX_OP_D)
         {
-            m_output_code->line_info.emplace_back((BytecodeLineInfo){
-                .offset = m_output_code->code.size(),
-                .line = static_cast<std::uint16_t>(position.line)
-            });
+            push_instruction(Instruction(opcode, op_a, op_d), offset);
+            return;
         }
-        m_output_code->code.emplace_back(Instruction(opcode, operand));
+
+        const OperandLayout layout = get_operand_layout(opcode);
+        if(op_a > WideInstruction::MAX_OP_A) push_operand_error(layout.a, offset);
+        if(op_d > WideInstruction::MAX_OP_D) push_operand_error(layout.d, offset);
+        push_wide_instruction(
+            WideInstruction::make_prefix(op_a, op_d),
+            Instruction(opcode, op_a & Instruction::MAX_OP_A, op_d & Instruction::MAX_OP_D),
+            offset
+        );
     }
 
+    void CodeGen::push_instruction_three_op(Opcode opcode, std::uint32_t op_a, std::uint32_t op_b, std::uint32_t op_c,
+            SourceOffset offset)
+    {
+        if(op_a <= Instruction::MAX_OP_A && op_b <= Instruction::MAX_OP_B && op_c <= Instruction::MAX_OP_C)
+        {
+            push_instruction(Instruction(opcode, op_a, op_b, op_c), offset);
+            return;
+        }
+
+        const OperandLayout layout = get_operand_layout(opcode);
+        if(op_a > WideInstruction::MAX_OP_A) push_operand_error(layout.a, offset);
+        if(op_b > WideInstruction::MAX_OP_B) push_operand_error(layout.b, offset);
+        if(op_c > WideInstruction::MAX_OP_C) push_operand_error(layout.c, offset);
+        push_wide_instruction(
+            WideInstruction::make_prefix(op_a, op_b, op_c),
+            Instruction(opcode, op_a & Instruction::MAX_OP_A, op_b & Instruction::MAX_OP_B, op_c & Instruction::MAX_OP_C),
+            offset
+        );
+    }
 
-    void CodeGen::gen_action(const Action* action)
+    void CodeGen::push_instruction_long_op(Opcode opcode, std::uint32_t operand, SourceOffset offset)
     {
-        switch(action->type)
+        if(operand <= Instruction::MAX_OP_LONG)
         {
-            case Action::Type::STATEMENT_BLOCK:
-                gen_statement_block(static_cast<const StatementBlockAction*>(action));
-                break;
-            case Action::Type::CREATE_STACK_VAR:
-                gen_create_stack_variable(static_cast<const CreateStackVariableAction*>(action));
-                break;
-            case Action::Type::RETURN:
-                gen_return(static_cast<const ReturnAction*>(action));
-                break;
-            case Action::Type::INT_BINARY:
-                gen_int_binary_op(static_cast<const IntBinaryAction*>(action));
-                break;
-            case Action::Type::FLOAT_BINARY:
-                gen_float_binary_op(static_cast<const FloatBinaryAction*>(action));
-                break;
-            case Action::Type::INT_UNARY:
-                gen_int_unary_op(static_cast<const IntUnaryAction*>(action));
+            push_instruction(Instruction(opcode, operand), offset);
+            return;
+        }
+
+        // Only rsv has a long operand, the number of registers.
+        if(operand > WideInstruction::MAX_OP_LONG) push_operand_error(OperandKind::REGISTER, offset);
+        push_wide_instruction(
+            WideInstruction::make_prefix(operand),
+            Instruction(opcode, operand & Instruction::MAX_OP_LONG),
+            offset
+        );
+    }
+
+    void CodeGen::push_operand_error(OperandKind kind, SourceOffset offset)
+    {
+        // Code is still generated after the error, but the compilation fails.
+        if(m_error_manager.has_errors()) return;
+
+        m_error_manager.push_error(offset == NO_SOURCE_OFFSET? 0 : offset, "Too many {}.",
+            kind == OperandKind::CONSTANT? "constants" : "registers");
+    }
+
+    std::optional<std::uint32_t> CodeGen::get_constant_operand(ActionIndex action, std::uint32_t max_index)
+    {
+        std::uint32_t index;
+        switch(m_actions->get_type(action))
+        {
+            case ActionType::INT_CONSTANT:
+                index = push_constant(m_actions->get_int_constant(action));
                 break;
-            case Action::Type::FLOAT_UNARY:
-                gen_float_unary_op(static_cast<const FloatUnaryAction*>(action));
+            case ActionType::FLOAT_CONSTANT:
+                index = push_constant(m_actions->get_float_constant(action));
                 break;
-            case Action::Type::NUMERIC_CONVERSION:
-                gen_numeric_conversion(static_cast<const NumericConversionAction*>(action));
+            default:
+                return std::nullopt;
+        }
+
+        if(index > max_index) return std::nullopt;
+        return index;
+    }
+
+    std::optional<std::int32_t> CodeGen::get_immediate_operand(ActionIndex action) const
+    {
+        if(m_actions->get_type(action) != ActionType::INT_CONSTANT) return std::nullopt;
+
+        const UInt value = m_actions->get_int_constant(action);
+        if(value > static_cast<UInt>(Instruction::MAX_OP_SC)) return std::nullopt;
+
+        return static_cast<std::int32_t>(value);
+    }
+
+    bool CodeGen::reads_register(ActionIndex action, RegisterAddress address)
+    {
+        // Only variable accesses read registers, temporaries are never read before they are written.
+        if(address >= m_variable_register_count) return false;
+
+        const std::size_t stack_begin = m_action_stack.size();
+        m_action_stack.push_back(action);
+        bool result = false;
+        while(m_action_stack.size() > stack_begin)
+        {
+            const ActionIndex current = m_action_stack.back();
+            m_action_stack.pop_back();
+
+            const ActionOperands& operands = m_actions->get_operands(current);
+            switch(m_actions->get_type(current))
+            {
+                case ActionType::STACK_VARIABLE_ACCESS:
+                    result = m_variable_registers[operands.data] == address;
+                    break;
+                case ActionType::INT_BINARY:
+                case ActionType::FLOAT_BINARY:
+                    m_action_stack.push_back(operands.rhs);
+                    m_action_stack.push_back(operands.lhs);
+                    break;
+                case ActionType::INT_UNARY:
+                case ActionType::FLOAT_UNARY:
+                case ActionType::NUMERIC_CONVERSION:
+                    m_action_stack.push_back(operands.lhs);
+                    break;
+                default:
+                    break;
+            }
+
+            if(result) break;
+        }
+
+        m_action_stack.resize(stack_begin);
+        return result;
+    }
+
+    void CodeGen::gen_action(ActionIndex action)
+    {
+        switch(m_actions->get_type(action))
+        {
+            case ActionType::STATEMENT_BLOCK:
+                gen_statement_block(action);
                 break;
-            case Action::Type::INT_CONSTANT:
-                gen_int_constant(static_cast<const IntConstantAction*>(action));
+            case ActionType::CREATE_STACK_VAR:
+                gen_create_stack_variable(action);
                 break;
-            case Action::Type::FLOAT_CONSTANT:
-                gen_float_constant(static_cast<const FloatConstantAction*>(action));
+            case ActionType::RETURN:
+                gen_return(action);
                 break;
-            case Action::Type::STACK_VARIABLE_ACCESS:
-                gen_stack_variable_access(static_cast<const StackVariableAccessAction*>(action));
+            case ActionType::INT_BINARY:
+            case ActionType::FLOAT_BINARY:
+            case ActionType::INT_UNARY:
+            case ActionType::FLOAT_UNARY:
+            case ActionType::NUMERIC_CONVERSION:
+            case ActionType::INT_CONSTANT:
+            case ActionType::FLOAT_CONSTANT:
+            case ActionType::STACK_VARIABLE_ACCESS:
+            {
+                // The value of an expression statement is discarded.
+                const std::uint32_t saved_next_register = m_next_available_register;
+                gen_expr_register(action);
+                m_next_available_register = saved_next_register;
                 break;
+            }
         }
     }
 
-    void CodeGen::gen_statement_block(const StatementBlockAction* action)
+    void CodeGen::gen_statement_block(ActionIndex action)
     {
-        push_instruction_long_op(Opcode::RESERVE, action->get_register_count(), action->position);
-        for(const Action* statement : action->get_statements())
+        const ActionOperands& operands = m_actions->get_operands(action);
+        const std::span<const ActionIndex> statements = m_actions->get_extra(operands.lhs, operands.rhs);
+        compute_liveness(statements, operands.data);
+        m_ranges.reset(m_actions, operands.data);
+
+        // The return appended after the block reads register 0, so the first variable always lives there.
+        m_variable_register_count = 0;
+        m_free_registers.clear();
+        if(operands.data > 0)
+        {
+            m_variable_registers[0] = allocate_variable_register();
+        }
+
+        const std::size_t reserve_offset = m_output_code->code.size();
+        push_instruction_long_op(Opcode::RESERVE, 0, m_actions->get_offset(action));
+        for(std::uint32_t i = 0; i < statements.size(); i++)
         {
+            const ActionIndex statement = statements[i];
+            const std::uint32_t address = m_actions->get_operands(statement).data;
+            if(m_actions->get_type(statement) == ActionType::CREATE_STACK_VAR && address != 0)
+            {
+                m_variable_registers[address] = allocate_variable_register();
+            }
+
+            // Temporaries of the statement go above every register that may hold a live variable.
+            m_next_available_register = m_variable_register_count;
+            m_register_count = std::max(m_register_count, m_next_available_register);
             gen_action(statement);
+            if(m_actions->get_type(statement) == ActionType::CREATE_STACK_VAR)
+            {
+                m_ranges.add_declaration(statement);
+            }
+            release_dead_variables(i);
+        }
+
+        // Registers are addressed by wide operands, so a count that fits them fits the regular encoding of rsv.
+        if(m_register_count > WideInstruction::MAX_OP_A + 1)
+        {
+            push_operand_error(OperandKind::REGISTER, m_actions->get_offset(action));
         }
+        m_output_code->code[reserve_offset] = Instruction(Opcode::RESERVE, m_register_count & Instruction::MAX_OP_LONG);
     }
 
-    void CodeGen::gen_create_stack_variable(const CreateStackVariableAction* action)
+    void CodeGen::compute_liveness(std::span<const ActionIndex> statements, std::uint32_t variable_count)
     {
-        gen_action(action->get_initializer());
+        const std::uint32_t statement_count = static_cast<std::uint32_t>(statements.size());
+
+        m_variable_registers.assign(variable_count, 0);
+        m_last_uses.assign(variable_count, 0);
+        for(std::uint32_t i = 0; i < statement_count; i++)
+        {
+            const ActionIndex statement = statements[i];
+            const ActionOperands& operands = m_actions->get_operands(statement);
+            switch(m_actions->get_type(statement))
+            {
+                case ActionType::CREATE_STACK_VAR:
+                    m_last_uses[operands.data] = i;
+                    m_action_stack.push_back(operands.lhs);
+                    break;
+                case ActionType::RETURN:
+                    if(operands.lhs != NO_ACTION) m_action_stack.push_back(operands.lhs);
+                    break;
+                default:
+                    m_action_stack.push_back(statement);
+                    break;
+            }
+
+            while(!m_action_stack.empty())
+            {
+                const ActionIndex current = m_action_stack.back();
+                m_action_stack.pop_back();
+
+                const ActionOperands& current_operands = m_actions->get_operands(current);
+                switch(m_actions->get_type(current))
+                {
+                    case ActionType::STACK_VARIABLE_ACCESS:
+                        m_last_uses[current_operands.data] = i;
+                        break;
+                    case ActionType::INT_BINARY:
+                    case ActionType::FLOAT_BINARY:
+                        m_action_stack.push_back(current_operands.rhs);
+                        m_action_stack.push_back(current_operands.lhs);
+                        break;
+                    case ActionType::INT_UNARY:
+                    case ActionType::FLOAT_UNARY:
+                    case ActionType::NUMERIC_CONVERSION:
+                        m_action_stack.push_back(current_operands.lhs);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        // Registers are only released after the statement that last reads them, so an initializer never
+        // overwrites a variable it still has to read. The first variable is read by the final return.
+        m_first_dead_variables.assign(statement_count, NO_VARIABLE);
+        m_next_dead_variables.assign(variable_count, NO_VARIABLE);
+        for(std::uint32_t address = 1; address < variable_count; address++)
+        {
+            m_next_dead_variables[address] = m_first_dead_variables[m_last_uses[address]];
+            m_first_dead_variables[m_last_uses[address]] = address;
+        }
     }
 
-    void CodeGen::gen_return(const ReturnAction* action)
+    std::uint32_t CodeGen::allocate_variable_register()
     {
-        if(action->get_return_value() == nullptr)
+        if(m_free_registers.empty())
         {
-            push_instruction(Opcode::RETURN, action->position);
-            return;
+            return m_variable_register_count++;
         }
 
-        const std::uint32_t operand_position = m_next_available_register;
-        gen_action(action->get_return_value());
-        push_instruction_long_op(Opcode::RETURN_VALUE, operand_position, action->position);
+        std::pop_heap(m_free_registers.begin(), m_free_registers.end(), std::greater<>());
+        const std::uint32_t result = m_free_registers.back();
+        m_free_registers.pop_back();
+        return result;
     }
 
-    void CodeGen::gen_int_binary_op(const IntBinaryAction* action)
+    void CodeGen::release_dead_variables(std::uint32_t statement)
     {
-        const std::uint32_t left_operand_position = m_next_available_register;
-        gen_action(action->get_left_operand());
-        const std::uint32_t right_operand_position = m_next_available_register;
-        gen_action(action->get_right_operand());
+        for(std::uint32_t address = m_first_dead_variables[statement]; address != NO_VARIABLE;
+            address = m_next_dead_variables[address])
+        {
+            m_free_registers.push_back(m_variable_registers[address]);
+            std::push_heap(m_free_registers.begin(), m_free_registers.end(), std::greater<>());
+        }
+    }
+
+    std::uint32_t CodeGen::get_variable_register(ActionIndex action) const
+    {
+        return m_variable_registers[m_actions->get_operands(action).data];
+    }
 
-        Opcode opcode;
+    void CodeGen::gen_create_stack_variable(ActionIndex action)
+    {
+        const ActionOperands& operands = m_actions->get_operands(action);
+        gen_expr(operands.lhs, m_variable_registers[operands.data]);
+    }
 
-        switch(action->get_operation())
+    void CodeGen::gen_return(ActionIndex action)
+    {
+        const ActionIndex return_value = m_actions->get_operands(action).lhs;
+        if(return_value == NO_ACTION)
         {
-            case IntBinaryOperation::ADD:
-                opcode = Opcode::ADD_INT;
-                break;
-            case IntBinaryOperation::SUBTRACT:
-                opcode = Opcode::SUBTRACT_INT;
-                break;
-            case IntBinaryOperation::MULTIPLY:
-                opcode = Opcode::MULTIPLY_INT;
-                break;
-            case IntBinaryOperation::DIVIDE:
-                opcode = Opcode::DIVIDE_INT;
-                break;
-            case IntBinaryOperation::MODULO:
-                opcode = Opcode::MODULO_INT;
+            push_instruction(Opcode::RETURN, m_actions->get_offset(action));
+            return;
+        }
+
+        // Constants are returned by a single retk instead of being loaded into a register first.
+        switch(m_actions->get_type(return_value))
+        {
+            case ActionType::INT_CONSTANT:
+                push_instruction_two_op(Opcode::RETURN_CONSTANT, 0,
+                    push_constant(m_actions->get_int_constant(return_value)), m_actions->get_offset(action));
+                return;
+            case ActionType::FLOAT_CONSTANT:
+                push_instruction_two_op(Opcode::RETURN_CONSTANT, 0,
+                    push_constant(m_actions->get_float_constant(return_value)), m_actions->get_offset(action));
+                return;
+            default:
                 break;
         }
 
-        push_instruction_two_op(opcode, left_operand_position, right_operand_position, action->position);
-        m_next_available_register--;
+        const std::uint32_t saved_next_register = m_next_available_register;
+        const std::uint32_t operand_position = gen_expr_register(return_value);
+        push_instruction_one_op(Opcode::RETURN_VALUE, operand_position, m_actions->get_offset(action));
+        m_next_available_register = saved_next_register;
     }
 
-    void CodeGen::gen_float_binary_op(const FloatBinaryAction* action)
+    void CodeGen::gen_expr(ActionIndex action, std::uint32_t destination)
     {
-        const std::uint32_t left_operand_position = m_next_available_register;
-        gen_action(action->get_left_operand());
-        const std::uint32_t right_operand_position = m_next_available_register;
-        gen_action(action->get_right_operand());
+        const std::size_t stack_begin = m_expr_stack.size();
+        m_expr_stack.push_back({ .step = ExprStep::EXPRESSION, .action = action, .destination = destination });
 
-        Opcode opcode;
+        while(m_expr_stack.size() > stack_begin)
+        {
+            ExprFrame frame = m_expr_stack.back();
+            m_expr_stack.pop_back();
+
+            switch(frame.step)
+            {
+                case ExprStep::EXPRESSION:
+                    begin_expr(frame.action, frame.destination);
+                    break;
+                case ExprStep::SECOND_OPERAND:
+                    frame.step = ExprStep::EMIT;
+                    m_expr_stack.push_back(frame);
+                    push_operand(m_actions->get_operands(frame.action).rhs);
+                    break;
+                case ExprStep::EMIT:
+                    emit_expr(frame);
+                    break;
+            }
+        }
+    }
 
-        switch(action->get_operation())
+    std::uint32_t CodeGen::gen_expr_register(ActionIndex action, std::optional<std::uint32_t> scratch)
+    {
+        if(m_actions->get_type(action) == ActionType::STACK_VARIABLE_ACCESS)
         {
-            case FloatBinaryOperation::ADD:
-                opcode = Opcode::ADD_FLOAT;
+            return get_variable_register(action);
+        }
+
+        const std::uint32_t destination = scratch.has_value()? scratch.value() : allocate_register();
+        gen_expr(action, destination);
+        return destination;
+    }
+
+    void CodeGen::push_operand(ActionIndex action, std::optional<std::uint32_t> scratch)
+    {
+        if(m_actions->get_type(action) == ActionType::STACK_VARIABLE_ACCESS)
+        {
+            m_operand_registers.push_back(get_variable_register(action));
+            return;
+        }
+
+        const std::uint32_t destination = scratch.has_value()? scratch.value() : allocate_register();
+        m_operand_registers.push_back(destination);
+        m_expr_stack.push_back({ .step = ExprStep::EXPRESSION, .action = action, .destination = destination });
+    }
+
+    std::uint32_t CodeGen::pop_operand_register()
+    {
+        const std::uint32_t result = m_operand_registers.back();
+        m_operand_registers.pop_back();
+        return result;
+    }
+
+    void CodeGen::begin_expr(ActionIndex action, std::uint32_t destination)
+    {
+        switch(m_actions->get_type(action))
+        {
+            case ActionType::INT_BINARY:
+                begin_binary_op(action, get_int_binary_opcodes(action), destination);
                 break;
-            case FloatBinaryOperation::SUBTRACT:
-                opcode = Opcode::SUBTRACT_FLOAT;
+            case ActionType::FLOAT_BINARY:
+                if(!m_fast_math || !begin_fused_multiply_add(action, destination))
+                {
+                    begin_binary_op(action, get_float_binary_opcodes(action), destination);
+                }
                 break;
-            case FloatBinaryOperation::MULTIPLY:
-                opcode = Opcode::MULTIPLY_FLOAT;
+            case ActionType::INT_UNARY:
+                begin_operation(action, Opcode::NEGATION_INT, destination);
                 break;
-            case FloatBinaryOperation::DIVIDE:
-                opcode = Opcode::DIVIDE_FLOAT;
+            case ActionType::FLOAT_UNARY:
+                begin_operation(action, Opcode::NEGATION_FLOAT, destination);
+                break;
+            case ActionType::NUMERIC_CONVERSION:
+                begin_operation(action, get_numeric_conversion_opcode(action), destination);
+                break;
+            case ActionType::INT_CONSTANT:
+                gen_int_constant(action, destination);
+                break;
+            case ActionType::FLOAT_CONSTANT:
+                gen_float_constant(action, destination);
+                break;
+            case ActionType::STACK_VARIABLE_ACCESS:
+                gen_stack_variable_access(action, destination);
+                break;
+            case ActionType::STATEMENT_BLOCK:
+            case ActionType::CREATE_STACK_VAR:
+            case ActionType::RETURN:
                 break;
         }
+    }
 
-        push_instruction_two_op(opcode, left_operand_position, right_operand_position, action->position);
-        m_next_available_register--;
+    void CodeGen::begin_operation(ActionIndex action, Opcode opcode, std::uint32_t destination)
+    {
+        m_expr_stack.push_back({
+            .step = ExprStep::EMIT,
+            .form = OperandForm::REGISTER,
+            .opcode = opcode,
+            .action = action,
+            .destination = destination,
+            .saved_next_register = m_next_available_register
+        });
+        push_operand(m_actions->get_operands(action).lhs, destination);
     }
 
-    void CodeGen::gen_int_unary_op(const IntUnaryAction* action)
+    void CodeGen::begin_binary_op(ActionIndex action, const BinaryOpcodes& opcodes, std::uint32_t destination)
     {
-        const std::uint32_t operand_position = m_next_available_register;
-        gen_action(action->get_operand());
+        const ActionIndex left_operand = m_actions->get_operands(action).lhs;
+        const ActionIndex right_operand = m_actions->get_operands(action).rhs;
+
+        ExprFrame frame = {
+            .step = ExprStep::EMIT,
+            .action = action,
+            .destination = destination,
+            .saved_next_register = m_next_available_register
+        };
+
+        // An operand may be evaluated straight into the destination as long as the other operand does not
+        // read the destination afterwards. That is always the case when the other operand is a constant.
+        std::optional<std::int32_t> immediate;
+        std::optional<std::uint32_t> constant;
+
+        if(opcodes.register_immediate.has_value()
+            && (immediate = get_immediate_operand(right_operand)).has_value())
+        {
+            frame.form = OperandForm::REGISTER_IMMEDIATE;
+            frame.opcode = opcodes.register_immediate.value();
+            frame.constant = static_cast<std::uint8_t>(immediate.value());
+            reduce_strength(frame);
+            m_expr_stack.push_back(frame);
+            push_operand(left_operand, destination);
+        }
+        else if(opcodes.register_immediate.has_value() && opcodes.is_commutative
+            && (immediate = get_immediate_operand(left_operand)).has_value())
+        {
+            frame.form = OperandForm::REGISTER_IMMEDIATE;
+            frame.opcode = opcodes.register_immediate.value();
+            frame.constant = static_cast<std::uint8_t>(immediate.value());
+            reduce_strength(frame);
+            m_expr_stack.push_back(frame);
+            push_operand(right_operand, destination);
+        }
+        else if((constant = get_constant_operand(right_operand, WideInstruction::MAX_OP_C)).has_value())
+        {
+            frame.form = OperandForm::REGISTER_CONSTANT;
+            frame.opcode = opcodes.register_constant;
+            frame.constant = constant.value();
+            reduce_strength(frame);
+            m_expr_stack.push_back(frame);
+            push_operand(left_operand, destination);
+        }
+        else if(opcodes.is_commutative
+            && (constant = get_constant_operand(left_operand, WideInstruction::MAX_OP_C)).has_value())
+        {
+            frame.form = OperandForm::REGISTER_CONSTANT;
+            frame.opcode = opcodes.register_constant;
+            frame.constant = constant.value();
+            reduce_strength(frame);
+            m_expr_stack.push_back(frame);
+            push_operand(right_operand, destination);
+        }
+        else if(opcodes.constant_register.has_value()
+            && (constant = get_constant_operand(left_operand, WideInstruction::MAX_OP_B)).has_value())
+        {
+            frame.form = OperandForm::CONSTANT_REGISTER;
+            frame.opcode = opcodes.constant_register.value();
+            frame.constant = constant.value();
+            m_expr_stack.push_back(frame);
+            push_operand(right_operand, destination);
+        }
+        else if(m_actions->get_type(left_operand) == ActionType::STACK_VARIABLE_ACCESS
+            && get_variable_register(left_operand) != destination)
+        {
+            // The variable is read in place, so the right operand can be evaluated into the destination. This
+            // keeps chains like a + (b + (c + ...)) from taking a temporary per nesting level.
+            frame.form = OperandForm::REGISTER_REGISTER;
+            frame.opcode = get_register_register_opcode(opcodes, right_operand);
+            m_expr_stack.push_back(frame);
+            push_operand(left_operand);
+            push_operand(right_operand, destination);
+        }
+        else
+        {
+            std::optional<std::uint32_t> left_scratch;
+            if(!reads_register(right_operand, destination))
+            {
+                left_scratch = destination;
+            }
+
+            frame.step = ExprStep::SECOND_OPERAND;
+            frame.form = OperandForm::REGISTER_REGISTER;
+            frame.opcode = get_register_register_opcode(opcodes, right_operand);
+            m_expr_stack.push_back(frame);
+            push_operand(left_operand, left_scratch);
+        }
+    }
+
+    Opcode CodeGen::get_register_register_opcode(const BinaryOpcodes& opcodes, ActionIndex right_operand)
+    {
+        if(opcodes.register_register_nonzero.has_value() && m_ranges.get_range(right_operand).excludes_zero())
+        {
+            return opcodes.register_register_nonzero.value();
+        }
+        return opcodes.register_register;
+    }
+
+    void CodeGen::reduce_strength(ExprFrame& frame)
+    {
+        if(frame.opcode != Opcode::MULTIPLY_INT_RI && frame.opcode != Opcode::MULTIPLY_INT_RK
+            && frame.opcode != Opcode::DIVIDE_INT_RK && frame.opcode != Opcode::MODULO_INT_RK)
+        {
+            return;
+        }
+
+        // Ints divide as unsigned values, so powers of two become plain shifts and masks.
+        const UInt value = frame.opcode == Opcode::MULTIPLY_INT_RI?
+            frame.constant : m_output_code->constants[frame.constant].as_int;
+        if(value < 2) return;
 
-        push_instruction_long_op(Opcode::NEGATION_INT, operand_position, action->position);
+        if(std::has_single_bit(value))
+        {
+            const std::uint32_t shift = static_cast<std::uint32_t>(std::countr_zero(value));
+            if(frame.opcode == Opcode::MODULO_INT_RK)
+            {
+                const std::uint32_t mask = push_constant(value - 1);
+                if(mask > WideInstruction::MAX_OP_C) return;
+
+                frame.opcode = Opcode::AND_INT_RK;
+                frame.constant = mask;
+            }
+            else
+            {
+                frame.form = OperandForm::REGISTER_IMMEDIATE;
+                frame.opcode = frame.opcode == Opcode::DIVIDE_INT_RK?
+                    Opcode::SHIFT_RIGHT_INT_RI : Opcode::SHIFT_LEFT_INT_RI;
+                frame.constant = shift;
+            }
+            return;
+        }
+
+        // Multiplications by other constants are already a single imul.
+        if(frame.opcode != Opcode::DIVIDE_INT_RK && frame.opcode != Opcode::MODULO_INT_RK) return;
+
+        const std::uint32_t magic = push_division_magic(value);
+        if(magic + 1 > WideInstruction::MAX_OP_C) return;
+
+        frame.opcode = frame.opcode == Opcode::DIVIDE_INT_RK? Opcode::DIVIDE_INT_MAGIC : Opcode::MODULO_INT_MAGIC;
+        frame.constant = magic;
     }
 
-    void CodeGen::gen_float_unary_op(const FloatUnaryAction* action)
+    bool CodeGen::begin_fused_multiply_add(ActionIndex action, std::uint32_t destination)
     {
-        const std::uint32_t operand_position = m_next_available_register;
-        gen_action(action->get_operand());
+        const ActionOperands& operands = m_actions->get_operands(action);
+        if(static_cast<FloatBinaryOperation>(operands.data) != FloatBinaryOperation::ADD) return false;
+
+        auto is_multiplication = [this](ActionIndex operand) {
+            return m_actions->get_type(operand) == ActionType::FLOAT_BINARY
+                && static_cast<FloatBinaryOperation>(m_actions->get_operands(operand).data)
+                    == FloatBinaryOperation::MULTIPLY;
+        };
+
+        // Chains like a * b + c * d + e * f accumulate from the left, so the right product is fused first.
+        ActionIndex product = operands.rhs;
+        ActionIndex addend = operands.lhs;
+        if(!is_multiplication(product))
+        {
+            std::swap(product, addend);
+            if(!is_multiplication(product)) return false;
+        }
 
-        push_instruction_long_op(Opcode::NEGATION_FLOAT, operand_position, action->position);
+        // The addend is evaluated into the destination before the factors are read.
+        if(reads_register(product, destination)) return false;
+
+        m_expr_stack.push_back({
+            .step = ExprStep::EMIT,
+            .form = OperandForm::ACCUMULATE,
+            .opcode = Opcode::FMA_FLOAT,
+            .action = action,
+            .destination = destination,
+            .saved_next_register = m_next_available_register
+        });
+        push_operand(m_actions->get_operands(product).lhs);
+        push_operand(m_actions->get_operands(product).rhs);
+        push_operand(addend, destination);
+        return true;
     }
 
-    void CodeGen::gen_numeric_conversion(const NumericConversionAction* action)
+    void CodeGen::emit_expr(const ExprFrame& frame)
     {
-        const std::uint32_t operand_position = m_next_available_register;
-        gen_action(action->get_operand());
+        const SourceOffset offset = m_actions->get_offset(frame.action);
+        switch(frame.form)
+        {
+            case OperandForm::REGISTER:
+            {
+                const std::uint32_t operand = pop_operand_register();
+                // A conversion between equal types is a MOVE, which is only needed if the operand is elsewhere.
+                if(frame.opcode != Opcode::MOVE || operand != frame.destination)
+                {
+                    push_instruction_two_op(frame.opcode, frame.destination, operand, offset);
+                }
+                break;
+            }
+            case OperandForm::REGISTER_IMMEDIATE:
+            case OperandForm::REGISTER_CONSTANT:
+                push_instruction_three_op(frame.opcode, frame.destination, pop_operand_register(), frame.constant,
+                        offset);
+                break;
+            case OperandForm::CONSTANT_REGISTER:
+                push_instruction_three_op(frame.opcode, frame.destination, frame.constant, pop_operand_register(),
+                        offset);
+                break;
+            case OperandForm::REGISTER_REGISTER:
+            {
+                const std::uint32_t right = pop_operand_register();
+                const std::uint32_t left = pop_operand_register();
+                push_instruction_three_op(frame.opcode, frame.destination, left, right, offset);
+                break;
+            }
+            case OperandForm::ACCUMULATE:
+            {
+                // A variable addend is read in place and still has to be copied into the destination.
+                const std::uint32_t addend = pop_operand_register();
+                const std::uint32_t right = pop_operand_register();
+                const std::uint32_t left = pop_operand_register();
+                if(addend != frame.destination)
+                {
+                    push_instruction_two_op(Opcode::MOVE, frame.destination, addend, offset);
+                }
+                push_instruction_three_op(frame.opcode, frame.destination, left, right, offset);
+                break;
+            }
+        }
 
-        if(action->get_from_type() == TypeId::INT
-            && action->get_result_type() == TypeId::FLOAT)
+        m_next_available_register = frame.saved_next_register;
+    }
+
+    CodeGen::BinaryOpcodes CodeGen::get_int_binary_opcodes(ActionIndex action) const
+    {
+        switch(static_cast<IntBinaryOperation>(m_actions->get_operands(action).data))
         {
-            push_instruction_long_op(Opcode::INT_TO_FLOAT, operand_position, action->position);
+            case IntBinaryOperation::ADD:
+                return { Opcode::ADD_INT, Opcode::ADD_INT_RK, std::nullopt, Opcode::ADD_INT_RI, true };
+            case IntBinaryOperation::SUBTRACT:
+                return { Opcode::SUBTRACT_INT, Opcode::SUBTRACT_INT_RK, Opcode::SUBTRACT_INT_KR,
+                    Opcode::SUBTRACT_INT_RI, false };
+            case IntBinaryOperation::MULTIPLY:
+                return { Opcode::MULTIPLY_INT, Opcode::MULTIPLY_INT_RK, std::nullopt, Opcode::MULTIPLY_INT_RI, true };
+            case IntBinaryOperation::DIVIDE:
+                return { Opcode::DIVIDE_INT, Opcode::DIVIDE_INT_RK, Opcode::DIVIDE_INT_KR, std::nullopt, false,
+                    Opcode::DIVIDE_INT_NOCHECK };
+            case IntBinaryOperation::MODULO:
+                return { Opcode::MODULO_INT, Opcode::MODULO_INT_RK, Opcode::MODULO_INT_KR, std::nullopt, false,
+                    Opcode::MODULO_INT_NOCHECK };
         }
-        else if(action->get_from_type() == TypeId::FLOAT
-            && action->get_result_type() == TypeId::INT)
+        return {};
+    }
+
+    CodeGen::BinaryOpcodes CodeGen::get_float_binary_opcodes(ActionIndex action) const
+    {
+        switch(static_cast<FloatBinaryOperation>(m_actions->get_operands(action).data))
         {
-            push_instruction_long_op(Opcode::FLOAT_TO_INT, operand_position, action->position);
+            case FloatBinaryOperation::ADD:
+                return { Opcode::ADD_FLOAT, Opcode::ADD_FLOAT_RK, std::nullopt, std::nullopt, true };
+            case FloatBinaryOperation::SUBTRACT:
+                return { Opcode::SUBTRACT_FLOAT, Opcode::SUBTRACT_FLOAT_RK, Opcode::SUBTRACT_FLOAT_KR,
+                    std::nullopt, false };
+            case FloatBinaryOperation::MULTIPLY:
+                return { Opcode::MULTIPLY_FLOAT, Opcode::MULTIPLY_FLOAT_RK, std::nullopt, std::nullopt, true };
+            case FloatBinaryOperation::DIVIDE:
+                return { Opcode::DIVIDE_FLOAT, Opcode::DIVIDE_FLOAT_RK, Opcode::DIVIDE_FLOAT_KR, std::nullopt, false };
         }
+        return {};
     }
 
-    void CodeGen::gen_int_constant(const IntConstantAction* action)
+    Opcode CodeGen::get_numeric_conversion_opcode(ActionIndex action) const
+    {
+        const TypeId from_type = m_actions->get_result_type(m_actions->get_operands(action).lhs);
+        const TypeId to_type = m_actions->get_result_type(action);
+        if(from_type == TypeId::INT && to_type == TypeId::FLOAT) return Opcode::INT_TO_FLOAT;
+        if(from_type == TypeId::FLOAT && to_type == TypeId::INT) return Opcode::FLOAT_TO_INT;
+        return Opcode::MOVE;
+    }
+
+    void CodeGen::gen_int_constant(ActionIndex action, std::uint32_t destination)
     {
         push_instruction_two_op(
             Opcode::LOAD_CONSTANT,
-            m_next_available_register,
-            push_constant(action->get_value()),
-            action->position
+            destination,
+            push_constant(m_actions->get_int_constant(action)),
+            m_actions->get_offset(action)
         );
-
-        m_next_available_register++;
     }
 
-    void CodeGen::gen_float_constant(const FloatConstantAction* action)
+    void CodeGen::gen_float_constant(ActionIndex action, std::uint32_t destination)
     {
         push_instruction_two_op(
             Opcode::LOAD_CONSTANT,
-            m_next_available_register,
-            push_constant(action->get_value()),
-            action->position
+            destination,
+            push_constant(m_actions->get_float_constant(action)),
+            m_actions->get_offset(action)
         );
-
-        m_next_available_register++;
     }
 
-    void CodeGen::gen_stack_variable_access(const StackVariableAccessAction* action)
+    void CodeGen::gen_stack_variable_access(ActionIndex action, std::uint32_t destination)
     {
-        push_instruction_two_op(Opcode::MOVE, m_next_available_register, action->get_address(), action->position);
-        m_next_available_register++;
+        const std::uint32_t source = get_variable_register(action);
+        if(source == destination) return;
+
+        push_instruction_two_op(Opcode::MOVE, destination, source, m_actions->get_offset(action));
     }
 
 }
\ No newline at end of file
@@ -1,9 +1,15 @@
 #ifndef WF_CODE_GEN_HPP
 #define WF_CODE_GEN_HPP
 
+#include <limits>
+#include <optional>
+#include <span>
+
 #include "Compiler/Actions.hpp"
-#include "Compiler/Token.hpp"
-#include "Vm/Object.hpp"
+#include "Compiler/ErrorManager.hpp"
+#include "Compiler/RangeAnalysis.hpp"
+#include "Compiler/Source.hpp"
+#include "Vm/Module.hpp"
 #include "Utils/HashMap.hpp"
 
 namespace wf
@@ -11,41 +17,154 @@ namespace wf
     class CodeGen
     {
     public:
-        CodeGen(State* state, BytecodeObject* output_code);
+        // With `fast_math`, float multiplications feeding an addition are fused into fmaf, which rounds once.
+        CodeGen(State* state, const Source& source, BytecodeBuilder* output_code, bool fast_math = false);
 
-        void generate(const Action* action_tree);
+        // Fails if the code needs more registers or constants than instructions can address.
+        bool generate(const ActionTree& actions, ActionIndex root);
+        const String& get_error_message() const { return m_error_manager.get_message(); }
     private:
-        BytecodeObject* const m_output_code;
+        // Opcodes implementing one binary operation for each operand form.
+        struct BinaryOpcodes
+        {
+            Opcode register_register;
+            Opcode register_constant;
+            std::optional<Opcode> constant_register;
+            std::optional<Opcode> register_immediate;
+            bool is_commutative;
+            // Form without the check for a right operand of 0, for right operands known not to be 0.
+            std::optional<Opcode> register_register_nonzero = std::nullopt;
+        };
+
+        // Expressions are generated with an explicit stack instead of recursion, so deeply nested expressions
+        // cannot overflow the native stack.
+        enum class ExprStep : std::uint8_t
+        {
+            EXPRESSION,
+            // Evaluates the right operand of a REGISTER_REGISTER operation once the left one is done.
+            SECOND_OPERAND,
+            // Emits the instruction once all operand registers are on the operand stack.
+            EMIT,
+        };
+
+        enum class OperandForm : std::uint8_t
+        {
+            REGISTER,
+            REGISTER_IMMEDIATE,
+            REGISTER_CONSTANT,
+            CONSTANT_REGISTER,
+            REGISTER_REGISTER,
+            // fmaf: the addend is evaluated into the destination, followed by the two factors.
+            ACCUMULATE,
+        };
+
+        struct ExprFrame
+        {
+            ExprStep step;
+            OperandForm form = OperandForm::REGISTER;
+            Opcode opcode = Opcode::MOVE;
+            ActionIndex action = NO_ACTION;
+            std::uint32_t destination = 0;
+            std::uint32_t saved_next_register = 0;
+            // Immediate or constant index of the IMMEDIATE and CONSTANT forms.
+            std::uint32_t constant = 0;
+        };
+
+        // Ends the lists of dead variables.
+        static constexpr std::uint32_t NO_VARIABLE = std::numeric_limits<std::uint32_t>::max();
+
+        const Source& m_source;
+        ErrorManager m_error_manager;
+        BytecodeBuilder* const m_output_code;
+        const bool m_fast_math;
+        const ActionTree* m_actions = nullptr;
+        DynamicArray<ExprFrame> m_expr_stack;
+        DynamicArray<std::uint32_t> m_operand_registers;
+        DynamicArray<ActionIndex> m_action_stack;
+
+        // Variables get registers by linear scan over the statements of the block. A variable is live from its
+        // declaration up to the last statement reading it, after which its register is reused.
+        DynamicArray<std::uint32_t> m_variable_registers;
+        // Last statement reading each variable, or the declaring statement if nothing reads it.
+        DynamicArray<std::uint32_t> m_last_uses;
+        // Variables dying after each statement, as lists linked through m_next_dead_variables.
+        DynamicArray<std::uint32_t> m_first_dead_variables;
+        DynamicArray<std::uint32_t> m_next_dead_variables;
+        // Min-heap of registers released by dead variables, so the lowest free register is reused first.
+        DynamicArray<std::uint32_t> m_free_registers;
+        // Registers below this may hold variables, temporaries are allocated above them.
+        std::uint32_t m_variable_register_count = 0;
         std::uint32_t m_next_available_register = 0;
+        std::uint32_t m_register_count = 0;
         std::uint32_t m_last_line = 0;
+        // Drops the check of int divisions by values that cannot be 0.
+        RangeAnalysis m_ranges;
 
         HashMap<UInt, std::uint32_t> int_constant_map;
-        HashMap<Float, std::uint32_t> float_constant_map;
+        // Keyed by bit pattern, since 0.0 and -0.0 compare equal but are different constants.
+        HashMap<UInt, std::uint32_t> float_constant_map;
+        HashMap<UInt, std::uint32_t> division_magic_map;
 
         std::uint32_t push_constant(UInt value);
         std::uint32_t push_constant(Float value);
+        // Index of a divisor directly followed by its magic number, the operands of divi and modi by magic.
+        std::uint32_t push_division_magic(UInt divisor);
+
+        std::uint32_t allocate_register();
+
+        void push_instruction(Instruction instruction, SourceOffset offset);
+        void push_wide_instruction(Instruction prefix, Instruction instruction, SourceOffset offset);
+        void push_instruction(Opcode opcode, SourceOffset offset);
+        // Operands that do not fit the regular layout are encoded with a WIDE prefix.
+        void push_instruction_one_op(Opcode opcode, std::uint32_t op_a, SourceOffset offset);
+        void push_instruction_two_op(Opcode opcode, std::uint32_t op_a, std::uint32_t op_d, SourceOffset offset);
+        void push_instruction_three_op(Opcode opcode, std::uint32_t op_a, std::uint32_t op_b, std::uint32_t op_c,
+                SourceOffset offset);
+        void push_instruction_long_op(Opcode opcode, std::uint32_t operand, SourceOffset offset);
+        // Reports an operand too large for even a wide instruction. Only the first one is reported.
+        void push_operand_error(OperandKind kind, SourceOffset offset);
+
+        std::optional<std::uint32_t> get_constant_operand(ActionIndex action, std::uint32_t max_index);
+        std::optional<std::int32_t> get_immediate_operand(ActionIndex action) const;
+        bool reads_register(ActionIndex action, RegisterAddress address);
+
+        void compute_liveness(std::span<const ActionIndex> statements, std::uint32_t variable_count);
+        std::uint32_t allocate_variable_register();
+        void release_dead_variables(std::uint32_t statement);
+        std::uint32_t get_variable_register(ActionIndex action) const;
+
+        void gen_action(ActionIndex action);
 
-        void push_instruction(Opcode opcode, const SourcePosition& position);
-        void push_instruction_two_op(Opcode opcode, std::uint32_t op_a, std::uint32_t op_b,
-                const SourcePosition& position);
-        void push_instruction_long_op(Opcode opcode, std::uint32_t operand,
-                const SourcePosition& position);
+        void gen_statement_block(ActionIndex action);
+        void gen_create_stack_variable(ActionIndex action);
+        void gen_return(ActionIndex action);
 
+        // Generates code that leaves the value of `action` in `destination`.
+        void gen_expr(ActionIndex action, std::uint32_t destination);
+        // Returns a register holding the value of `action`. Variables are read in place; anything else is
+        // evaluated into `scratch` if given, or into a newly allocated temporary register.
+        std::uint32_t gen_expr_register(ActionIndex action, std::optional<std::uint32_t> scratch = std::nullopt);
 
-        void gen_action(const Action* action);
+        // Pushes a step that evaluates `action` like gen_expr_register(), and the register that will hold its
+        // value onto the operand stack.
+        void push_operand(ActionIndex action, std::optional<std::uint32_t> scratch = std::nullopt);
+        void begin_expr(ActionIndex action, std::uint32_t destination);
+        void begin_operation(ActionIndex action, Opcode opcode, std::uint32_t destination);
+        void begin_binary_op(ActionIndex action, const BinaryOpcodes& opcodes, std::uint32_t destination);
+        Opcode get_register_register_opcode(const BinaryOpcodes& opcodes, ActionIndex right_operand);
+        // Replaces int multiplications, divisions and modulos by a constant with cheaper instructions.
+        void reduce_strength(ExprFrame& frame);
+        bool begin_fused_multiply_add(ActionIndex action, std::uint32_t destination);
+        void emit_expr(const ExprFrame& frame);
+        std::uint32_t pop_operand_register();
 
-        void gen_statement_block(const StatementBlockAction* action);
-        void gen_create_stack_variable(const CreateStackVariableAction* action);
-        void gen_return(const ReturnAction* action);
+        BinaryOpcodes get_int_binary_opcodes(ActionIndex action) const;
+        BinaryOpcodes get_float_binary_opcodes(ActionIndex action) const;
+        Opcode get_numeric_conversion_opcode(ActionIndex action) const;
 
-        void gen_int_binary_op(const IntBinaryAction* action);
-        void gen_float_binary_op(const FloatBinaryAction* action);
-        void gen_int_unary_op(const IntUnaryAction* action);
-        void gen_float_unary_op(const FloatUnaryAction* action);
-        void gen_numeric_conversion(const NumericConversionAction* action);
-        void gen_int_constant(const IntConstantAction* action);
-        void gen_float_constant(const FloatConstantAction* action);
-        void gen_stack_variable_access(const StackVariableAccessAction* action);
+        void gen_int_constant(ActionIndex action, std::uint32_t destination);
+        void gen_float_constant(ActionIndex action, std::uint32_t destination);
+        void gen_stack_variable_access(ActionIndex action, std::uint32_t destination);
     };
 }
 
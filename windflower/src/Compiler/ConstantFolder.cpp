@@ -0,0 +1,152 @@
+#include "ConstantFolder.hpp"
+
+#include <cmath>
+
+namespace wf
+{
+    ActionIndex ConstantFolder::add_int_binary(SourceOffset offset, IntBinaryOperation operation,
+            ActionIndex left_operand, ActionIndex right_operand)
+    {
+        // Ints are unsigned in the VM, so they wrap and divide as UInt.
+        const std::optional<UInt> left = get_int_constant(left_operand);
+        const std::optional<UInt> right = get_int_constant(right_operand);
+
+        if(left.has_value() && right.has_value())
+        {
+            switch(operation)
+            {
+                case IntBinaryOperation::ADD:
+                    return m_actions->add_int_constant(offset, left.value() + right.value());
+                case IntBinaryOperation::SUBTRACT:
+                    return m_actions->add_int_constant(offset, left.value() - right.value());
+                case IntBinaryOperation::MULTIPLY:
+                    return m_actions->add_int_constant(offset, left.value() * right.value());
+                // Division by zero is left to report its error at runtime.
+                case IntBinaryOperation::DIVIDE:
+                    if(right.value() == 0) break;
+                    return m_actions->add_int_constant(offset, left.value() / right.value());
+                case IntBinaryOperation::MODULO:
+                    if(right.value() == 0) break;
+                    return m_actions->add_int_constant(offset, left.value() % right.value());
+            }
+        }
+
+        switch(operation)
+        {
+            case IntBinaryOperation::ADD:
+                if(right == 0u) return left_operand;
+                if(left == 0u) return right_operand;
+                break;
+            case IntBinaryOperation::SUBTRACT:
+                if(right == 0u) return left_operand;
+                break;
+            case IntBinaryOperation::MULTIPLY:
+                if(right == 1u) return left_operand;
+                if(left == 1u) return right_operand;
+                break;
+            case IntBinaryOperation::DIVIDE:
+                if(right == 1u) return left_operand;
+                break;
+            case IntBinaryOperation::MODULO:
+                break;
+        }
+
+        return m_actions->add_action(ActionType::INT_BINARY, TypeId::INT, offset,
+                { left_operand, right_operand, static_cast<std::uint32_t>(operation) });
+    }
+
+    ActionIndex ConstantFolder::add_float_binary(SourceOffset offset, FloatBinaryOperation operation,
+            ActionIndex left_operand, ActionIndex right_operand)
+    {
+        const std::optional<Float> left = get_float_constant(left_operand);
+        const std::optional<Float> right = get_float_constant(right_operand);
+
+        if(left.has_value() && right.has_value())
+        {
+            switch(operation)
+            {
+                case FloatBinaryOperation::ADD:
+                    return m_actions->add_float_constant(offset, left.value() + right.value());
+                case FloatBinaryOperation::SUBTRACT:
+                    return m_actions->add_float_constant(offset, left.value() - right.value());
+                case FloatBinaryOperation::MULTIPLY:
+                    return m_actions->add_float_constant(offset, left.value() * right.value());
+                case FloatBinaryOperation::DIVIDE:
+                    return m_actions->add_float_constant(offset, left.value() / right.value());
+            }
+        }
+
+        // Only identities that also hold for signed zeros and NaNs: x + 0.0 turns -0.0 into 0.0, x + -0.0 does not.
+        const bool right_is_zero = right.has_value() && right.value() == 0.0;
+        switch(operation)
+        {
+            case FloatBinaryOperation::ADD:
+                if(right_is_zero && std::signbit(right.value())) return left_operand;
+                if(left.has_value() && left.value() == 0.0 && std::signbit(left.value())) return right_operand;
+                break;
+            case FloatBinaryOperation::SUBTRACT:
+                if(right_is_zero && !std::signbit(right.value())) return left_operand;
+                break;
+            case FloatBinaryOperation::MULTIPLY:
+                if(right == 1.0) return left_operand;
+                if(left == 1.0) return right_operand;
+                break;
+            case FloatBinaryOperation::DIVIDE:
+                if(right == 1.0) return left_operand;
+                break;
+        }
+
+        return m_actions->add_action(ActionType::FLOAT_BINARY, TypeId::FLOAT, offset,
+                { left_operand, right_operand, static_cast<std::uint32_t>(operation) });
+    }
+
+    ActionIndex ConstantFolder::add_negation(SourceOffset offset, ActionIndex operand)
+    {
+        const ActionType type = m_actions->get_result_type(operand) == TypeId::INT
+            ? ActionType::INT_UNARY : ActionType::FLOAT_UNARY;
+
+        if(const std::optional<UInt> value = get_int_constant(operand); value.has_value())
+        {
+            return m_actions->add_int_constant(offset, UInt(0) - value.value());
+        }
+        if(const std::optional<Float> value = get_float_constant(operand); value.has_value())
+        {
+            return m_actions->add_float_constant(offset, -value.value());
+        }
+
+        // -(-x)
+        if(m_actions->get_type(operand) == type
+            && m_actions->get_operands(operand).data == static_cast<std::uint32_t>(NumericUnaryOperation::NEGATION))
+        {
+            return m_actions->get_operands(operand).lhs;
+        }
+
+        return m_actions->add_action(type, m_actions->get_result_type(operand), offset,
+                { .lhs = operand, .data = static_cast<std::uint32_t>(NumericUnaryOperation::NEGATION) });
+    }
+
+    ActionIndex ConstantFolder::add_numeric_conversion(SourceOffset offset, TypeId to_type, ActionIndex operand)
+    {
+        if(m_actions->get_result_type(operand) == to_type) return operand;
+
+        // Float to int conversions are not folded, out of range values have no defined result.
+        if(const std::optional<UInt> value = get_int_constant(operand); value.has_value() && to_type == TypeId::FLOAT)
+        {
+            return m_actions->add_float_constant(offset, static_cast<Float>(static_cast<Int>(value.value())));
+        }
+
+        return m_actions->add_action(ActionType::NUMERIC_CONVERSION, to_type, offset, { .lhs = operand });
+    }
+
+    std::optional<UInt> ConstantFolder::get_int_constant(ActionIndex action) const
+    {
+        if(m_actions->get_type(action) != ActionType::INT_CONSTANT) return std::nullopt;
+        return m_actions->get_int_constant(action);
+    }
+
+    std::optional<Float> ConstantFolder::get_float_constant(ActionIndex action) const
+    {
+        if(m_actions->get_type(action) != ActionType::FLOAT_CONSTANT) return std::nullopt;
+        return m_actions->get_float_constant(action);
+    }
+}
\ No newline at end of file
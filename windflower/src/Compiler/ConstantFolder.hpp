@@ -0,0 +1,35 @@
+#ifndef WF_CONSTANT_FOLDER_HPP
+#define WF_CONSTANT_FOLDER_HPP
+
+#include <optional>
+
+#include "Compiler/Actions.hpp"
+
+namespace wf
+{
+    // Adds expression actions to an ActionTree, evaluating operations on constants and dropping operations that
+    // leave their operand unchanged. Since operands are always added before the operations using them, this
+    // folds whole constant subtrees bottom-up. Folded values are computed exactly as the VM would compute them.
+    class ConstantFolder
+    {
+    public:
+        explicit ConstantFolder(ActionTree* actions)
+            : m_actions(actions)
+        {
+        }
+
+        ActionIndex add_int_binary(SourceOffset offset, IntBinaryOperation operation, ActionIndex left_operand,
+                ActionIndex right_operand);
+        ActionIndex add_float_binary(SourceOffset offset, FloatBinaryOperation operation, ActionIndex left_operand,
+                ActionIndex right_operand);
+        ActionIndex add_negation(SourceOffset offset, ActionIndex operand);
+        ActionIndex add_numeric_conversion(SourceOffset offset, TypeId to_type, ActionIndex operand);
+    private:
+        ActionTree* const m_actions;
+
+        std::optional<UInt> get_int_constant(ActionIndex action) const;
+        std::optional<Float> get_float_constant(ActionIndex action) const;
+    };
+}
+
+#endif
\ No newline at end of file
@@ -1,7 +1,7 @@
 #ifndef WF_ERROR_MANAGER_HPP
 #define WF_ERROR_MANAGER_HPP
 
-#include "Token.hpp"
+#include "Source.hpp"
 #include "Utils/Format.hpp"
 
 template<>
@@ -25,15 +25,16 @@ namespace wf
     class ErrorManager
     {
     public:
-        ErrorManager(State* state)
-            : m_message(state)
+        ErrorManager(State* state, const Source& source)
+            : m_source(source), m_message(state)
         {
         }
 
         template<typename... Args>
-        void push_error(const SourcePosition& position, fmt::format_string<Args...> format_str, Args&&... args)
+        void push_error(SourceOffset offset, fmt::format_string<Args...> format_str, Args&&... args)
         {
             m_has_errors = true;
+            const SourcePosition position = m_source.get_position(offset);
             fmt::format_to(std::back_inserter(m_message), "\n{}{} Error: ", position.source_name, position);
             fmt::format_to(std::back_inserter(m_message), format_str, std::forward<Args>(args)...);
         }
@@ -41,6 +42,7 @@ namespace wf
         bool has_errors() const { return m_has_errors; }
         const String& get_message() const { return m_message; }
     private:
+        const Source& m_source;
         bool m_has_errors = false;
         String m_message;
     };
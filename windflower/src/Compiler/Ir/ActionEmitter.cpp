@@ -0,0 +1,170 @@
+#include "ActionEmitter.hpp"
+
+namespace wf
+{
+    ActionEmitter::ActionEmitter(State* state, const IrFunction* function, ActionTree* output)
+        : m_function(function), m_output(output), m_folder(output), m_use_counts(state), m_value_actions(state),
+            m_value_addresses(state), m_statements(state)
+    {
+    }
+
+    ActionIndex ActionEmitter::emit()
+    {
+        // Every other block is unreachable and has been removed by the optimizer.
+        const IrBlock& block = m_function->get_blocks().front();
+        const IrValue terminator = block.first + block.count - 1;
+
+        m_use_counts.assign(m_function->get_instruction_count(), 0);
+        m_value_actions.assign(m_function->get_instruction_count(), NO_ACTION);
+        m_value_addresses.assign(m_function->get_instruction_count(), NO_ADDRESS);
+        count_uses(block);
+
+        if(m_function->get_opcode(terminator) == IrOpcode::END && m_function->get_operands(terminator).lhs != NO_IR_VALUE)
+        {
+            m_end_value = m_function->get_operands(terminator).lhs;
+            m_address_count = 1;
+        }
+        m_first_variable_address = m_address_count;
+        m_address_count += m_function->get_variable_count();
+
+        for(IrValue value = block.first; value < block.first + block.count; value++)
+        {
+            emit_instruction(value);
+        }
+
+        return m_output->add_action(ActionType::STATEMENT_BLOCK, TypeId::VOID, block.offset, {
+            m_output->add_extra(m_statements),
+            static_cast<std::uint32_t>(m_statements.size()),
+            m_address_count
+        });
+    }
+
+    void ActionEmitter::count_uses(const IrBlock& block)
+    {
+        for(IrValue value = block.first; value < block.first + block.count; value++)
+        {
+            const IrOpcode opcode = m_function->get_opcode(value);
+            const IrOperands& operands = m_function->get_operands(value);
+            if(ir_opcode_reads_lhs(opcode) && operands.lhs != NO_IR_VALUE) m_use_counts[operands.lhs]++;
+            if(ir_opcode_reads_rhs(opcode)) m_use_counts[operands.rhs]++;
+        }
+    }
+
+    void ActionEmitter::emit_instruction(IrValue value)
+    {
+        const IrOperands& operands = m_function->get_operands(value);
+        const SourceOffset offset = m_function->get_offset(value);
+        switch(m_function->get_opcode(value))
+        {
+            // Constants are emitted at each use, where the code generator can encode them as operands.
+            case IrOpcode::NOP:
+            case IrOpcode::INT_CONSTANT:
+            case IrOpcode::FLOAT_CONSTANT:
+                break;
+            case IrOpcode::LOAD_VARIABLE:
+                m_value_actions[value] = m_output->add_action(ActionType::STACK_VARIABLE_ACCESS,
+                        m_function->get_type(value), offset, { .data = m_first_variable_address + operands.data });
+                break;
+            case IrOpcode::STORE_VARIABLE:
+                m_statements.push_back(m_output->add_action(ActionType::CREATE_STACK_VAR, TypeId::VOID, offset,
+                        { .lhs = emit_operand(operands.lhs), .data = m_first_variable_address + operands.data }));
+                break;
+            case IrOpcode::RETURN:
+                m_statements.push_back(m_output->add_action(ActionType::RETURN, TypeId::VOID, offset, {}));
+                break;
+            case IrOpcode::RETURN_VALUE:
+                m_statements.push_back(m_output->add_action(ActionType::RETURN, TypeId::VOID, offset,
+                        { .lhs = emit_operand(operands.lhs) }));
+                break;
+            case IrOpcode::END:
+                if(m_end_value != NO_IR_VALUE && m_value_addresses[m_end_value] != 0)
+                {
+                    m_statements.push_back(m_output->add_action(ActionType::CREATE_STACK_VAR, TypeId::VOID,
+                            m_function->get_offset(m_end_value), { .lhs = emit_operand(m_end_value), .data = 0 }));
+                }
+                break;
+            case IrOpcode::INT_UNARY:
+            case IrOpcode::FLOAT_UNARY:
+            case IrOpcode::INT_BINARY:
+            case IrOpcode::FLOAT_BINARY:
+            case IrOpcode::NUMERIC_CONVERSION:
+                emit_operation(value);
+                break;
+        }
+    }
+
+    void ActionEmitter::emit_operation(IrValue value)
+    {
+        const IrOperands& operands = m_function->get_operands(value);
+        const SourceOffset offset = m_function->get_offset(value);
+
+        ActionIndex action = NO_ACTION;
+        switch(m_function->get_opcode(value))
+        {
+            case IrOpcode::INT_UNARY:
+            case IrOpcode::FLOAT_UNARY:
+                action = m_folder.add_negation(offset, emit_operand(operands.lhs));
+                break;
+            case IrOpcode::NUMERIC_CONVERSION:
+                action = m_folder.add_numeric_conversion(offset, m_function->get_type(value),
+                        emit_operand(operands.lhs));
+                break;
+            case IrOpcode::INT_BINARY:
+                action = m_folder.add_int_binary(offset, static_cast<IntBinaryOperation>(operands.data),
+                        emit_operand(operands.lhs), emit_operand(operands.rhs));
+                break;
+            case IrOpcode::FLOAT_BINARY:
+                action = m_folder.add_float_binary(offset, static_cast<FloatBinaryOperation>(operands.data),
+                        emit_operand(operands.lhs), emit_operand(operands.rhs));
+                break;
+            default:
+                break;
+        }
+
+        m_value_actions[value] = action;
+
+        // A folded constant is encoded directly into its users.
+        const ActionType action_type = m_output->get_type(action);
+        if(action_type == ActionType::INT_CONSTANT || action_type == ActionType::FLOAT_CONSTANT) return;
+        if(!needs_own_register(value)) return;
+
+        // The value only has to be computed for the division by zero it may report.
+        if(m_use_counts[value] == 0)
+        {
+            m_statements.push_back(action);
+            return;
+        }
+
+        const std::uint32_t address = value == m_end_value? 0 : m_address_count++;
+        m_value_addresses[value] = address;
+        m_statements.push_back(m_output->add_action(ActionType::CREATE_STACK_VAR, TypeId::VOID, offset,
+                { .lhs = action, .data = address }));
+    }
+
+    ActionIndex ActionEmitter::emit_operand(IrValue value)
+    {
+        const SourceOffset offset = m_function->get_offset(value);
+        switch(m_function->get_opcode(value))
+        {
+            case IrOpcode::INT_CONSTANT:
+                return m_output->add_int_constant(offset, m_function->get_int_constant(value));
+            case IrOpcode::FLOAT_CONSTANT:
+                return m_output->add_float_constant(offset, m_function->get_float_constant(value));
+            default:
+                break;
+        }
+
+        if(m_value_addresses[value] != NO_ADDRESS)
+        {
+            return m_output->add_action(ActionType::STACK_VARIABLE_ACCESS, m_function->get_type(value), offset,
+                    { .data = m_value_addresses[value] });
+        }
+        return m_value_actions[value];
+    }
+
+    bool ActionEmitter::needs_own_register(IrValue value) const
+    {
+        // Divisions that may fail are kept in program order, so the first one to fail reports the error.
+        return m_use_counts[value] > 1 || m_function->has_side_effects(value);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef WF_ACTION_EMITTER_HPP
+#define WF_ACTION_EMITTER_HPP
+
+#include "Compiler/ConstantFolder.hpp"
+#include "Compiler/Ir/Ir.hpp"
+
+namespace wf
+{
+    // Turns an optimized IrFunction back into a statement block for the code generator. Values used more than
+    // once, and divisions that may fail, are computed once in program order into a register of their own. Every
+    // other value is inlined into the expression using it. Operations on values that turn out to be constants
+    // are folded along the way.
+    class ActionEmitter
+    {
+    public:
+        ActionEmitter(State* state, const IrFunction* function, ActionTree* output);
+
+        ActionIndex emit();
+    private:
+        static constexpr std::uint32_t NO_ADDRESS = std::numeric_limits<std::uint32_t>::max();
+
+        const IrFunction* const m_function;
+        ActionTree* const m_output;
+        ConstantFolder m_folder;
+        DynamicArray<std::uint32_t> m_use_counts;
+        // Expression computing each value that is inlined into its user.
+        DynamicArray<ActionIndex> m_value_actions;
+        // Register of each value computed into a register of its own, or NO_ADDRESS.
+        DynamicArray<std::uint32_t> m_value_addresses;
+        DynamicArray<ActionIndex> m_statements;
+        // Value the final return reads from register 0, which is kept free for it.
+        IrValue m_end_value = NO_IR_VALUE;
+        std::uint32_t m_first_variable_address = 0;
+        std::uint32_t m_address_count = 0;
+
+        void count_uses(const IrBlock& block);
+        void emit_instruction(IrValue value);
+        void emit_operation(IrValue value);
+        // Returns an expression reading `value`, for use as the operand of another action.
+        ActionIndex emit_operand(IrValue value);
+        bool needs_own_register(IrValue value) const;
+    };
+}
+
+#endif
\ No newline at end of file
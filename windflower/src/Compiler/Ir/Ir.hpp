@@ -0,0 +1,196 @@
+#ifndef WF_IR_HPP
+#define WF_IR_HPP
+
+#include <limits>
+#include <span>
+
+#include "Compiler/Actions.hpp"
+
+namespace wf
+{
+    // A value is identified by the index of the instruction defining it, so every value has exactly one
+    // definition.
+    using IrValue = std::uint32_t;
+    constexpr IrValue NO_IR_VALUE = std::numeric_limits<IrValue>::max();
+
+    enum class IrOpcode : std::uint8_t
+    {
+        // Instruction removed by an optimization pass. Removed instructions keep their index, so the indices of
+        // the remaining values never change.
+        NOP,
+
+        INT_CONSTANT,
+        FLOAT_CONSTANT,
+
+        INT_UNARY,
+        FLOAT_UNARY,
+        INT_BINARY,
+        FLOAT_BINARY,
+        NUMERIC_CONVERSION,
+
+        // Variables live in memory rather than in values, so they can be assigned more than once. Copy
+        // propagation forwards stored values to the loads, after which the program is in pure SSA form.
+        LOAD_VARIABLE,
+        STORE_VARIABLE,
+
+        RETURN,
+        RETURN_VALUE,
+        // Falls off the end of the program. The code generator then returns whatever register 0 holds, which is
+        // the first variable if there is one.
+        END,
+    };
+
+    // Operands of an instruction. Their meaning depends on the opcode:
+    //
+    //  INT_CONSTANT              data: index into the int constants
+    //  FLOAT_CONSTANT            data: index into the float constants
+    //  INT_UNARY, FLOAT_UNARY    lhs: operand, data: NumericUnaryOperation
+    //  INT_BINARY                lhs: left operand, rhs: right operand, data: IntBinaryOperation
+    //  FLOAT_BINARY              lhs: left operand, rhs: right operand, data: FloatBinaryOperation
+    //  NUMERIC_CONVERSION        lhs: operand
+    //  LOAD_VARIABLE             data: variable
+    //  STORE_VARIABLE            lhs: stored value, data: variable
+    //  RETURN_VALUE              lhs: returned value
+    //  END                       lhs: value left in register 0 or NO_IR_VALUE
+    struct IrOperands
+    {
+        IrValue lhs = NO_IR_VALUE;
+        IrValue rhs = NO_IR_VALUE;
+        std::uint32_t data = 0;
+    };
+
+    // Instructions [first, first + count) of a function, ending with its only terminator. Blocks never branch, so
+    // each one after the entry block follows a return and is unreachable.
+    struct IrBlock
+    {
+        std::uint32_t first;
+        std::uint32_t count;
+        SourceOffset offset;
+    };
+
+    constexpr bool ir_opcode_is_terminator(IrOpcode opcode)
+    {
+        return opcode == IrOpcode::RETURN || opcode == IrOpcode::RETURN_VALUE || opcode == IrOpcode::END;
+    }
+
+    constexpr bool ir_opcode_reads_lhs(IrOpcode opcode)
+    {
+        switch(opcode)
+        {
+            case IrOpcode::INT_UNARY:
+            case IrOpcode::FLOAT_UNARY:
+            case IrOpcode::INT_BINARY:
+            case IrOpcode::FLOAT_BINARY:
+            case IrOpcode::NUMERIC_CONVERSION:
+            case IrOpcode::STORE_VARIABLE:
+            case IrOpcode::RETURN_VALUE:
+            case IrOpcode::END:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    constexpr bool ir_opcode_reads_rhs(IrOpcode opcode)
+    {
+        return opcode == IrOpcode::INT_BINARY || opcode == IrOpcode::FLOAT_BINARY;
+    }
+
+    // Single function in SSA form, stored flat in parallel arrays like the ActionTree it is built from. Operands
+    // always precede the instructions using them.
+    class IrFunction
+    {
+    public:
+        explicit IrFunction(State* state)
+            : m_opcodes(state), m_types(state), m_offsets(state), m_operands(state), m_blocks(state),
+                m_int_constants(state), m_float_constants(state)
+        {
+        }
+
+        IrValue add_instruction(IrOpcode opcode, TypeId type, SourceOffset offset, const IrOperands& operands)
+        {
+            const IrValue value = static_cast<IrValue>(m_opcodes.size());
+            m_opcodes.push_back(opcode);
+            m_types.push_back(type);
+            m_offsets.push_back(offset);
+            m_operands.push_back(operands);
+            m_blocks.back().count++;
+            return value;
+        }
+
+        IrValue add_int_constant(SourceOffset offset, UInt value)
+        {
+            m_int_constants.push_back(value);
+            return add_instruction(IrOpcode::INT_CONSTANT, TypeId::INT, offset,
+                    { .data = static_cast<std::uint32_t>(m_int_constants.size() - 1) });
+        }
+
+        IrValue add_float_constant(SourceOffset offset, Float value)
+        {
+            m_float_constants.push_back(value);
+            return add_instruction(IrOpcode::FLOAT_CONSTANT, TypeId::FLOAT, offset,
+                    { .data = static_cast<std::uint32_t>(m_float_constants.size() - 1) });
+        }
+
+        // Instructions added from now on go into a new block.
+        void begin_block(SourceOffset offset)
+        {
+            m_blocks.push_back({ static_cast<std::uint32_t>(m_opcodes.size()), 0, offset });
+        }
+
+        void remove_block(std::size_t index)
+        {
+            const IrBlock& block = m_blocks[index];
+            for(IrValue value = block.first; value < block.first + block.count; value++)
+            {
+                remove_instruction(value);
+            }
+            m_blocks.erase(m_blocks.begin() + static_cast<std::ptrdiff_t>(index));
+        }
+
+        void remove_instruction(IrValue value) { m_opcodes[value] = IrOpcode::NOP; }
+
+        void set_operands(IrValue value, const IrOperands& operands) { m_operands[value] = operands; }
+
+        void set_variable_count(std::uint32_t count) { m_variable_count = count; }
+
+        std::size_t get_instruction_count() const { return m_opcodes.size(); }
+        std::uint32_t get_variable_count() const { return m_variable_count; }
+        std::span<const IrBlock> get_blocks() const { return m_blocks; }
+
+        IrOpcode get_opcode(IrValue value) const { return m_opcodes[value]; }
+        TypeId get_type(IrValue value) const { return m_types[value]; }
+        SourceOffset get_offset(IrValue value) const { return m_offsets[value]; }
+        const IrOperands& get_operands(IrValue value) const { return m_operands[value]; }
+
+        UInt get_int_constant(IrValue value) const { return m_int_constants[m_operands[value].data]; }
+        Float get_float_constant(IrValue value) const { return m_float_constants[m_operands[value].data]; }
+
+        // True if the instruction must run even when its value is unused: stores, terminators and integer
+        // divisions that may report a division by zero.
+        bool has_side_effects(IrValue value) const
+        {
+            const IrOpcode opcode = m_opcodes[value];
+            if(opcode == IrOpcode::STORE_VARIABLE || ir_opcode_is_terminator(opcode)) return true;
+            if(opcode != IrOpcode::INT_BINARY) return false;
+
+            const IrOperands& operands = m_operands[value];
+            const auto operation = static_cast<IntBinaryOperation>(operands.data);
+            if(operation != IntBinaryOperation::DIVIDE && operation != IntBinaryOperation::MODULO) return false;
+
+            return m_opcodes[operands.rhs] != IrOpcode::INT_CONSTANT || get_int_constant(operands.rhs) == 0;
+        }
+    private:
+        DynamicArray<IrOpcode> m_opcodes;
+        DynamicArray<TypeId> m_types;
+        DynamicArray<SourceOffset> m_offsets;
+        DynamicArray<IrOperands> m_operands;
+        DynamicArray<IrBlock> m_blocks;
+        std::uint32_t m_variable_count = 0;
+
+        DynamicArray<UInt> m_int_constants;
+        DynamicArray<Float> m_float_constants;
+    };
+}
+
+#endif
\ No newline at end of file
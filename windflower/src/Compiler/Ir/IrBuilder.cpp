@@ -0,0 +1,136 @@
+#include "IrBuilder.hpp"
+
+#include <cassert>
+
+namespace wf
+{
+    IrBuilder::IrBuilder(State* state, const ActionTree* actions, IrFunction* output)
+        : m_actions(actions), m_output(output), m_expr_stack(state), m_expr_results(state)
+    {
+    }
+
+    void IrBuilder::build(ActionIndex root)
+    {
+        assert(m_actions->get_type(root) == ActionType::STATEMENT_BLOCK);
+        const ActionOperands& operands = m_actions->get_operands(root);
+
+        m_output->set_variable_count(operands.data);
+        m_output->begin_block(m_actions->get_offset(root));
+        for(ActionIndex statement : m_actions->get_extra(operands.lhs, operands.rhs))
+        {
+            build_statement(statement);
+        }
+        build_end();
+    }
+
+    void IrBuilder::build_statement(ActionIndex action)
+    {
+        const ActionOperands& operands = m_actions->get_operands(action);
+        const SourceOffset offset = m_actions->get_offset(action);
+        switch(m_actions->get_type(action))
+        {
+            case ActionType::CREATE_STACK_VAR:
+            {
+                const IrValue value = build_expr(operands.lhs);
+                if(operands.data == 0) m_first_variable_type = m_output->get_type(value);
+                m_output->add_instruction(IrOpcode::STORE_VARIABLE, TypeId::VOID, offset,
+                        { .lhs = value, .data = operands.data });
+                break;
+            }
+            case ActionType::RETURN:
+                if(operands.lhs == NO_ACTION)
+                {
+                    m_output->add_instruction(IrOpcode::RETURN, TypeId::VOID, offset, {});
+                }
+                else
+                {
+                    m_output->add_instruction(IrOpcode::RETURN_VALUE, TypeId::VOID, offset,
+                            { .lhs = build_expr(operands.lhs) });
+                }
+                m_output->begin_block(offset);
+                break;
+            default:
+                // The resolver only produces declarations and returns inside the root block.
+                assert(false);
+                break;
+        }
+    }
+
+    void IrBuilder::build_end()
+    {
+        // The code generator ends the program by returning register 0, which holds the first variable. Without
+        // variables nothing reaching the end writes it.
+        IrValue register_value = NO_IR_VALUE;
+        if(m_output->get_variable_count() > 0)
+        {
+            register_value = m_output->add_instruction(IrOpcode::LOAD_VARIABLE, m_first_variable_type,
+                    NO_SOURCE_OFFSET, { .data = 0 });
+        }
+        m_output->add_instruction(IrOpcode::END, TypeId::VOID, NO_SOURCE_OFFSET, { .lhs = register_value });
+    }
+
+    IrValue IrBuilder::build_expr(ActionIndex root)
+    {
+        const std::size_t stack_begin = m_expr_stack.size();
+        m_expr_stack.push_back({ root, false });
+
+        while(m_expr_stack.size() > stack_begin)
+        {
+            const ExprFrame frame = m_expr_stack.back();
+            m_expr_stack.pop_back();
+
+            const ActionIndex action = frame.action;
+            const ActionOperands& operands = m_actions->get_operands(action);
+            const TypeId type = m_actions->get_result_type(action);
+            const SourceOffset offset = m_actions->get_offset(action);
+
+            IrOpcode opcode;
+            switch(m_actions->get_type(action))
+            {
+                case ActionType::INT_CONSTANT:
+                    m_expr_results.push_back(m_output->add_int_constant(offset, m_actions->get_int_constant(action)));
+                    continue;
+                case ActionType::FLOAT_CONSTANT:
+                    m_expr_results.push_back(
+                        m_output->add_float_constant(offset, m_actions->get_float_constant(action)));
+                    continue;
+                case ActionType::STACK_VARIABLE_ACCESS:
+                    m_expr_results.push_back(m_output->add_instruction(IrOpcode::LOAD_VARIABLE, type, offset,
+                            { .data = operands.data }));
+                    continue;
+                case ActionType::INT_UNARY: opcode = IrOpcode::INT_UNARY; break;
+                case ActionType::FLOAT_UNARY: opcode = IrOpcode::FLOAT_UNARY; break;
+                case ActionType::NUMERIC_CONVERSION: opcode = IrOpcode::NUMERIC_CONVERSION; break;
+                case ActionType::INT_BINARY: opcode = IrOpcode::INT_BINARY; break;
+                case ActionType::FLOAT_BINARY: opcode = IrOpcode::FLOAT_BINARY; break;
+                default:
+                    assert(false);
+                    continue;
+            }
+
+            const bool is_binary = ir_opcode_reads_rhs(opcode);
+            if(!frame.operands_built)
+            {
+                // Operands are lowered left to right, in the order the code generator evaluates them.
+                m_expr_stack.push_back({ action, true });
+                if(is_binary) m_expr_stack.push_back({ operands.rhs, false });
+                m_expr_stack.push_back({ operands.lhs, false });
+                continue;
+            }
+
+            const IrValue right = is_binary? pop_expr_result() : NO_IR_VALUE;
+            const IrValue left = pop_expr_result();
+            m_expr_results.push_back(m_output->add_instruction(opcode, type, offset,
+                    { .lhs = left, .rhs = right, .data = operands.data }));
+        }
+
+        return pop_expr_result();
+    }
+
+    IrValue IrBuilder::pop_expr_result()
+    {
+        const IrValue result = m_expr_results.back();
+        m_expr_results.pop_back();
+        return result;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef WF_IR_BUILDER_HPP
+#define WF_IR_BUILDER_HPP
+
+#include "Compiler/Ir/Ir.hpp"
+
+namespace wf
+{
+    // Lowers the statement block produced by the resolver to an IrFunction. A new block begins after every
+    // return, and variables become loads and stores of IR variables with the same addresses.
+    class IrBuilder
+    {
+    public:
+        IrBuilder(State* state, const ActionTree* actions, IrFunction* output);
+
+        void build(ActionIndex root);
+    private:
+        struct ExprFrame
+        {
+            ActionIndex action;
+            bool operands_built;
+        };
+
+        const ActionTree* const m_actions;
+        IrFunction* const m_output;
+        DynamicArray<ExprFrame> m_expr_stack;
+        DynamicArray<IrValue> m_expr_results;
+        TypeId m_first_variable_type = TypeId::VOID;
+
+        void build_statement(ActionIndex action);
+        void build_end();
+        // Expressions are lowered with an explicit stack like everywhere else in the compiler.
+        IrValue build_expr(ActionIndex root);
+        IrValue pop_expr_result();
+    };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include "IrOptimizer.hpp"
+
+#include <bit>
+#include <numeric>
+
+#include "Compiler/Ir/ActionEmitter.hpp"
+#include "Compiler/Ir/IrBuilder.hpp"
+#include "Utils/HashMap.hpp"
+
+namespace wf
+{
+    // Marks a variable that is not used anymore.
+    static constexpr std::uint32_t NO_VARIABLE = std::numeric_limits<std::uint32_t>::max();
+
+    ActionIndex optimize_actions(State* state, const ActionTree& actions, ActionIndex root, ActionTree* output)
+    {
+        IrFunction function(state);
+        IrBuilder(state, &actions, &function).build(root);
+        IrOptimizer(state, &function).optimize();
+        return ActionEmitter(state, &function, output).emit();
+    }
+
+    std::size_t IrOptimizer::ValueKeyHash::operator()(const ValueKey& key) const
+    {
+        const UInt parts[] = {
+            static_cast<UInt>(key.opcode) | static_cast<UInt>(key.type) << 8,
+            static_cast<UInt>(key.lhs) | static_cast<UInt>(key.rhs) << 32,
+        };
+
+        UInt hash = key.data;
+        for(UInt part : parts)
+        {
+            hash = (hash ^ part) * 0x9E3779B97F4A7C15u;
+            hash ^= hash >> 32;
+        }
+        return static_cast<std::size_t>(hash);
+    }
+
+    IrOptimizer::IrOptimizer(State* state, IrFunction* function)
+        : m_state(state), m_function(function), m_replacements(state)
+    {
+    }
+
+    void IrOptimizer::optimize()
+    {
+        remove_unreachable_blocks();
+        propagate_copies();
+        eliminate_common_subexpressions();
+        eliminate_dead_stores();
+        eliminate_dead_code();
+        remove_unused_variables();
+    }
+
+    void IrOptimizer::remove_unreachable_blocks()
+    {
+        // Blocks never branch and every block ends with a terminator, so only the entry block is ever entered.
+        for(std::size_t index = m_function->get_blocks().size(); index-- > 1;)
+        {
+            m_function->remove_block(index);
+        }
+    }
+
+    void IrOptimizer::propagate_copies()
+    {
+        reset_replacements();
+
+        DynamicArray<IrValue> stored_values(m_function->get_variable_count(), NO_IR_VALUE, m_state);
+        for(const IrBlock& block : m_function->get_blocks())
+        {
+            std::fill(stored_values.begin(), stored_values.end(), NO_IR_VALUE);
+            for(IrValue value = block.first; value < block.first + block.count; value++)
+            {
+                update_operands(value);
+
+                const IrOperands& operands = m_function->get_operands(value);
+                switch(m_function->get_opcode(value))
+                {
+                    case IrOpcode::STORE_VARIABLE:
+                        stored_values[operands.data] = operands.lhs;
+                        break;
+                    case IrOpcode::LOAD_VARIABLE:
+                        if(stored_values[operands.data] != NO_IR_VALUE)
+                        {
+                            replace(value, stored_values[operands.data]);
+                            m_function->remove_instruction(value);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    void IrOptimizer::eliminate_common_subexpressions()
+    {
+        reset_replacements();
+
+        HashMap<ValueKey, IrValue, ValueKeyHash> values(m_state);
+        for(const IrBlock& block : m_function->get_blocks())
+        {
+            values.clear();
+            for(IrValue value = block.first; value < block.first + block.count; value++)
+            {
+                update_operands(value);
+
+                switch(m_function->get_opcode(value))
+                {
+                    case IrOpcode::INT_CONSTANT:
+                    case IrOpcode::FLOAT_CONSTANT:
+                    case IrOpcode::INT_UNARY:
+                    case IrOpcode::FLOAT_UNARY:
+                    case IrOpcode::INT_BINARY:
+                    case IrOpcode::FLOAT_BINARY:
+                    case IrOpcode::NUMERIC_CONVERSION:
+                        break;
+                    default:
+                        continue;
+                }
+
+                // A repeated division that may fail is merged too, since the first one has already failed if the
+                // second one would.
+                const auto [it, inserted] = values.try_emplace(get_value_key(value), value);
+                if(!inserted)
+                {
+                    replace(value, it->second);
+                    m_function->remove_instruction(value);
+                }
+            }
+        }
+    }
+
+    void IrOptimizer::eliminate_dead_stores()
+    {
+        // Variables loaded later in the current block are marked with the current epoch, which changes per block
+        // so nothing has to be cleared.
+        DynamicArray<std::uint32_t> load_epochs(m_function->get_variable_count(), 0, m_state);
+        std::uint32_t epoch = 0;
+
+        const std::span<const IrBlock> blocks = m_function->get_blocks();
+        for(auto block = blocks.rbegin(); block != blocks.rend(); ++block)
+        {
+            epoch++;
+            for(IrValue value = block->first + block->count; value-- > block->first;)
+            {
+                const std::uint32_t variable = m_function->get_operands(value).data;
+                switch(m_function->get_opcode(value))
+                {
+                    case IrOpcode::LOAD_VARIABLE:
+                        load_epochs[variable] = epoch;
+                        break;
+                    case IrOpcode::STORE_VARIABLE:
+                        if(load_epochs[variable] != epoch)
+                        {
+                            m_function->remove_instruction(value);
+                        }
+                        // Loads before this store read an earlier one.
+                        load_epochs[variable] = 0;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    void IrOptimizer::eliminate_dead_code()
+    {
+        // Users follow their operands, so a backward walk sees every use of a value before the value itself.
+        DynamicArray<bool> is_used(m_function->get_instruction_count(), false, m_state);
+
+        const std::span<const IrBlock> blocks = m_function->get_blocks();
+        for(auto block = blocks.rbegin(); block != blocks.rend(); ++block)
+        {
+            for(IrValue value = block->first + block->count; value-- > block->first;)
+            {
+                const IrOpcode opcode = m_function->get_opcode(value);
+                if(opcode == IrOpcode::NOP) continue;
+
+                if(!is_used[value] && !m_function->has_side_effects(value))
+                {
+                    m_function->remove_instruction(value);
+                    continue;
+                }
+
+                const IrOperands& operands = m_function->get_operands(value);
+                if(ir_opcode_reads_lhs(opcode) && operands.lhs != NO_IR_VALUE) is_used[operands.lhs] = true;
+                if(ir_opcode_reads_rhs(opcode)) is_used[operands.rhs] = true;
+            }
+        }
+    }
+
+    void IrOptimizer::remove_unused_variables()
+    {
+        DynamicArray<std::uint32_t> new_variables(m_function->get_variable_count(), NO_VARIABLE, m_state);
+        std::uint32_t variable_count = 0;
+
+        for(const IrBlock& block : m_function->get_blocks())
+        {
+            for(IrValue value = block.first; value < block.first + block.count; value++)
+            {
+                const IrOpcode opcode = m_function->get_opcode(value);
+                if(opcode != IrOpcode::LOAD_VARIABLE && opcode != IrOpcode::STORE_VARIABLE) continue;
+
+                IrOperands operands = m_function->get_operands(value);
+                if(new_variables[operands.data] == NO_VARIABLE)
+                {
+                    new_variables[operands.data] = variable_count++;
+                }
+                operands.data = new_variables[operands.data];
+                m_function->set_operands(value, operands);
+            }
+        }
+
+        m_function->set_variable_count(variable_count);
+    }
+
+    void IrOptimizer::reset_replacements()
+    {
+        m_replacements.resize(m_function->get_instruction_count());
+        std::iota(m_replacements.begin(), m_replacements.end(), IrValue(0));
+    }
+
+    void IrOptimizer::replace(IrValue value, IrValue replacement)
+    {
+        m_replacements[value] = replacement;
+    }
+
+    void IrOptimizer::update_operands(IrValue value)
+    {
+        const IrOpcode opcode = m_function->get_opcode(value);
+        IrOperands operands = m_function->get_operands(value);
+        if(ir_opcode_reads_lhs(opcode) && operands.lhs != NO_IR_VALUE) operands.lhs = m_replacements[operands.lhs];
+        if(ir_opcode_reads_rhs(opcode)) operands.rhs = m_replacements[operands.rhs];
+        m_function->set_operands(value, operands);
+    }
+
+    IrOptimizer::ValueKey IrOptimizer::get_value_key(IrValue value) const
+    {
+        const IrOpcode opcode = m_function->get_opcode(value);
+        const IrOperands& operands = m_function->get_operands(value);
+        ValueKey key = {
+            .opcode = opcode,
+            .type = m_function->get_type(value),
+            .lhs = operands.lhs,
+            .rhs = operands.rhs,
+            .data = operands.data,
+        };
+
+        switch(opcode)
+        {
+            // Constants are compared by value, the bits keep 0.0 and -0.0 apart.
+            case IrOpcode::INT_CONSTANT:
+                key.data = m_function->get_int_constant(value);
+                break;
+            case IrOpcode::FLOAT_CONSTANT:
+                key.data = std::bit_cast<UInt>(m_function->get_float_constant(value));
+                break;
+            // Float operations are not reordered, the NaN they return depends on the operand order.
+            case IrOpcode::INT_BINARY:
+            {
+                const auto operation = static_cast<IntBinaryOperation>(operands.data);
+                if(operation == IntBinaryOperation::ADD || operation == IntBinaryOperation::MULTIPLY)
+                {
+                    if(key.lhs > key.rhs) std::swap(key.lhs, key.rhs);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        return key;
+    }
+}
\ No newline at end of file
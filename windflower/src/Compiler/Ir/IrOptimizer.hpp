@@ -0,0 +1,64 @@
+#ifndef WF_IR_OPTIMIZER_HPP
+#define WF_IR_OPTIMIZER_HPP
+
+#include "Compiler/Ir/Ir.hpp"
+
+namespace wf
+{
+    // Runs the optimization passes over an IrFunction in place. Passes only remove instructions and redirect
+    // operands to equivalent values, so every remaining instruction computes what it did before.
+    class IrOptimizer
+    {
+    public:
+        IrOptimizer(State* state, IrFunction* function);
+
+        void optimize();
+    private:
+        // Identifies the computation of a pure instruction, so instructions computing the same thing can share
+        // one value.
+        struct ValueKey
+        {
+            IrOpcode opcode;
+            TypeId type;
+            IrValue lhs;
+            IrValue rhs;
+            // Operation of the instruction, or the bits of a constant.
+            UInt data;
+
+            bool operator==(const ValueKey&) const = default;
+        };
+
+        struct ValueKeyHash
+        {
+            std::size_t operator()(const ValueKey& key) const;
+        };
+
+        State* const m_state;
+        IrFunction* const m_function;
+        // Value each instruction has been replaced by, the instruction itself if it was kept.
+        DynamicArray<IrValue> m_replacements;
+
+        void remove_unreachable_blocks();
+        // Forwards the value last stored to a variable to the loads that follow.
+        void propagate_copies();
+        void eliminate_common_subexpressions();
+        // Removes stores that no load reads before the variable is stored to again or the block ends.
+        void eliminate_dead_stores();
+        // Removes instructions without side effects whose value is never used.
+        void eliminate_dead_code();
+        // Drops variables that are no longer loaded or stored and renumbers the rest densely.
+        void remove_unused_variables();
+
+        void reset_replacements();
+        void replace(IrValue value, IrValue replacement);
+        // Redirects the operands of `value` to the values they have been replaced by.
+        void update_operands(IrValue value);
+        ValueKey get_value_key(IrValue value) const;
+    };
+
+    // Lowers the program at `root` to IR, optimizes it and adds the result to `output`. Returns the root of the
+    // optimized program.
+    ActionIndex optimize_actions(State* state, const ActionTree& actions, ActionIndex root, ActionTree* output);
+}
+
+#endif
\ No newline at end of file
@@ -1,220 +1,148 @@
 #ifndef WF_NODES_HPP
 #define WF_NODES_HPP
 
-#include <string_view>
+#include <limits>
+#include <span>
 
 #include "Compiler/Token.hpp"
-#include "Utils/Allocate.hpp"
 #include "Utils/Array.hpp"
 #include "Vm/Object.hpp"
 
 namespace wf
 {
-    struct Node
-    {
-        using polymorphic_size_enable = std::true_type;
-        WF_POLYMORPHIC_SIZING
-
-        enum class Type
-        {
-            STATEMENT_BLOCK,
-            BUILTIN_TYPE,
-
-            VARIABLE_DECLARATION,
-            PARAMETER,
-            ARGUMENT,
-            EXTERN_FUNCTION_DECLARATION,
-
-            RETURN,
-
-            BINARY_OP,
-            UNARY_OP,
-            CONSTANT,
-
-            VARIABLE_ACCESS,
-            CALL,
-        };
-
-        Node(Type type)
-            : type(type)
-        {
-        }
+    using NodeIndex = std::uint32_t;
+    // Marks an absent optional child, such as the value of a bare return.
+    constexpr NodeIndex NO_NODE = std::numeric_limits<NodeIndex>::max();
 
-        virtual ~Node() = default;
-
-        const Type type;
-        SourcePosition position;
-    };
+    // Index into the name table of an Ast.
+    using NameIndex = std::uint32_t;
+    constexpr NameIndex NO_NAME = std::numeric_limits<NameIndex>::max();
 
-    struct StatementBlockNode : Node
+    enum class NodeType : std::uint8_t
     {
-        WF_POLYMORPHIC_SIZING
+        STATEMENT_BLOCK,
+        BUILTIN_TYPE,
 
-        StatementBlockNode(State* state)
-            : Node(Type::STATEMENT_BLOCK), statements(state)
-        {
-        }
+        VARIABLE_DECLARATION,
+        PARAMETER,
+        ARGUMENT,
+        EXTERN_FUNCTION_DECLARATION,
 
-        DynamicArray<Node*> statements;
-    };
+        RETURN,
 
-    struct BuiltinTypeNode : Node
-    {
-        WF_POLYMORPHIC_SIZING
+        BINARY_OP,
+        UNARY_OP,
+        INT_CONSTANT,
+        FLOAT_CONSTANT,
 
-        BuiltinTypeNode()
-            : Node(Type::STATEMENT_BLOCK)
-        {
-        }
-
-        TypeId type_id;
+        VARIABLE_ACCESS,
+        CALL,
     };
 
-    struct VariableDeclarationNode : Node
+    enum class BinaryOperator : std::uint8_t
     {
-        WF_POLYMORPHIC_SIZING
-
-        VariableDeclarationNode()
-            : Node(Type::VARIABLE_DECLARATION)
-        {
-        }
-
-        StringObject* name;
-        Node* initializer;
-        BuiltinTypeNode* storage_type;
+        ADD, SUBTRACT, MULTIPLY, DIVIDE, MODULO
     };
 
-    struct ParameterNode : Node
+    enum class UnaryOperator : std::uint8_t
     {
-        WF_POLYMORPHIC_SIZING
-
-        ParameterNode()
-            : Node(Type::PARAMETER)
-        {
-        }
-
-        StringObject* argument_label;
-        StringObject* name;
-        BuiltinTypeNode* storage_type;
+        PLUS, NEGATE
     };
 
-    struct ArgumentNode : Node
+    // Operands of a node. Their meaning depends on the node type:
+    //
+    //  STATEMENT_BLOCK              lhs: first statement in extra, rhs: statement count
+    //  BUILTIN_TYPE                 data: TypeId
+    //  VARIABLE_DECLARATION         lhs: initializer or NO_NODE, rhs: storage type or NO_NODE, data: name
+    //  PARAMETER                    lhs: storage type or NO_NODE, rhs: argument label, data: name
+    //  ARGUMENT                     lhs: value, data: label or NO_NAME
+    //  EXTERN_FUNCTION_DECLARATION  lhs: return type in extra followed by the parameters, rhs: parameter count,
+    //                               data: name
+    //  RETURN                       lhs: value or NO_NODE
+    //  BINARY_OP                    lhs: left operand, rhs: right operand, data: BinaryOperator
+    //  UNARY_OP                     lhs: operand, data: UnaryOperator
+    //  INT_CONSTANT                 data: index into the int constants
+    //  FLOAT_CONSTANT               data: index into the float constants
+    //  VARIABLE_ACCESS              data: name
+    //  CALL                         lhs: callee in extra followed by the arguments, rhs: argument count
+    struct NodeOperands
     {
-        WF_POLYMORPHIC_SIZING
-
-        ArgumentNode()
-            : Node(Type::ARGUMENT)
-        {
-        }
-
-        StringObject* label;
-        Node* value;
+        NodeIndex lhs = NO_NODE;
+        NodeIndex rhs = NO_NODE;
+        std::uint32_t data = 0;
     };
 
-    struct ExternFunctionDeclarationNode : Node
+    // Syntax tree of one compilation, stored flat in parallel arrays. Children always precede their parent.
+    class Ast
     {
-        WF_POLYMORPHIC_SIZING
-
-        ExternFunctionDeclarationNode(State* state)
-            : Node(Type::EXTERN_FUNCTION_DECLARATION), parameters(state)
+    public:
+        explicit Ast(State* state)
+            : m_types(state), m_offsets(state), m_operands(state), m_extra(state),
+                m_names(state), m_int_constants(state), m_float_constants(state)
         {
         }
 
-        StringObject* name;
-        DynamicArray<ParameterNode*> parameters;
-        BuiltinTypeNode* return_type;
-    };
-
-    struct ReturnNode : Node
-    {
-        WF_POLYMORPHIC_SIZING
-
-        ReturnNode()
-            : Node(Type::RETURN)
+        NodeIndex add_node(NodeType type, SourceOffset offset, const NodeOperands& operands)
         {
+            const NodeIndex index = static_cast<NodeIndex>(m_types.size());
+            m_types.push_back(type);
+            m_offsets.push_back(offset);
+            m_operands.push_back(operands);
+            return index;
         }
 
-        Node* return_value;
-    };
-
-    struct BinaryOpNode : Node
-    {
-        WF_POLYMORPHIC_SIZING
-
-        BinaryOpNode()
-            : Node(Type::BINARY_OP)
+        // Appends a list of children to the extra array and returns the index of its first element.
+        std::uint32_t add_extra(std::span<const NodeIndex> nodes)
         {
+            const std::uint32_t index = static_cast<std::uint32_t>(m_extra.size());
+            m_extra.insert(m_extra.end(), nodes.begin(), nodes.end());
+            return index;
         }
 
-        enum class Operation
-        {
-            ADD, SUBTRACT, MULTIPLY, DIVIDE, MODULO
-        };
-
-        Node* left_operand;
-        Node* right_operand;
-        Operation operation;
-    };
-
-    struct UnaryOpNode : Node
-    {
-        WF_POLYMORPHIC_SIZING
-
-        UnaryOpNode()
-            : Node(Type::UNARY_OP)
+        NameIndex add_name(StringObject* name)
         {
+            m_names.push_back(name);
+            return static_cast<NameIndex>(m_names.size() - 1);
         }
 
-        enum class Operation
-        {
-            PLUS, NEGATE
-        };
-
-        Node* operand;
-        Operation operation;
-    };
-
-    struct ConstantNode : Node
-    {
-        WF_POLYMORPHIC_SIZING
-
-        ConstantNode()
-            : Node(Type::CONSTANT)
+        NodeIndex add_int_constant(SourceOffset offset, UInt value)
         {
+            m_int_constants.push_back(value);
+            return add_node(NodeType::INT_CONSTANT, offset,
+                    { .data = static_cast<std::uint32_t>(m_int_constants.size() - 1) });
         }
 
-        enum class ValueType
-        {
-            INT, FLOAT
-        };
-
-        ValueType value_type;
-        std::string_view value;
-    };
-
-    struct VariableAccessNode : Node
-    {
-        WF_POLYMORPHIC_SIZING
-
-        VariableAccessNode()
-            : Node(Type::VARIABLE_ACCESS)
+        NodeIndex add_float_constant(SourceOffset offset, Float value)
         {
+            m_float_constants.push_back(value);
+            return add_node(NodeType::FLOAT_CONSTANT, offset,
+                    { .data = static_cast<std::uint32_t>(m_float_constants.size() - 1) });
         }
 
-        StringObject* name;
-    };
+        std::size_t get_node_count() const { return m_types.size(); }
 
-    struct CallNode : Node
-    {
-        WF_POLYMORPHIC_SIZING
+        NodeType get_type(NodeIndex node) const { return m_types[node]; }
+        const NodeOperands& get_operands(NodeIndex node) const { return m_operands[node]; }
+
+        SourceOffset get_offset(NodeIndex node) const { return m_offsets[node]; }
 
-        CallNode(State* state)
-            : Node(Type::CALL), arguments(state)
+        std::span<const NodeIndex> get_extra(std::uint32_t index, std::uint32_t count) const
         {
+            return { m_extra.data() + index, count };
         }
 
-        Node* callee;
-        DynamicArray<ArgumentNode*> arguments;
+        StringObject* get_name(NameIndex name) const { return m_names[name]; }
+        UInt get_int_constant(NodeIndex node) const { return m_int_constants[m_operands[node].data]; }
+        Float get_float_constant(NodeIndex node) const { return m_float_constants[m_operands[node].data]; }
+    private:
+        DynamicArray<NodeType> m_types;
+        DynamicArray<SourceOffset> m_offsets;
+        DynamicArray<NodeOperands> m_operands;
+        DynamicArray<NodeIndex> m_extra;
+
+        DynamicArray<StringObject*> m_names;
+        DynamicArray<UInt> m_int_constants;
+        DynamicArray<Float> m_float_constants;
     };
 }
 
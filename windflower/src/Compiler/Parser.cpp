@@ -4,44 +4,45 @@
 
 namespace wf
 {
-    Parser::Parser(State* state, const CompileInfo& compile_info)
-        : m_state(state), m_tokenizer(compile_info.name, compile_info.source), m_error_manager(state),
-            m_newline_ignore_stack(state), m_allocated_nodes(state)
+    Parser::Parser(State* state, const Source& source, Ast* output)
+        : m_state(state), m_source(source), m_ast(output), m_tokenizer(source.get_text()),
+            m_error_manager(state, source), m_newline_ignore_stack(state), m_list_stack(state),
+            m_expr_stack(state)
     {
         advance();
     }
 
-    Node* Parser::parse()
+    NodeIndex Parser::parse()
     {
         push_newline_ignore(false);
 
-        StatementBlockNode* ast = parse_statement_block();
+        NodeIndex ast = parse_statement_block();
 
         pop_newline_ignore();
 
         if(!m_error_manager.has_errors() && m_current.get_type() != Token::Type::TT_EOF)
         {
-            push_error(m_current.get_position(), "Expected a newline.");
+            push_error(m_current.get_offset(), "Expected a newline.");
         }
 
-        if(m_error_manager.has_errors()) return nullptr;
+        if(m_error_manager.has_errors()) return NO_NODE;
 
         return ast;
     }
 
-    void Parser::push_expected_expr_error(const SourcePosition& position)
+    void Parser::push_expected_expr_error(SourceOffset offset)
     {
-        push_error(position, "Expected an expression.");
+        push_error(offset, "Expected an expression.");
     }
 
-    void Parser::push_expected_identifier_error(const SourcePosition& position)
+    void Parser::push_expected_identifier_error(SourceOffset offset)
     {
-        push_error(position, "Expected an identifier.");
+        push_error(offset, "Expected an identifier.");
     }
 
-    void Parser::push_expected_storage_type_error(const SourcePosition& position)
+    void Parser::push_expected_storage_type_error(SourceOffset offset)
     {
-        push_error(position, "Expected a storage type.");
+        push_error(offset, "Expected a storage type.");
     }
 
     void Parser::advance()
@@ -50,7 +51,7 @@ namespace wf
 
         while(m_current.get_type() == Token::Type::ERROR)
         {
-            push_error(m_current.get_position(), "{}", m_current.get_text());
+            push_error(m_current.get_offset(), "{}", m_current.get_error_message());
             m_current = m_tokenizer.next();
         }
     }
@@ -67,36 +68,58 @@ namespace wf
         m_tokenizer.set_newline_ignore(m_newline_ignore_stack.empty()? false : m_newline_ignore_stack.top());
     }
 
-    BuiltinTypeNode* Parser::parse_builtin_type()
+    NodeIndex Parser::add_node(NodeType type, SourceOffset offset, const NodeOperands& operands)
     {
-        BuiltinTypeNode* node = allocate_node<BuiltinTypeNode>();
-        node->position = m_current.get_position();
+        return m_ast->add_node(type, offset, operands);
+    }
+
+    std::string_view Parser::get_text(const Token& token) const
+    {
+        return m_source.get_text(token.get_offset(), token.get_length());
+    }
+
+    NameIndex Parser::add_name(std::string_view text)
+    {
+        return m_ast->add_name(StringObject::from_text(m_state, text));
+    }
+
+    std::uint32_t Parser::pop_list(std::size_t list_begin)
+    {
+        const std::uint32_t index = m_ast->add_extra(std::span(m_list_stack).subspan(list_begin));
+        m_list_stack.resize(list_begin);
+        return index;
+    }
+
+    NodeIndex Parser::parse_builtin_type()
+    {
+        const SourceOffset offset = m_current.get_offset();
+        TypeId type_id;
         switch(m_current.get_type())
         {
             case Token::Type::KW_INT:
-                node->type_id = TypeId::INT;
+                type_id = TypeId::INT;
                 break;
             case Token::Type::KW_FLOAT:
-                node->type_id = TypeId::FLOAT;
+                type_id = TypeId::FLOAT;
                 break;
             default:
-                return nullptr;
+                return NO_NODE;
         }
         advance();
-        return node;
+        return add_node(NodeType::BUILTIN_TYPE, offset, { .data = static_cast<std::uint32_t>(type_id) });
     }
 
-    StatementBlockNode* Parser::parse_statement_block()
+    NodeIndex Parser::parse_statement_block()
     {
         while(m_current.get_type() == Token::Type::NEWLINE) advance();
 
-        StatementBlockNode* node = allocate_node<StatementBlockNode>(m_state);
-        node->position = m_current.get_position();
+        const SourceOffset offset = m_current.get_offset();
+        const std::size_t list_begin = m_list_stack.size();
 
         while(m_current.get_type() != Token::Type::TT_EOF)
         {
-            Node* statement = parse_statement();
-            if(statement == nullptr)
+            NodeIndex statement = parse_statement();
+            if(statement == NO_NODE)
             {
                 while(m_current.get_type() != Token::Type::NEWLINE && m_current.get_type() != Token::Type::TT_EOF)
                 {
@@ -105,7 +128,7 @@ namespace wf
             }
             else
             {
-                node->statements.emplace_back(statement);
+                m_list_stack.push_back(statement);
             }
 
             std::uint32_t newline_count = 0;
@@ -117,10 +140,12 @@ namespace wf
 
             if(newline_count == 0) break;
         }
-        return node;
+
+        const std::uint32_t statement_count = static_cast<std::uint32_t>(m_list_stack.size() - list_begin);
+        return add_node(NodeType::STATEMENT_BLOCK, offset, { pop_list(list_begin), statement_count });
     }
 
-    Node* Parser::parse_statement()
+    NodeIndex Parser::parse_statement()
     {
         switch(m_current.get_type())
         {
@@ -130,401 +155,449 @@ namespace wf
                 break;
         }
 
-        SourcePosition expr_position = m_current.get_position();
-        Node* expr = parse_expression();
-        if(expr == nullptr)
+        SourceOffset expr_offset = m_current.get_offset();
+        NodeIndex expr = parse_expression();
+        if(expr == NO_NODE)
         {
-           push_expected_expr_error(expr_position);
+           push_expected_expr_error(expr_offset);
         }
         return expr;
     }
 
-    VariableDeclarationNode* Parser::parse_variable_declaration()
+    NodeIndex Parser::parse_variable_declaration()
     {
-        VariableDeclarationNode* node = allocate_node<VariableDeclarationNode>();
-        node->position = m_current.get_position();
+        const SourceOffset offset = m_current.get_offset();
         advance();
 
         if(m_current.get_type() != Token::Type::IDENTIFIER)
         {
-            push_expected_identifier_error(m_current.get_position());
-            return nullptr;
+            push_expected_identifier_error(m_current.get_offset());
+            return NO_NODE;
         }
-        node->name = StringObject::from_text(m_state, m_current.get_text());
+        const NameIndex name = add_name(get_text(m_current));
         advance();
 
+        NodeIndex storage_type = NO_NODE;
         if(m_current.get_type() != Token::Type::COLON_EQUALS)
         {
             if(m_current.get_type() != Token::Type::COLON)
             {
-                push_error(m_current.get_position(), "A variable declaration must contain an explicit type annotation or an initial value.");
-                return nullptr;
+                push_error(m_current.get_offset(), "A variable declaration must contain an explicit type annotation or an initial value.");
+                return NO_NODE;
             }
             advance();
 
-            SourcePosition storage_type_position = m_current.get_position();
-            node->storage_type = parse_builtin_type();
-            if(node->storage_type == nullptr)
+            SourceOffset storage_type_offset = m_current.get_offset();
+            storage_type = parse_builtin_type();
+            if(storage_type == NO_NODE)
             {
-                push_expected_storage_type_error(storage_type_position);
+                push_expected_storage_type_error(storage_type_offset);
             }
 
             if(m_current.get_type() != Token::Type::COLON_EQUALS)
             {
-                return node;
+                return add_node(NodeType::VARIABLE_DECLARATION, offset, { NO_NODE, storage_type, name });
             }
         }
 
         advance();
 
-        SourcePosition expr_position = m_current.get_position();
-        node->initializer = parse_expression();
-        if(node->initializer == nullptr)
+        SourceOffset expr_offset = m_current.get_offset();
+        const NodeIndex initializer = parse_expression();
+        if(initializer == NO_NODE)
         {
-            push_expected_expr_error(expr_position);
-            return nullptr;
+            push_expected_expr_error(expr_offset);
+            return NO_NODE;
         }
-        return node;
+        return add_node(NodeType::VARIABLE_DECLARATION, offset, { initializer, storage_type, name });
     }
 
-    ParameterNode* Parser::parse_parameter()
+    NodeIndex Parser::parse_parameter()
     {
-        ParameterNode* node = allocate_node<ParameterNode>();
-        node->position = m_current.get_position();
+        const SourceOffset offset = m_current.get_offset();
+        NameIndex argument_label;
+        NameIndex name;
 
         if(m_current.is_keyword())
         {
-            node->argument_label = StringObject::from_text(m_state, m_current.get_text());
+            argument_label = add_name(get_text(m_current));
             advance();
             if(m_current.get_type() == Token::Type::COLON)
             {
-                push_error(node->position, "An keyword can only be used as an argument label if the parameter name is specified seperately.");
-                return nullptr;
+                push_error(offset, "An keyword can only be used as an argument label if the parameter name is specified seperately.");
+                return NO_NODE;
             }
             else if(m_current.get_type() != Token::Type::IDENTIFIER)
             {
-                push_expected_identifier_error(m_current.get_position());
-                return nullptr;
+                push_expected_identifier_error(m_current.get_offset());
+                return NO_NODE;
             }
 
-            node->name = StringObject::from_text(m_state, m_current.get_text());
+            name = add_name(get_text(m_current));
             advance();
         }
         else
         {
             if(m_current.get_type() != Token::Type::IDENTIFIER)
             {
-                push_expected_identifier_error(m_current.get_position());
-                return nullptr;
+                push_expected_identifier_error(m_current.get_offset());
+                return NO_NODE;
             }
-            node->argument_label = StringObject::from_text(m_state, m_current.get_text());
-            node->name = node->argument_label;
+            argument_label = add_name(get_text(m_current));
+            name = argument_label;
             advance();
 
             if(m_current.get_type() == Token::Type::IDENTIFIER)
             {
-                node->name = StringObject::from_text(m_state, m_current.get_text());
+                name = add_name(get_text(m_current));
                 advance();
             }
         }
 
         if(m_current.get_type() != Token::Type::COLON)
         {
-            push_error(m_current.get_position(), "Expected a ':'.");
+            push_error(m_current.get_offset(), "Expected a ':'.");
         }
         advance();
 
-        SourcePosition storage_type_position = m_current.get_position();
-        node->storage_type = parse_builtin_type();
-        if(node->storage_type == nullptr)
+        SourceOffset storage_type_offset = m_current.get_offset();
+        const NodeIndex storage_type = parse_builtin_type();
+        if(storage_type == NO_NODE)
         {
-            push_expected_storage_type_error(storage_type_position);
+            push_expected_storage_type_error(storage_type_offset);
         }
 
-        return node;
+        return add_node(NodeType::PARAMETER, offset, { storage_type, argument_label, name });
     }
 
-    ArgumentNode* Parser::parse_argument()
+    NodeIndex Parser::parse_extern_function_declaration()
     {
-        ArgumentNode* node = allocate_node<ArgumentNode>();
-        node->position = m_current.get_position();
-        node->label = nullptr;
-
-        if(m_current.is_keyword())
-        {
-            node->label = StringObject::from_text(m_state, m_current.get_text());
-            advance();
-            if(m_current.get_type() != Token::Type::COLON)
-            {
-                push_error(m_current.get_position(), "Expected a ':'.");
-                return nullptr;
-            }
-            advance();
-        }
-
-        SourcePosition expr_position = m_current.get_position();
-        node->value = parse_expression();
-        if(node->value == nullptr)
-        {
-            push_expected_expr_error(expr_position);
-            return nullptr;
-        }
-        if(node->label != nullptr && m_current.get_type() == Token::Type::COLON
-            && node->value->type == Node::Type::VARIABLE_ACCESS)
-        {
-            node->label = static_cast<VariableAccessNode*>(node->value)->name;
-            advance();
-
-            expr_position = m_current.get_position();
-            node->value = parse_expression();
-            if(node->value == nullptr)
-            {
-                push_expected_expr_error(expr_position);
-                return nullptr;
-            }
-        }
-        return node;
-    }
-
-    ExternFunctionDeclarationNode* Parser::parse_extern_function_declaration()
-    {
-        ExternFunctionDeclarationNode* node = allocate_node<ExternFunctionDeclarationNode>(m_state);
-        node->position = m_current.get_position();
+        const SourceOffset offset = m_current.get_offset();
         advance();
 
         if(m_current.get_type() != Token::Type::IDENTIFIER)
         {
-            push_expected_identifier_error(m_current.get_position());
-            return nullptr;
+            push_expected_identifier_error(m_current.get_offset());
+            return NO_NODE;
         }
-        node->name = StringObject::from_text(m_state, m_current.get_text());
+        const NameIndex name = add_name(get_text(m_current));
         advance();
 
         if(m_current.get_type() != Token::Type::LEFT_PAREN)
         {
-            push_error(m_current.get_position(), "Expected a '('.");
-            return nullptr;
+            push_error(m_current.get_offset(), "Expected a '('.");
+            return NO_NODE;
         }
-        SourcePosition paren_position = m_current.get_position();
+        SourceOffset paren_offset = m_current.get_offset();
         advance();
 
+        // The return type heads the list, so it is pushed once it has been parsed.
+        const std::size_t list_begin = m_list_stack.size();
+        m_list_stack.push_back(NO_NODE);
+
         if(m_current.get_type() != Token::Type::RIGHT_PAREN)
         {
-            ParameterNode* parameter = parse_parameter();
-            if(parameter == nullptr) return nullptr;
-            node->parameters.emplace_back(parameter);
+            NodeIndex parameter = parse_parameter();
+            if(parameter == NO_NODE)
+            {
+                m_list_stack.resize(list_begin);
+                return NO_NODE;
+            }
+            m_list_stack.push_back(parameter);
 
             while(m_current.get_type() == Token::Type::COMMA)
             {
                 advance();
-                ParameterNode* parameter = parse_parameter();
-                if(parameter == nullptr) return nullptr;
-                node->parameters.emplace_back(parameter);
+                parameter = parse_parameter();
+                if(parameter == NO_NODE)
+                {
+                    m_list_stack.resize(list_begin);
+                    return NO_NODE;
+                }
+                m_list_stack.push_back(parameter);
             }
 
             if(m_current.get_type() != Token::Type::RIGHT_PAREN)
             {
-                push_error(m_current.get_position(), "Expected a ')' to match the '( at {}", paren_position);
+                push_error(m_current.get_offset(), "Expected a ')' to match the '( at {}",
+                        m_source.get_position(paren_offset));
             }
         }
         advance();
 
         if(m_current.get_type() != Token::Type::ARROW)
         {
-            push_error(m_current.get_position(), "Expected an '->'.");
-            return nullptr;
+            push_error(m_current.get_offset(), "Expected an '->'.");
+            m_list_stack.resize(list_begin);
+            return NO_NODE;
         }
         advance();
 
-        SourcePosition storage_type_position = m_current.get_position();
-        node->return_type = parse_builtin_type();
-        if(node->return_type == nullptr)
+        SourceOffset storage_type_offset = m_current.get_offset();
+        m_list_stack[list_begin] = parse_builtin_type();
+        if(m_list_stack[list_begin] == NO_NODE)
         {
-            push_expected_storage_type_error(storage_type_position);
+            push_expected_storage_type_error(storage_type_offset);
         }
 
-        return node;
+        const std::uint32_t parameter_count = static_cast<std::uint32_t>(m_list_stack.size() - list_begin - 1);
+        return add_node(NodeType::EXTERN_FUNCTION_DECLARATION, offset, { pop_list(list_begin), parameter_count, name });
     }
 
-    ReturnNode* Parser::parse_return()
+    NodeIndex Parser::parse_return()
     {
-        ReturnNode* node = allocate_node<ReturnNode>();
-        node->position = m_current.get_position();
+        const SourceOffset offset = m_current.get_offset();
         advance();
 
         if(m_current.get_type() == Token::Type::NEWLINE)
         {
-            node->return_value = nullptr;
-            return node;
+            return add_node(NodeType::RETURN, offset);
         }
 
-        SourcePosition expr_position = m_current.get_position();
-        node->return_value = parse_expression();
-        if(node->return_value == nullptr)
+        SourceOffset expr_offset = m_current.get_offset();
+        const NodeIndex return_value = parse_expression();
+        if(return_value == NO_NODE)
         {
-            push_expected_expr_error(expr_position);
-            return nullptr;
+            push_expected_expr_error(expr_offset);
+            return NO_NODE;
         }
-        return node;
+        return add_node(NodeType::RETURN, offset, { .lhs = return_value });
     }
 
-    Node* Parser::parse_expression(ExprPrecedence precedence)
+    NodeIndex Parser::parse_expression(ExprPrecedence precedence)
     {
-        ExprPrefixFunc prefix = get_rule(m_current.get_type()).prefix;
-        if(prefix == nullptr)
-        {
-            return nullptr;
-        }
+        const std::size_t stack_begin = m_expr_stack.size();
+        push_expression(precedence);
 
-        Node* prev = (this->*prefix)();
-        if(prev == nullptr)
+        // Each step receives the node produced by the last step that did not push new steps.
+        NodeIndex result = NO_NODE;
+        while(m_expr_stack.size() > stack_begin)
         {
-            return nullptr;
-        }
+            const ExprFrame frame = m_expr_stack.back();
+            m_expr_stack.pop_back();
 
-        if(get_rule(m_current.get_type()).infix == nullptr)
-        {
-            return prev;
-        }
-
-        while(precedence <= get_rule(m_current.get_type()).precedence)
-        {
-            ExprInfixFunc infix_func = get_rule(m_current.get_type()).infix;
-            prev = (this->*infix_func)(prev);
-
-            if(prev == nullptr)
+            switch(frame.step)
             {
-                return nullptr;
+                case ExprStep::EXPRESSION:
+                    result = parse_prefix(frame.precedence);
+                    break;
+                case ExprStep::INFIX:
+                    result = parse_infix(frame.precedence, result);
+                    break;
+                case ExprStep::UNARY_OPERAND:
+                    result = finish_unary_op(frame, result);
+                    break;
+                case ExprStep::BINARY_RIGHT_OPERAND:
+                    result = finish_binary_op(frame, result);
+                    break;
+                case ExprStep::GROUPING_END:
+                    result = finish_grouping(frame, result);
+                    break;
+                case ExprStep::CALL_ARGUMENT:
+                    result = continue_call(frame, result);
+                    break;
+                case ExprStep::ARGUMENT_VALUE:
+                case ExprStep::ARGUMENT_LABELED_VALUE:
+                    result = finish_argument(frame, result);
+                    break;
             }
         }
 
-        return prev;
+        return result;
     }
 
-    Node* Parser::parse_binary_op(Node* prev)
+    void Parser::push_expression(ExprPrecedence precedence)
     {
-        Token op_token = m_current;
-        advance();
+        m_expr_stack.push_back({ .step = ExprStep::EXPRESSION, .precedence = precedence });
+    }
+
+    NodeIndex Parser::parse_prefix(ExprPrecedence precedence)
+    {
+        const ExprPrefix prefix = get_rule(m_current.get_type()).prefix;
+        if(prefix == ExprPrefix::NONE)
+        {
+            return NO_NODE;
+        }
 
-        BinaryOpNode* node = allocate_node<BinaryOpNode>();
-        node->position = op_token.get_position();
-        node->left_operand = prev;
+        m_expr_stack.push_back({ .step = ExprStep::INFIX, .precedence = precedence });
+        switch(prefix)
+        {
+            case ExprPrefix::CONSTANT: return parse_constant();
+            case ExprPrefix::VARIABLE_ACCESS: return parse_variable_access();
+            case ExprPrefix::UNARY_OP: return begin_unary_op();
+            case ExprPrefix::GROUPING: return begin_grouping();
+            case ExprPrefix::NONE: break;
+        }
+        return NO_NODE;
+    }
 
-        ExprPrecedence precedence = static_cast<ExprPrecedence>(
-            to_underlying(get_rule(op_token.get_type()).precedence) + 1
-        );
+    NodeIndex Parser::parse_infix(ExprPrecedence precedence, NodeIndex prev)
+    {
+        if(prev == NO_NODE)
+        {
+            return NO_NODE;
+        }
 
-        SourcePosition right_operand_position = m_current.get_position();
-        node->right_operand = parse_expression(precedence);
+        const ExprRule& rule = get_rule(m_current.get_type());
+        if(rule.infix == ExprInfix::NONE || precedence > rule.precedence)
+        {
+            return prev;
+        }
 
-        if(node->right_operand == nullptr)
+        m_expr_stack.push_back({ .step = ExprStep::INFIX, .precedence = precedence });
+        switch(rule.infix)
         {
-            push_expected_expr_error(right_operand_position);
-            return nullptr;
+            case ExprInfix::BINARY_OP: return begin_binary_op(prev);
+            case ExprInfix::CALL: return begin_call(prev);
+            case ExprInfix::NONE: break;
         }
+        return NO_NODE;
+    }
 
-        switch(op_token.get_type())
+    NodeIndex Parser::parse_constant()
+    {
+        NodeIndex node;
+        switch(m_current.get_type())
         {
-            case Token::Type::PLUS:
-                node->operation = BinaryOpNode::Operation::ADD;
-                break;
-            case Token::Type::MINUS:
-                node->operation = BinaryOpNode::Operation::SUBTRACT;
-                break;
-            case Token::Type::STAR:
-                node->operation = BinaryOpNode::Operation::MULTIPLY;
-                break;
-            case Token::Type::SLASH:
-                node->operation = BinaryOpNode::Operation::DIVIDE;
+            case Token::Type::INT_CONSTANT:
+                node = m_ast->add_int_constant(m_current.get_offset(), m_current.get_int_value());
                 break;
-            case Token::Type::PERCENT:
-                node->operation = BinaryOpNode::Operation::MODULO;
+            case Token::Type::FLOAT_CONSTANT:
+                node = m_ast->add_float_constant(m_current.get_offset(), m_current.get_float_value());
                 break;
             default:
-                push_error(m_current.get_position(), "Parser::parse_binary_op() reached an unexpected point.");
-                return nullptr;
+                push_error(m_current.get_offset(), "Parser::parse_constant() reached an unexpected point.");
+                return NO_NODE;
         }
+
+        advance();
+
         return node;
     }
 
-    Node* Parser::parse_unary_op()
+    NodeIndex Parser::parse_variable_access()
+    {
+        const SourceOffset offset = m_current.get_offset();
+        const NameIndex name = add_name(get_text(m_current));
+        advance();
+        return add_node(NodeType::VARIABLE_ACCESS, offset, { .data = name });
+    }
+
+    NodeIndex Parser::begin_unary_op()
     {
-        UnaryOpNode* node = allocate_node<UnaryOpNode>();
-        node->position = m_current.get_position();
+        const SourceOffset offset = m_current.get_offset();
+        UnaryOperator operation;
         switch(m_current.get_type())
         {
             case Token::Type::PLUS:
-                node->operation = UnaryOpNode::Operation::PLUS;
+                operation = UnaryOperator::PLUS;
                 break;
             case Token::Type::MINUS:
-                node->operation = UnaryOpNode::Operation::NEGATE;
+                operation = UnaryOperator::NEGATE;
                 break;
             default:
-                push_error(m_current.get_position(), "Parser::parse_unary_op() reached an unexpected point.");
-                return nullptr;
+                push_error(m_current.get_offset(), "Parser::begin_unary_op() reached an unexpected point.");
+                return NO_NODE;
         }
         advance();
 
-        SourcePosition operand_position = m_current.get_position();
-        node->operand = parse_expression(ExprPrecedence::SIGN);
-        if(node->operand == nullptr)
+        m_expr_stack.push_back({
+            .step = ExprStep::UNARY_OPERAND,
+            .offset = offset,
+            .operand_offset = m_current.get_offset(),
+            .data = static_cast<std::uint32_t>(operation)
+        });
+        push_expression(ExprPrecedence::SIGN);
+        return NO_NODE;
+    }
+
+    NodeIndex Parser::finish_unary_op(const ExprFrame& frame, NodeIndex operand)
+    {
+        if(operand == NO_NODE)
         {
-            push_expected_expr_error(operand_position);
-            return nullptr;
+            push_expected_expr_error(frame.operand_offset);
+            return NO_NODE;
         }
 
-        return node;
+        return add_node(NodeType::UNARY_OP, frame.offset, { .lhs = operand, .data = frame.data });
     }
 
-    Node* Parser::parse_constant()
+    NodeIndex Parser::begin_binary_op(NodeIndex prev)
     {
-        ConstantNode* node = allocate_node<ConstantNode>();
-        node->position = m_current.get_position();
-        node->value = m_current.get_text();
-        switch(m_current.get_type())
+        const Token op_token = m_current;
+        advance();
+
+        BinaryOperator operation;
+        switch(op_token.get_type())
         {
-            case Token::Type::INT_CONSTANT:
-                node->value_type = ConstantNode::ValueType::INT;
+            case Token::Type::PLUS:
+                operation = BinaryOperator::ADD;
                 break;
-            case Token::Type::FLOAT_CONSTANT:
-                node->value_type = ConstantNode::ValueType::FLOAT;
+            case Token::Type::MINUS:
+                operation = BinaryOperator::SUBTRACT;
+                break;
+            case Token::Type::STAR:
+                operation = BinaryOperator::MULTIPLY;
+                break;
+            case Token::Type::SLASH:
+                operation = BinaryOperator::DIVIDE;
+                break;
+            case Token::Type::PERCENT:
+                operation = BinaryOperator::MODULO;
                 break;
             default:
-                push_error(m_current.get_position(), "Parser::parse_constant() reached an unexpected point.");
-                return nullptr;
+                push_error(m_current.get_offset(), "Parser::begin_binary_op() reached an unexpected point.");
+                return NO_NODE;
         }
 
-        advance();
-
-        return node;
+        m_expr_stack.push_back({
+            .step = ExprStep::BINARY_RIGHT_OPERAND,
+            .offset = op_token.get_offset(),
+            .operand_offset = m_current.get_offset(),
+            .node = prev,
+            .data = static_cast<std::uint32_t>(operation)
+        });
+        push_expression(static_cast<ExprPrecedence>(to_underlying(get_rule(op_token.get_type()).precedence) + 1));
+        return NO_NODE;
     }
 
-    Node* Parser::parse_variable_access()
+    NodeIndex Parser::finish_binary_op(const ExprFrame& frame, NodeIndex right_operand)
     {
-        VariableAccessNode* node = allocate_node<VariableAccessNode>();
-        node->position = m_current.get_position();
-        node->name = StringObject::from_text(m_state, m_current.get_text());
-        advance();
-        return node;
+        if(right_operand == NO_NODE)
+        {
+            push_expected_expr_error(frame.operand_offset);
+            return NO_NODE;
+        }
+
+        return add_node(NodeType::BINARY_OP, frame.offset, { frame.node, right_operand, frame.data });
     }
 
-    Node* Parser::parse_grouping()
+    NodeIndex Parser::begin_grouping()
     {
-        SourcePosition paren_position = m_current.get_position();
+        const SourceOffset paren_offset = m_current.get_offset();
         advance();
-        SourcePosition expr_position = m_current.get_position();
 
-        Node* expr = parse_expression();
+        m_expr_stack.push_back({
+            .step = ExprStep::GROUPING_END,
+            .offset = paren_offset,
+            .operand_offset = m_current.get_offset()
+        });
+        push_expression(ExprPrecedence::ADDITIVE);
+        return NO_NODE;
+    }
 
-        if(expr == nullptr)
+    NodeIndex Parser::finish_grouping(const ExprFrame& frame, NodeIndex expr)
+    {
+        if(expr == NO_NODE)
         {
-            push_expected_expr_error(expr_position);
-            return nullptr;
+            push_expected_expr_error(frame.operand_offset);
+            return NO_NODE;
         }
 
         if(m_current.get_type() != Token::Type::RIGHT_PAREN)
         {
-            push_error(m_current.get_position(), "Expected a ')' to match the '( at {}", paren_position);
+            push_error(m_current.get_offset(), "Expected a ')' to match the '( at {}",
+                    m_source.get_position(frame.offset));
         }
 
         advance();
@@ -532,56 +605,134 @@ namespace wf
         return expr;
     }
 
-    Node* Parser::parse_call(Node* prev)
+    NodeIndex Parser::begin_call(NodeIndex prev)
     {
-        CallNode* node = allocate_node<CallNode>(m_state);
-        node->position = m_current.get_position();
+        const SourceOffset offset = m_current.get_offset();
         advance();
 
+        const std::size_t list_begin = m_list_stack.size();
+        m_list_stack.push_back(prev);
+
+        if(m_current.get_type() == Token::Type::RIGHT_PAREN)
+        {
+            return end_call(offset, list_begin);
+        }
+
+        m_expr_stack.push_back({
+            .step = ExprStep::CALL_ARGUMENT,
+            .offset = offset,
+            .data = static_cast<std::uint32_t>(list_begin)
+        });
+        return begin_argument();
+    }
+
+    NodeIndex Parser::continue_call(const ExprFrame& frame, NodeIndex argument)
+    {
+        const std::size_t list_begin = frame.data;
+        if(argument == NO_NODE)
+        {
+            m_list_stack.resize(list_begin);
+            return NO_NODE;
+        }
+        m_list_stack.push_back(argument);
+
+        if(m_current.get_type() == Token::Type::COMMA)
+        {
+            advance();
+            m_expr_stack.push_back(frame);
+            return begin_argument();
+        }
+
         if(m_current.get_type() != Token::Type::RIGHT_PAREN)
         {
-            ArgumentNode* argument = parse_argument();
-            if(argument == nullptr) return nullptr;
-            node->arguments.emplace_back(argument);
+            push_error(m_current.get_offset(), "Expected a ')' to match the '( at {}",
+                    m_source.get_position(frame.offset));
+        }
 
-            while(m_current.get_type() == Token::Type::COMMA)
-            {
-                advance();
-                argument = parse_argument();
-                if(argument == nullptr) return nullptr;
-                node->arguments.emplace_back(argument);
-            }
+        return end_call(frame.offset, list_begin);
+    }
 
-            if(m_current.get_type() != Token::Type::RIGHT_PAREN)
+    NodeIndex Parser::end_call(SourceOffset offset, std::size_t list_begin)
+    {
+        advance();
+
+        const std::uint32_t argument_count = static_cast<std::uint32_t>(m_list_stack.size() - list_begin - 1);
+        return add_node(NodeType::CALL, offset, { pop_list(list_begin), argument_count });
+    }
+
+    NodeIndex Parser::begin_argument()
+    {
+        const SourceOffset offset = m_current.get_offset();
+        NameIndex label = NO_NAME;
+
+        if(m_current.is_keyword())
+        {
+            label = add_name(get_text(m_current));
+            advance();
+            if(m_current.get_type() != Token::Type::COLON)
             {
-                push_error(m_current.get_position(), "Expected a ')' to match the '( at {}", node->position);
+                push_error(m_current.get_offset(), "Expected a ':'.");
+                return NO_NODE;
             }
+            advance();
         }
 
-        advance();
+        m_expr_stack.push_back({
+            .step = ExprStep::ARGUMENT_VALUE,
+            .offset = offset,
+            .operand_offset = m_current.get_offset(),
+            .data = label
+        });
+        push_expression(ExprPrecedence::ADDITIVE);
+        return NO_NODE;
+    }
 
-        return node;
+    NodeIndex Parser::finish_argument(const ExprFrame& frame, NodeIndex value)
+    {
+        if(value == NO_NODE)
+        {
+            push_expected_expr_error(frame.operand_offset);
+            return NO_NODE;
+        }
+
+        if(frame.step == ExprStep::ARGUMENT_VALUE && frame.data != NO_NAME
+            && m_current.get_type() == Token::Type::COLON && m_ast->get_type(value) == NodeType::VARIABLE_ACCESS)
+        {
+            const NameIndex label = m_ast->get_operands(value).data;
+            advance();
+
+            m_expr_stack.push_back({
+                .step = ExprStep::ARGUMENT_LABELED_VALUE,
+                .offset = frame.offset,
+                .operand_offset = m_current.get_offset(),
+                .data = label
+            });
+            push_expression(ExprPrecedence::ADDITIVE);
+            return NO_NODE;
+        }
+
+        return add_node(NodeType::ARGUMENT, frame.offset, { .lhs = value, .data = frame.data });
     }
 
     const Parser::ExprRule& Parser::get_rule(Token::Type type)
     {
         static const auto rules = arr_from_designators<ExprRule, static_cast<std::size_t>(Token::Type::TT_COUNT), Token::Type>({
-            { Token::Type::TT_EOF,          {   nullptr,                            nullptr,                        ExprPrecedence::NONE                } },
-            { Token::Type::ERROR,           {   nullptr,                            nullptr,                        ExprPrecedence::NONE                } },
+            { Token::Type::TT_EOF,          {   ExprPrefix::NONE,                   ExprInfix::NONE,                ExprPrecedence::NONE                } },
+            { Token::Type::ERROR,           {   ExprPrefix::NONE,                   ExprInfix::NONE,                ExprPrecedence::NONE                } },
 
-            { Token::Type::INT_CONSTANT,    {   &Parser::parse_constant,            nullptr,                        ExprPrecedence::NONE                } },
-            { Token::Type::FLOAT_CONSTANT,  {   &Parser::parse_constant,            nullptr,                        ExprPrecedence::NONE                } },
+            { Token::Type::INT_CONSTANT,    {   ExprPrefix::CONSTANT,               ExprInfix::NONE,                ExprPrecedence::NONE                } },
+            { Token::Type::FLOAT_CONSTANT,  {   ExprPrefix::CONSTANT,               ExprInfix::NONE,                ExprPrecedence::NONE                } },
 
-            { Token::Type::IDENTIFIER,      {   &Parser::parse_variable_access,     nullptr,                        ExprPrecedence::NONE                } },
+            { Token::Type::IDENTIFIER,      {   ExprPrefix::VARIABLE_ACCESS,        ExprInfix::NONE,                ExprPrecedence::NONE                } },
 
-            { Token::Type::PLUS,            {   &Parser::parse_unary_op,            &Parser::parse_binary_op,       ExprPrecedence::ADDITIVE            } },
-            { Token::Type::MINUS,           {   &Parser::parse_unary_op,            &Parser::parse_binary_op,       ExprPrecedence::ADDITIVE            } },
-            { Token::Type::STAR,            {   nullptr,                            &Parser::parse_binary_op,       ExprPrecedence::MULTIPLICATIVE      } },
-            { Token::Type::SLASH,           {   nullptr,                            &Parser::parse_binary_op,       ExprPrecedence::MULTIPLICATIVE      } },
-            { Token::Type::PERCENT,         {   nullptr,                            &Parser::parse_binary_op,       ExprPrecedence::MULTIPLICATIVE      } },
+            { Token::Type::PLUS,            {   ExprPrefix::UNARY_OP,               ExprInfix::BINARY_OP,           ExprPrecedence::ADDITIVE            } },
+            { Token::Type::MINUS,           {   ExprPrefix::UNARY_OP,               ExprInfix::BINARY_OP,           ExprPrecedence::ADDITIVE            } },
+            { Token::Type::STAR,            {   ExprPrefix::NONE,                   ExprInfix::BINARY_OP,           ExprPrecedence::MULTIPLICATIVE      } },
+            { Token::Type::SLASH,           {   ExprPrefix::NONE,                   ExprInfix::BINARY_OP,           ExprPrecedence::MULTIPLICATIVE      } },
+            { Token::Type::PERCENT,         {   ExprPrefix::NONE,                   ExprInfix::BINARY_OP,           ExprPrecedence::MULTIPLICATIVE      } },
 
-            { Token::Type::LEFT_PAREN,      {   &Parser::parse_grouping,            &Parser::parse_call,            ExprPrecedence::CALL                } },
-            { Token::Type::RIGHT_PAREN,     {   nullptr,                            nullptr,                        ExprPrecedence::NONE                } },
+            { Token::Type::LEFT_PAREN,      {   ExprPrefix::GROUPING,               ExprInfix::CALL,                ExprPrecedence::CALL                } },
+            { Token::Type::RIGHT_PAREN,     {   ExprPrefix::NONE,                   ExprInfix::NONE,                ExprPrecedence::NONE                } },
         });
 
         return rules[static_cast<std::size_t>(type)];
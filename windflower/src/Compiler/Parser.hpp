@@ -2,13 +2,11 @@
 #define WF_PARSER_HPP
 
 #include <stack>
-#include <concepts>
 
 #include "Nodes.hpp"
 #include "Tokenizer.hpp"
 
 #include "Utils/Array.hpp"
-#include "Utils/ScopedPtr.hpp"
 #include "ErrorManager.hpp"
 
 namespace wf
@@ -16,22 +14,25 @@ namespace wf
     class Parser
     {
     public:
-        Parser(State* state, const CompileInfo& compile_info);
+        Parser(State* state, const Source& source, Ast* output);
 
-        Node* parse();
+        // Returns the root statement block, or NO_NODE if there were errors.
+        NodeIndex parse();
         const String& get_error_message() const { return m_error_manager.get_message(); }
     private:
         State* const m_state;
+        const Source& m_source;
+        Ast* const m_ast;
         Tokenizer m_tokenizer;
         ErrorManager m_error_manager;
         std::stack<bool, DynamicArray<bool>> m_newline_ignore_stack;
         bool m_is_panicking = false;
-
-        DynamicArray<ScopedPtr<Node>> m_allocated_nodes;
+        // Children of the lists being parsed. Nested lists are pushed above their parent's elements.
+        DynamicArray<NodeIndex> m_list_stack;
 
         Token m_current;
 
-        enum class ExprPrecedence
+        enum class ExprPrecedence : std::uint8_t
         {
             NONE,
             ADDITIVE,
@@ -41,60 +42,106 @@ namespace wf
             PRIMARY,
         };
 
-        using ExprPrefixFunc = Node*(Parser::*)();
-        using ExprInfixFunc = Node*(Parser::*)(Node* prev);
+        enum class ExprPrefix : std::uint8_t
+        {
+            NONE, CONSTANT, VARIABLE_ACCESS, UNARY_OP, GROUPING
+        };
+
+        enum class ExprInfix : std::uint8_t
+        {
+            NONE, BINARY_OP, CALL
+        };
 
         struct ExprRule
         {
-            ExprPrefixFunc prefix;
-            ExprInfixFunc infix;
+            ExprPrefix prefix;
+            ExprInfix infix;
             ExprPrecedence precedence;
         };
 
+        // Expressions are parsed with an explicit stack instead of recursion, so deeply nested expressions
+        // cannot overflow the native stack. A step either produces a node or pushes the steps that will.
+        enum class ExprStep : std::uint8_t
+        {
+            // Parses a prefix and the operators following it.
+            EXPRESSION,
+            // Continues an expression whose last operand or operator has been parsed.
+            INFIX,
+            UNARY_OPERAND,
+            BINARY_RIGHT_OPERAND,
+            GROUPING_END,
+            CALL_ARGUMENT,
+            ARGUMENT_VALUE,
+            ARGUMENT_LABELED_VALUE,
+        };
+
+        struct ExprFrame
+        {
+            ExprStep step;
+            ExprPrecedence precedence = ExprPrecedence::NONE;
+            SourceOffset offset = 0;
+            SourceOffset operand_offset = 0;
+            NodeIndex node = NO_NODE;
+            std::uint32_t data = 0;
+        };
+
+        DynamicArray<ExprFrame> m_expr_stack;
+
         template<typename... Args>
-        void push_error(const SourcePosition& position, fmt::format_string<Args...> format_str, Args&&... args)
+        void push_error(SourceOffset offset, fmt::format_string<Args...> format_str, Args&&... args)
         {
             if(m_is_panicking) return;
             m_is_panicking = true;
-            m_error_manager.push_error(position, format_str, std::forward<Args>(args)...);
+            m_error_manager.push_error(offset, format_str, std::forward<Args>(args)...);
         }
 
-        void push_expected_expr_error(const SourcePosition& position);
-        void push_expected_identifier_error(const SourcePosition& position);
-        void push_expected_storage_type_error(const SourcePosition& position);
+        void push_expected_expr_error(SourceOffset offset);
+        void push_expected_identifier_error(SourceOffset offset);
+        void push_expected_storage_type_error(SourceOffset offset);
 
         void advance();
 
         void push_newline_ignore(bool value);
         void pop_newline_ignore();
 
-        BuiltinTypeNode* parse_builtin_type();
-
-        StatementBlockNode* parse_statement_block();
-        Node* parse_statement();
-        VariableDeclarationNode* parse_variable_declaration();
-        ParameterNode* parse_parameter();
-        ArgumentNode* parse_argument();
-        ExternFunctionDeclarationNode* parse_extern_function_declaration();
-
-        ReturnNode* parse_return();
-
-        Node* parse_expression(ExprPrecedence precedence = ExprPrecedence::ADDITIVE);
-        Node* parse_binary_op(Node* prev);
-        Node* parse_unary_op();
-        Node* parse_constant();
-        Node* parse_variable_access();
-        Node* parse_grouping();
-        Node* parse_call(Node* prev);
+        std::string_view get_text(const Token& token) const;
+        NodeIndex add_node(NodeType type, SourceOffset offset, const NodeOperands& operands = {});
+        NameIndex add_name(std::string_view text);
+        // Moves the list elements pushed since `list_begin` into the tree.
+        std::uint32_t pop_list(std::size_t list_begin);
+
+        NodeIndex parse_builtin_type();
+
+        NodeIndex parse_statement_block();
+        NodeIndex parse_statement();
+        NodeIndex parse_variable_declaration();
+        NodeIndex parse_parameter();
+        NodeIndex parse_extern_function_declaration();
+
+        NodeIndex parse_return();
+
+        NodeIndex parse_expression(ExprPrecedence precedence = ExprPrecedence::ADDITIVE);
+        void push_expression(ExprPrecedence precedence);
+        NodeIndex parse_prefix(ExprPrecedence precedence);
+        NodeIndex parse_infix(ExprPrecedence precedence, NodeIndex prev);
+        NodeIndex parse_constant();
+        NodeIndex parse_variable_access();
+
+        // The begin_* functions consume the leading tokens and push the steps parsing the operands, the
+        // finish_* functions build the node once the operand is parsed.
+        NodeIndex begin_unary_op();
+        NodeIndex finish_unary_op(const ExprFrame& frame, NodeIndex operand);
+        NodeIndex begin_binary_op(NodeIndex prev);
+        NodeIndex finish_binary_op(const ExprFrame& frame, NodeIndex right_operand);
+        NodeIndex begin_grouping();
+        NodeIndex finish_grouping(const ExprFrame& frame, NodeIndex expr);
+        NodeIndex begin_call(NodeIndex prev);
+        NodeIndex continue_call(const ExprFrame& frame, NodeIndex argument);
+        NodeIndex end_call(SourceOffset offset, std::size_t list_begin);
+        NodeIndex begin_argument();
+        NodeIndex finish_argument(const ExprFrame& frame, NodeIndex value);
 
         static const ExprRule& get_rule(Token::Type type);
-
-        template<typename T, typename... Args> requires(std::derived_from<T, Node> && std::constructible_from<T, Args...>)
-        T* allocate_node(Args&&... args)
-        {
-            m_allocated_nodes.push_back(construct_scoped<T>(m_state, std::forward<Args>(args)...));
-            return static_cast<T*>(m_allocated_nodes.back().get());
-        }
     };
 }
 
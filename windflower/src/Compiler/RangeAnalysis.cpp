@@ -0,0 +1,92 @@
+#include "RangeAnalysis.hpp"
+
+namespace wf
+{
+    void RangeAnalysis::reset(const ActionTree* actions, std::uint32_t variable_count)
+    {
+        m_actions = actions;
+        m_ranges.assign(actions->get_action_count(), IntRange());
+        m_computed.assign(actions->get_action_count(), false);
+        m_variable_ranges.assign(variable_count, IntRange());
+    }
+
+    void RangeAnalysis::add_declaration(ActionIndex action)
+    {
+        const ActionOperands& operands = m_actions->get_operands(action);
+        m_variable_ranges[operands.data] = get_range(operands.lhs);
+    }
+
+    IntRange RangeAnalysis::get_range(ActionIndex action)
+    {
+        push_operand(action);
+        while(!m_action_stack.empty())
+        {
+            const ActionIndex current = m_action_stack.back();
+            if(m_computed[current])
+            {
+                m_action_stack.pop_back();
+                continue;
+            }
+
+            // The action is only computed once the ranges of all its operands are.
+            const ActionOperands& operands = m_actions->get_operands(current);
+            if(m_actions->get_type(current) == ActionType::INT_BINARY)
+            {
+                const bool rhs_computed = push_operand(operands.rhs);
+                const bool lhs_computed = push_operand(operands.lhs);
+                if(!rhs_computed || !lhs_computed) continue;
+            }
+            else if(m_actions->get_type(current) == ActionType::INT_UNARY)
+            {
+                if(!push_operand(operands.lhs)) continue;
+            }
+
+            m_action_stack.pop_back();
+            m_ranges[current] = compute_range(current);
+            m_computed[current] = true;
+        }
+
+        return m_ranges[action];
+    }
+
+    bool RangeAnalysis::push_operand(ActionIndex action)
+    {
+        if(m_computed[action]) return true;
+
+        m_action_stack.push_back(action);
+        return false;
+    }
+
+    IntRange RangeAnalysis::compute_range(ActionIndex action) const
+    {
+        const ActionOperands& operands = m_actions->get_operands(action);
+        switch(m_actions->get_type(action))
+        {
+            case ActionType::INT_CONSTANT:
+            {
+                const UInt value = m_actions->get_int_constant(action);
+                return { value, value };
+            }
+            case ActionType::STACK_VARIABLE_ACCESS:
+                return m_variable_ranges[operands.data];
+            case ActionType::INT_UNARY:
+                return negate_range(m_ranges[operands.lhs]);
+            case ActionType::INT_BINARY:
+                break;
+            default:
+                return {};
+        }
+
+        const IntRange lhs = m_ranges[operands.lhs];
+        const IntRange rhs = m_ranges[operands.rhs];
+        switch(static_cast<IntBinaryOperation>(operands.data))
+        {
+            case IntBinaryOperation::ADD: return add_ranges(lhs, rhs);
+            case IntBinaryOperation::SUBTRACT: return subtract_ranges(lhs, rhs);
+            case IntBinaryOperation::MULTIPLY: return multiply_ranges(lhs, rhs);
+            case IntBinaryOperation::DIVIDE: return divide_ranges(lhs, rhs);
+            case IntBinaryOperation::MODULO: return modulo_ranges(lhs, rhs);
+        }
+        return {};
+    }
+}
\ No newline at end of file
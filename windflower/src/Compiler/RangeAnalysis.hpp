@@ -0,0 +1,38 @@
+#ifndef WF_RANGE_ANALYSIS_HPP
+#define WF_RANGE_ANALYSIS_HPP
+
+#include "Compiler/Actions.hpp"
+#include "Utils/IntRange.hpp"
+
+namespace wf
+{
+    // Computes the ranges of int expressions in the statements of a block. Variables are only ever written by
+    // their declaration, so every read of a variable has the range of its initializer.
+    class RangeAnalysis
+    {
+    public:
+        explicit RangeAnalysis(State* state)
+            : m_ranges(state), m_computed(state), m_variable_ranges(state), m_action_stack(state)
+        {
+        }
+
+        void reset(const ActionTree* actions, std::uint32_t variable_count);
+        // Declarations have to be added in the order they execute, before any statement reading them is analyzed.
+        void add_declaration(ActionIndex action);
+        IntRange get_range(ActionIndex action);
+    private:
+        const ActionTree* m_actions = nullptr;
+        // Range of each action, valid once it is computed. Every action is only analyzed once.
+        DynamicArray<IntRange> m_ranges;
+        DynamicArray<bool> m_computed;
+        DynamicArray<IntRange> m_variable_ranges;
+        DynamicArray<ActionIndex> m_action_stack;
+
+        // Operands are analyzed with an explicit stack like everywhere else in the compiler.
+        bool push_operand(ActionIndex action);
+        // Computes the range of `action` from the ranges of its operands.
+        IntRange compute_range(ActionIndex action) const;
+    };
+}
+
+#endif
\ No newline at end of file
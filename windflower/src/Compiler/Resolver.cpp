@@ -17,7 +17,7 @@ struct fmt::formatter<wf::TypeId>
 };
 
 template<>
-struct fmt::formatter<wf::BinaryOpNode::Operation>
+struct fmt::formatter<wf::BinaryOperator>
 {
     template<typename ParseContext>
     constexpr auto parse(ParseContext& ctx)
@@ -26,24 +26,24 @@ struct fmt::formatter<wf::BinaryOpNode::Operation>
     }
 
     template<typename FormatContext>
-    auto format(const wf::BinaryOpNode::Operation& operation, FormatContext& ctx)
+    auto format(const wf::BinaryOperator& operation, FormatContext& ctx)
     {
         std::string_view result;
         switch(operation)
         {
-            case wf::BinaryOpNode::Operation::ADD:
+            case wf::BinaryOperator::ADD:
                 result = "+";
                 break;
-            case wf::BinaryOpNode::Operation::SUBTRACT:
+            case wf::BinaryOperator::SUBTRACT:
                 result = "-";
                 break;
-            case wf::BinaryOpNode::Operation::MULTIPLY:
+            case wf::BinaryOperator::MULTIPLY:
                 result = "*";
                 break;
-            case wf::BinaryOpNode::Operation::DIVIDE:
+            case wf::BinaryOperator::DIVIDE:
                 result = "/";
                 break;
-            case wf::BinaryOpNode::Operation::MODULO:
+            case wf::BinaryOperator::MODULO:
                 result = "%";
                 break;
         }
@@ -52,7 +52,7 @@ struct fmt::formatter<wf::BinaryOpNode::Operation>
 };
 
 template<>
-struct fmt::formatter<wf::UnaryOpNode::Operation>
+struct fmt::formatter<wf::UnaryOperator>
 {
     template<typename ParseContext>
     constexpr auto parse(ParseContext& ctx)
@@ -61,14 +61,14 @@ struct fmt::formatter<wf::UnaryOpNode::Operation>
     }
 
     template<typename FormatContext>
-    auto format(const wf::UnaryOpNode::Operation& operation, FormatContext& ctx)
+    auto format(const wf::UnaryOperator& operation, FormatContext& ctx)
     {
         std::string_view result;
         switch(operation)
         {
-            case wf::UnaryOpNode::Operation::PLUS:
+            case wf::UnaryOperator::PLUS:
                 return "+";
-            case wf::UnaryOpNode::Operation::NEGATE:
+            case wf::UnaryOperator::NEGATE:
                 return "-";
         }
         return fmt::format_to(ctx.out(), "{}", result);
@@ -77,30 +77,29 @@ struct fmt::formatter<wf::UnaryOpNode::Operation>
 
 namespace wf
 {
-    Resolver::Resolver(State* state)
-        : m_state(state), m_allocated_actions(state), m_error_manager(state), m_symbols(state)
+    Resolver::Resolver(State* state, const Source& source, const Ast* ast, ActionTree* output)
+        : m_state(state), m_ast(ast), m_actions(output), m_folder(output), m_error_manager(state, source),
+            m_symbols(state), m_expr_stack(state), m_expr_results(state)
     {
     }
 
-    Action* Resolver::resolve_ast(Node* ast)
+    ActionIndex Resolver::resolve_ast(NodeIndex root)
     {
-        Action* action_tree = resolve_node(ast);
+        ActionIndex action_tree = resolve_node(root);
 
-        if(m_error_manager.has_errors()) return nullptr;
+        if(m_error_manager.has_errors()) return NO_ACTION;
 
         return action_tree;
     }
 
-    std::optional<TypeId> Resolver::evaluate_type(BuiltinTypeNode* node)
+    std::optional<TypeId> Resolver::evaluate_type(NodeIndex node)
     {
-        return node->type_id;
+        return static_cast<TypeId>(m_ast->get_operands(node).data);
     }
 
-    ExprAction* Resolver::promote_expr(ExprAction* expr, TypeId to_type)
+    ActionIndex Resolver::promote_expr(ActionIndex expr, TypeId to_type)
     {
-        if(expr->get_result_type() == to_type) return expr;
-
-        return allocate_action<NumericConversionAction>(expr->position, to_type, expr);
+        return m_folder.add_numeric_conversion(m_actions->get_offset(expr), to_type, expr);
     }
 
     bool Resolver::is_implicitly_convertible_to(TypeId from, TypeId to)
@@ -108,102 +107,172 @@ namespace wf
         return (from == to) || (from == TypeId::INT && to == TypeId::FLOAT);
     }
 
-    Action* Resolver::resolve_node(const Node* node)
+    ActionIndex Resolver::resolve_node(NodeIndex node)
     {
-        switch(node->type)
+        switch(m_ast->get_type(node))
         {
-            case Node::Type::STATEMENT_BLOCK: return resolve_statement_block(static_cast<const StatementBlockNode*>(node));
-            case Node::Type::VARIABLE_DECLARATION: return resolve_variable_declaration(static_cast<const VariableDeclarationNode*>(node));
-            case Node::Type::RETURN: return resolve_return(static_cast<const ReturnNode*>(node));
-
-            case Node::Type::BINARY_OP:
-            case Node::Type::UNARY_OP:
-            case Node::Type::CONSTANT:
-            case Node::Type::VARIABLE_ACCESS:
-            case Node::Type::BUILTIN_TYPE:
-                m_error_manager.push_error(node->position, "Resolver::resolve_node() reached an unexpected point");
-                return nullptr;
+            case NodeType::STATEMENT_BLOCK: return resolve_statement_block(node);
+            case NodeType::VARIABLE_DECLARATION: return resolve_variable_declaration(node);
+            case NodeType::RETURN: return resolve_return(node);
+
+            case NodeType::BINARY_OP:
+            case NodeType::UNARY_OP:
+            case NodeType::INT_CONSTANT:
+            case NodeType::FLOAT_CONSTANT:
+            case NodeType::VARIABLE_ACCESS:
+            case NodeType::BUILTIN_TYPE:
+            case NodeType::PARAMETER:
+            case NodeType::ARGUMENT:
+            case NodeType::EXTERN_FUNCTION_DECLARATION:
+            case NodeType::CALL:
+                m_error_manager.push_error(m_ast->get_offset(node), "Resolver::resolve_node() reached an unexpected point");
+                return NO_ACTION;
         }
     }
 
-    ExprAction* Resolver::resolve_expr(const Node* node)
+    ActionIndex Resolver::resolve_expr(NodeIndex root)
     {
-        switch(node->type)
+        const std::size_t stack_begin = m_expr_stack.size();
+        m_expr_stack.push_back({ root, false });
+
+        while(m_expr_stack.size() > stack_begin)
         {
-            case Node::Type::BINARY_OP: return resolve_binary_op(static_cast<const BinaryOpNode*>(node));
-            case Node::Type::UNARY_OP: return resolve_unary_op(static_cast<const UnaryOpNode*>(node));
-            case Node::Type::CONSTANT: return resolve_constant(static_cast<const ConstantNode*>(node));
-            case Node::Type::VARIABLE_ACCESS: return resolve_variable_access(static_cast<const VariableAccessNode*>(node));
-
-            case Node::Type::STATEMENT_BLOCK:
-            case Node::Type::BUILTIN_TYPE:
-            case Node::Type::VARIABLE_DECLARATION:
-            case Node::Type::RETURN:
-                m_error_manager.push_error(node->position, "Resolver::resolve_expr() reached an unexpected point");
-                return nullptr;
+            const ExprFrame frame = m_expr_stack.back();
+            m_expr_stack.pop_back();
+
+            const NodeIndex node = frame.node;
+            const NodeOperands& operands = m_ast->get_operands(node);
+            switch(m_ast->get_type(node))
+            {
+                case NodeType::BINARY_OP:
+                    if(!frame.operands_resolved)
+                    {
+                        // The left operand is on top, so it is resolved first.
+                        m_expr_stack.push_back({ node, true });
+                        m_expr_stack.push_back({ operands.rhs, false });
+                        m_expr_stack.push_back({ operands.lhs, false });
+                    }
+                    else
+                    {
+                        const ActionIndex right_operand = pop_expr_result();
+                        const ActionIndex left_operand = pop_expr_result();
+                        m_expr_results.push_back(resolve_binary_op(node, left_operand, right_operand));
+                    }
+                    break;
+                case NodeType::UNARY_OP:
+                    if(!frame.operands_resolved)
+                    {
+                        m_expr_stack.push_back({ node, true });
+                        m_expr_stack.push_back({ operands.lhs, false });
+                    }
+                    else
+                    {
+                        m_expr_results.push_back(resolve_unary_op(node, pop_expr_result()));
+                    }
+                    break;
+                case NodeType::INT_CONSTANT:
+                case NodeType::FLOAT_CONSTANT:
+                    m_expr_results.push_back(resolve_constant(node));
+                    break;
+                case NodeType::VARIABLE_ACCESS:
+                    m_expr_results.push_back(resolve_variable_access(node));
+                    break;
+
+                case NodeType::STATEMENT_BLOCK:
+                case NodeType::BUILTIN_TYPE:
+                case NodeType::VARIABLE_DECLARATION:
+                case NodeType::PARAMETER:
+                case NodeType::ARGUMENT:
+                case NodeType::EXTERN_FUNCTION_DECLARATION:
+                case NodeType::RETURN:
+                case NodeType::CALL:
+                    m_error_manager.push_error(m_ast->get_offset(node), "Resolver::resolve_expr() reached an unexpected point");
+                    m_expr_results.push_back(NO_ACTION);
+                    break;
+            }
         }
+
+        return pop_expr_result();
+    }
+
+    ActionIndex Resolver::pop_expr_result()
+    {
+        const ActionIndex result = m_expr_results.back();
+        m_expr_results.pop_back();
+        return result;
     }
 
-    Action* Resolver::resolve_statement_block(const StatementBlockNode* node)
+    ActionIndex Resolver::resolve_statement_block(NodeIndex node)
     {
-        DynamicArray<Action*> statements(m_state);
-        for(const Node* statement : node->statements)
+        const NodeOperands& operands = m_ast->get_operands(node);
+
+        DynamicArray<ActionIndex> statements(m_state);
+        for(NodeIndex statement : m_ast->get_extra(operands.lhs, operands.rhs))
         {
-            Action* action = resolve_node(statement);
-            if(action != nullptr)
+            ActionIndex action = resolve_node(statement);
+            if(action != NO_ACTION)
             {
                 statements.emplace_back(action);
             }
         }
 
-        return allocate_action<StatementBlockAction>(node->position, std::move(statements), m_symbols.get_stack_symbol_count());
+        return m_actions->add_action(ActionType::STATEMENT_BLOCK, TypeId::VOID, m_ast->get_offset(node), {
+            m_actions->add_extra(statements),
+            static_cast<std::uint32_t>(statements.size()),
+            m_symbols.get_stack_symbol_count()
+        });
     }
 
-    Action* Resolver::resolve_variable_declaration(const VariableDeclarationNode* node)
+    ActionIndex Resolver::resolve_variable_declaration(NodeIndex node)
     {
-        auto it = m_symbols.find(node->name);
+        const NodeOperands& operands = m_ast->get_operands(node);
+        const SourceOffset offset = m_ast->get_offset(node);
+        StringObject* name = m_ast->get_name(operands.data);
+
+        auto it = m_symbols.find(name);
         if(it != m_symbols.end())
         {
-            m_error_manager.push_error(node->position,
+            m_error_manager.push_error(offset,
                 "'{}' was already defined when redefined here.",
-                    std::string_view(node->name->text, node->name->length)
+                    std::string_view(name->text, name->length)
             );
-            return nullptr;
+            return NO_ACTION;
         }
 
-        ExprAction* initializer = nullptr;
+        ActionIndex initializer = NO_ACTION;
 
-        SymbolInfo& symbol_info = m_symbols.create_variable(node->name);
+        SymbolInfo& symbol_info = m_symbols.create_variable(name);
 
-        if(node->storage_type != nullptr)
+        if(operands.rhs != NO_NODE)
         {
-            std::optional<TypeId> storage_type = evaluate_type(node->storage_type);
+            std::optional<TypeId> storage_type = evaluate_type(operands.rhs);
             if(!storage_type.has_value())
             {
-                return nullptr;
+                return NO_ACTION;
             }
             symbol_info.storage_type = storage_type.value();
         }
 
-        if(node->initializer != nullptr)
+        if(operands.lhs != NO_NODE)
         {
-            initializer = resolve_expr(node->initializer);
-            if(initializer == nullptr) return nullptr;
+            initializer = resolve_expr(operands.lhs);
+            if(initializer == NO_ACTION) return NO_ACTION;
 
-            if(node->storage_type == nullptr)
+            const TypeId initializer_type = m_actions->get_result_type(initializer);
+            if(operands.rhs == NO_NODE)
             {
-                symbol_info.storage_type = initializer->get_result_type();
+                symbol_info.storage_type = initializer_type;
             }
             else
             {
-                if(!is_implicitly_convertible_to(initializer->get_result_type(), symbol_info.storage_type))
+                if(!is_implicitly_convertible_to(initializer_type, symbol_info.storage_type))
                 {
-                    m_error_manager.push_error(node->position,
+                    m_error_manager.push_error(offset,
                         "'{}' can not be implicitly converted to '{}'.",
-                            initializer->get_result_type(),
+                            initializer_type,
                             symbol_info.storage_type
                     );
-                    return nullptr;
+                    return NO_ACTION;
                 }
                 initializer = promote_expr(initializer, symbol_info.storage_type);
             }
@@ -212,183 +281,179 @@ namespace wf
         {
             if(symbol_info.storage_type == TypeId::INT)
             {
-                initializer = allocate_action<IntConstantAction>(node->position, TypeId::INT, 0);
+                initializer = m_actions->add_int_constant(offset, 0);
             }
             else if(symbol_info.storage_type == TypeId::FLOAT)
             {
-                initializer = allocate_action<FloatConstantAction>(node->position, TypeId::INT, 0.0);
+                initializer = m_actions->add_float_constant(offset, 0.0);
             }
         }
 
-        return allocate_action<CreateStackVariableAction>(node->position, symbol_info.address, initializer);
+        return m_actions->add_action(ActionType::CREATE_STACK_VAR, TypeId::VOID, offset,
+                { .lhs = initializer, .data = symbol_info.address });
     }
 
-    Action* Resolver::resolve_return(const ReturnNode* node)
+    ActionIndex Resolver::resolve_return(NodeIndex node)
     {
-        if(node->return_value == nullptr)
+        const NodeIndex value = m_ast->get_operands(node).lhs;
+        if(value == NO_NODE)
         {
-            return allocate_action<ReturnAction>(node->position, nullptr);
+            return m_actions->add_action(ActionType::RETURN, TypeId::VOID, m_ast->get_offset(node), {});
         }
 
-        ExprAction* return_value = resolve_expr(node->return_value);
-        return allocate_action<ReturnAction>(node->position, return_value);
+        ActionIndex return_value = resolve_expr(value);
+        return m_actions->add_action(ActionType::RETURN, TypeId::VOID, m_ast->get_offset(node),
+                { .lhs = return_value });
     }
 
 
-    ExprAction* Resolver::resolve_binary_op(const BinaryOpNode* node)
+    ActionIndex Resolver::resolve_binary_op(NodeIndex node, ActionIndex left_operand, ActionIndex right_operand)
     {
-        ExprAction* left_operand = resolve_expr(node->left_operand);
-        ExprAction* right_operand = resolve_expr(node->right_operand);
+        const SourceOffset offset = m_ast->get_offset(node);
+        const BinaryOperator operation = static_cast<BinaryOperator>(m_ast->get_operands(node).data);
+
+        if(left_operand == NO_ACTION || right_operand == NO_ACTION) return NO_ACTION;
 
-        if(left_operand == nullptr || right_operand == nullptr) return nullptr;
+        const TypeId left_type = m_actions->get_result_type(left_operand);
+        const TypeId right_type = m_actions->get_result_type(right_operand);
 
-        switch(node->operation)
+        switch(operation)
         {
-            case BinaryOpNode::Operation::ADD:
-            case BinaryOpNode::Operation::SUBTRACT:
-            case BinaryOpNode::Operation::MULTIPLY:
-            case BinaryOpNode::Operation::DIVIDE:
+            case BinaryOperator::ADD:
+            case BinaryOperator::SUBTRACT:
+            case BinaryOperator::MULTIPLY:
+            case BinaryOperator::DIVIDE:
             {
-                if(!type_id_is_numeric(left_operand->get_result_type()) || !type_id_is_numeric(right_operand->get_result_type()))
+                if(!type_id_is_numeric(left_type) || !type_id_is_numeric(right_type))
                 {
-                    m_error_manager.push_error(node->position,
+                    m_error_manager.push_error(offset,
                         "Cannot perform '{}' with operands of type '{}' and '{}",
-                            node->operation,
-                            left_operand->get_result_type(),
-                            right_operand->get_result_type()
+                            operation,
+                            left_type,
+                            right_type
                     );
-                    return nullptr;
+                    return NO_ACTION;
                 }
 
-                TypeId result_type = type_id_numeric_promote(left_operand->get_result_type(), right_operand->get_result_type());
+                TypeId result_type = type_id_numeric_promote(left_type, right_type);
                 left_operand = promote_expr(left_operand, result_type);
                 right_operand = promote_expr(right_operand, result_type);
 
                 if(type_id_is_int(result_type))
                 {
-                    IntBinaryOperation operation;
-                    switch(node->operation)
+                    IntBinaryOperation int_operation;
+                    switch(operation)
                     {
-                        case BinaryOpNode::Operation::ADD:
-                            operation = IntBinaryOperation::ADD;
+                        case BinaryOperator::ADD:
+                            int_operation = IntBinaryOperation::ADD;
                             break;
-                        case BinaryOpNode::Operation::SUBTRACT:
-                            operation = IntBinaryOperation::SUBTRACT;
+                        case BinaryOperator::SUBTRACT:
+                            int_operation = IntBinaryOperation::SUBTRACT;
                             break;
-                        case BinaryOpNode::Operation::MULTIPLY:
-                            operation = IntBinaryOperation::MULTIPLY;
+                        case BinaryOperator::MULTIPLY:
+                            int_operation = IntBinaryOperation::MULTIPLY;
                             break;
-                        case BinaryOpNode::Operation::DIVIDE:
-                            operation = IntBinaryOperation::DIVIDE;
+                        case BinaryOperator::DIVIDE:
+                            int_operation = IntBinaryOperation::DIVIDE;
                             break;
                         default:
-                            return nullptr;
+                            return NO_ACTION;
                     }
-                    return allocate_action<IntBinaryAction>(node->position, operation, result_type,
-                            left_operand, right_operand);
+                    return m_folder.add_int_binary(offset, int_operation, left_operand, right_operand);
                 }
                 else // is float
                 {
-                    FloatBinaryOperation operation;
-                    switch(node->operation)
+                    FloatBinaryOperation float_operation;
+                    switch(operation)
                     {
-                        case BinaryOpNode::Operation::ADD:
-                            operation = FloatBinaryOperation::ADD;
+                        case BinaryOperator::ADD:
+                            float_operation = FloatBinaryOperation::ADD;
                             break;
-                        case BinaryOpNode::Operation::SUBTRACT:
-                            operation = FloatBinaryOperation::SUBTRACT;
+                        case BinaryOperator::SUBTRACT:
+                            float_operation = FloatBinaryOperation::SUBTRACT;
                             break;
-                        case BinaryOpNode::Operation::MULTIPLY:
-                            operation = FloatBinaryOperation::MULTIPLY;
+                        case BinaryOperator::MULTIPLY:
+                            float_operation = FloatBinaryOperation::MULTIPLY;
                             break;
-                        case BinaryOpNode::Operation::DIVIDE:
-                            operation = FloatBinaryOperation::DIVIDE;
+                        case BinaryOperator::DIVIDE:
+                            float_operation = FloatBinaryOperation::DIVIDE;
                             break;
                         default:
-                            return nullptr;
+                            return NO_ACTION;
                     }
-                    return allocate_action<FloatBinaryAction>(node->position, operation, result_type,
-                            left_operand, right_operand);
+                    return m_folder.add_float_binary(offset, float_operation, left_operand, right_operand);
                 }
                 break;
             }
-            case BinaryOpNode::Operation::MODULO:
+            case BinaryOperator::MODULO:
             {
-                if(!type_id_is_int(left_operand->get_result_type()) || !type_id_is_int(right_operand->get_result_type()))
+                if(!type_id_is_int(left_type) || !type_id_is_int(right_type))
                 {
-                    m_error_manager.push_error(node->position,
+                    m_error_manager.push_error(offset,
                         "Cannot perform '{}' with operands of type '{}' and '{}",
-                            node->operation,
-                            left_operand->get_result_type(),
-                            right_operand->get_result_type()
+                            operation,
+                            left_type,
+                            right_type
                     );
-                    return nullptr;
+                    return NO_ACTION;
                 }
 
-                TypeId result_type = type_id_numeric_promote(left_operand->get_result_type(), right_operand->get_result_type());
+                TypeId result_type = type_id_numeric_promote(left_type, right_type);
                 left_operand = promote_expr(left_operand, result_type);
                 right_operand = promote_expr(right_operand, result_type);
 
-                return allocate_action<IntBinaryAction>(node->position, IntBinaryOperation::MODULO, result_type,
-                        left_operand, right_operand);
+                return m_folder.add_int_binary(offset, IntBinaryOperation::MODULO, left_operand, right_operand);
             }
         }
     }
 
-    ExprAction* Resolver::resolve_unary_op(const UnaryOpNode* node)
+    ActionIndex Resolver::resolve_unary_op(NodeIndex node, ActionIndex operand)
     {
-        ExprAction* operand = resolve_expr(node->operand);
-
-        if(operand == nullptr) return nullptr;
+        if(operand == NO_ACTION) return NO_ACTION;
 
-        switch(node->operation)
+        switch(static_cast<UnaryOperator>(m_ast->get_operands(node).data))
         {
-            case UnaryOpNode::Operation::PLUS: return operand;
-            case UnaryOpNode::Operation::NEGATE:
-                switch(operand->get_result_type())
+            case UnaryOperator::PLUS: return operand;
+            case UnaryOperator::NEGATE:
+                switch(m_actions->get_result_type(operand))
                 {
                     case TypeId::INT:
-                        return allocate_action<IntUnaryAction>(node->position,
-                                NumericUnaryOperation::NEGATION, operand);
                     case TypeId::FLOAT:
-                        return allocate_action<FloatUnaryAction>(node->position,
-                                NumericUnaryOperation::NEGATION, operand);
+                        return m_folder.add_negation(m_ast->get_offset(node), operand);
                     default:
-                        return nullptr;
+                        return NO_ACTION;
                 }
         }
     }
 
-    ExprAction* Resolver::resolve_constant(const ConstantNode* node)
+    ActionIndex Resolver::resolve_constant(NodeIndex node)
     {
-        switch(node->value_type)
+        if(m_ast->get_type(node) == NodeType::INT_CONSTANT)
         {
-            case ConstantNode::ValueType::INT:
-                return allocate_action<IntConstantAction>(node->position, TypeId::INT,
-                        std::strtoull(node->value.data(), nullptr, 10));
-            case ConstantNode::ValueType::FLOAT:
-                return allocate_action<FloatConstantAction>(node->position, TypeId::FLOAT,
-                        std::strtod(node->value.data(), nullptr));
+            return m_actions->add_int_constant(m_ast->get_offset(node), m_ast->get_int_constant(node));
         }
+        return m_actions->add_float_constant(m_ast->get_offset(node), m_ast->get_float_constant(node));
     }
 
-    ExprAction* Resolver::resolve_variable_access(const VariableAccessNode* node)
+    ActionIndex Resolver::resolve_variable_access(NodeIndex node)
     {
-        auto it = m_symbols.find(node->name);
+        StringObject* name = m_ast->get_name(m_ast->get_operands(node).data);
+        auto it = m_symbols.find(name);
 
         if(it == m_symbols.end())
         {
-            m_error_manager.push_error(node->position,
+            m_error_manager.push_error(m_ast->get_offset(node),
                 "'{}' is not defined when referenced here.",
-                    std::string_view(node->name->text, node->name->length)
+                    std::string_view(name->text, name->length)
             );
-            return nullptr;
+            return NO_ACTION;
         }
 
         // Void for a variable indicates that its type couldn't be resolved.
-        if(it->second.storage_type == TypeId::VOID) return nullptr;
+        if(it->second.storage_type == TypeId::VOID) return NO_ACTION;
 
-        return allocate_action<StackVariableAccessAction>(node->position, it->second.storage_type, it->second.address);
+        return m_actions->add_action(ActionType::STACK_VARIABLE_ACCESS, it->second.storage_type,
+                m_ast->get_offset(node), { .data = it->second.address });
     }
 
 }
\ No newline at end of file
@@ -1,12 +1,11 @@
 #ifndef WF_RESOLVER_HPP
 #define WF_RESOLVER_HPP
 
-#include <concepts>
 #include <optional>
 
+#include "Compiler/ConstantFolder.hpp"
 #include "Compiler/ErrorManager.hpp"
 #include "Utils/Array.hpp"
-#include "Utils/ScopedPtr.hpp"
 
 #include "Nodes.hpp"
 #include "Actions.hpp"
@@ -16,38 +15,46 @@ namespace wf
     class Resolver
     {
     public:
-        Resolver(State* state);
+        Resolver(State* state, const Source& source, const Ast* ast, ActionTree* output);
 
-        Action* resolve_ast(Node* ast);
+        // Returns the root action, or NO_ACTION if there were errors.
+        ActionIndex resolve_ast(NodeIndex root);
         const String& get_error_message () const { return m_error_manager.get_message(); }
     private:
         State* const m_state;
-        DynamicArray<ScopedPtr<Action>> m_allocated_actions;
+        const Ast* const m_ast;
+        ActionTree* const m_actions;
+        ConstantFolder m_folder;
         ErrorManager m_error_manager;
         SymbolTable m_symbols;
 
-        std::optional<TypeId> evaluate_type(BuiltinTypeNode* node);
-        ExprAction* promote_expr(ExprAction* expr, TypeId to_type);
-        bool is_implicitly_convertible_to(TypeId from, TypeId to);
+        // Expressions are resolved in post-order with explicit stacks, so deeply nested expressions cannot
+        // overflow the native stack.
+        struct ExprFrame
+        {
+            NodeIndex node;
+            bool operands_resolved;
+        };
 
-        Action* resolve_node(const Node* node);
-        ExprAction* resolve_expr(const Node* node);
+        DynamicArray<ExprFrame> m_expr_stack;
+        DynamicArray<ActionIndex> m_expr_results;
 
-        Action* resolve_statement_block(const StatementBlockNode* node);
-        Action* resolve_variable_declaration(const VariableDeclarationNode* node);
-        Action* resolve_return(const ReturnNode* node);
+        std::optional<TypeId> evaluate_type(NodeIndex node);
+        ActionIndex promote_expr(ActionIndex expr, TypeId to_type);
+        bool is_implicitly_convertible_to(TypeId from, TypeId to);
 
-        ExprAction* resolve_binary_op(const BinaryOpNode* node);
-        ExprAction* resolve_unary_op(const UnaryOpNode* node);
-        ExprAction* resolve_constant(const ConstantNode* node);
-        ExprAction* resolve_variable_access(const VariableAccessNode* node);
+        ActionIndex resolve_node(NodeIndex node);
+        ActionIndex resolve_expr(NodeIndex root);
+        ActionIndex pop_expr_result();
 
-        template<typename T, typename... Args> requires(std::derived_from<T, Action> && std::constructible_from<T, Args...>)
-        T* allocate_action(Args&&... args)
-        {
-            m_allocated_actions.push_back(construct_scoped<T>(m_state, std::forward<Args>(args)...));
-            return static_cast<T*>(m_allocated_actions.back().get());
-        }
+        ActionIndex resolve_statement_block(NodeIndex node);
+        ActionIndex resolve_variable_declaration(NodeIndex node);
+        ActionIndex resolve_return(NodeIndex node);
+
+        ActionIndex resolve_binary_op(NodeIndex node, ActionIndex left_operand, ActionIndex right_operand);
+        ActionIndex resolve_unary_op(NodeIndex node, ActionIndex operand);
+        ActionIndex resolve_constant(NodeIndex node);
+        ActionIndex resolve_variable_access(NodeIndex node);
     };
 }
 
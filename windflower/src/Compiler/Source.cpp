@@ -0,0 +1,37 @@
+#include "Source.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace wf
+{
+    std::uint32_t Source::get_line(SourceOffset offset) const
+    {
+        return static_cast<std::uint32_t>(find_line(offset) + 1);
+    }
+
+    SourcePosition Source::get_position(SourceOffset offset) const
+    {
+        const std::size_t line = find_line(offset);
+        return { m_name, static_cast<std::uint32_t>(line + 1), offset - m_line_starts[line] + 1 };
+    }
+
+    std::size_t Source::find_line(SourceOffset offset) const
+    {
+        if(m_line_starts.empty())
+        {
+            m_line_starts.push_back(0);
+            const char* const begin = m_text.data();
+            const char* const end = begin + m_text.length();
+            for(const char* current = begin; current != end; current++)
+            {
+                current = static_cast<const char*>(std::memchr(current, '\n', static_cast<std::size_t>(end - current)));
+                if(current == nullptr) break;
+                m_line_starts.push_back(static_cast<SourceOffset>(current - begin + 1));
+            }
+        }
+
+        return static_cast<std::size_t>(std::upper_bound(m_line_starts.begin(), m_line_starts.end(), offset)
+            - m_line_starts.begin() - 1);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef WF_SOURCE_HPP
+#define WF_SOURCE_HPP
+
+#include <cstdint>
+#include <limits>
+#include <string_view>
+
+#include "Utils/Array.hpp"
+
+namespace wf
+{
+    // Byte offset into the source of a compilation. Tokens, nodes and actions only store this.
+    using SourceOffset = std::uint32_t;
+    // Marks code that does not originate from any source location.
+    constexpr SourceOffset NO_SOURCE_OFFSET = std::numeric_limits<SourceOffset>::max();
+
+    // Line and column of a source offset, both starting at 1.
+    struct SourcePosition
+    {
+        std::string_view source_name;
+        std::uint32_t line = 0;
+        std::uint32_t column = 0;
+    };
+
+    // Text of one compilation. Lines and columns are only needed for diagnostics and line info, so they are
+    // computed by binary search over an index of line starts that is built on first use.
+    class Source
+    {
+    public:
+        // Sources at least this large cannot be addressed with a SourceOffset.
+        static constexpr std::size_t MAX_LENGTH = NO_SOURCE_OFFSET;
+
+        Source(State* state, std::string_view name, std::string_view text)
+            : m_name(name), m_text(text), m_line_starts(state)
+        {
+        }
+
+        std::string_view get_name() const { return m_name; }
+        std::string_view get_text() const { return m_text; }
+        std::string_view get_text(SourceOffset offset, std::uint32_t length) const { return m_text.substr(offset, length); }
+
+        std::uint32_t get_line(SourceOffset offset) const;
+        SourcePosition get_position(SourceOffset offset) const;
+    private:
+        std::string_view m_name;
+        std::string_view m_text;
+        mutable DynamicArray<SourceOffset> m_line_starts;
+
+        // Returns the index of the line containing `offset`.
+        std::size_t find_line(SourceOffset offset) const;
+    };
+}
+
+#endif
\ No newline at end of file
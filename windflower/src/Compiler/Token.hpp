@@ -1,36 +1,15 @@
 #ifndef WF_TOKEN_HPP
 #define WF_TOKEN_HPP
 
-#include <unordered_map>
-#include <string_view>
-#include <limits>
+#include "Compiler/Source.hpp"
+#include "Windflower/Windflower.hpp"
 
 namespace wf
 {
-    struct SourcePosition
-    {
-        constexpr SourcePosition() = default;
-        constexpr SourcePosition(std::string_view source_name, std::uint32_t line, std::uint32_t column)
-            : source_name(source_name), line(line), column(column)
-        {
-        }
-
-        std::string_view source_name;
-        std::uint32_t line = 0;
-        std::uint32_t column = 0;
-
-        static consteval SourcePosition no_pos()
-        {
-            return { "", std::numeric_limits<std::uint32_t>::max(), std::numeric_limits<std::uint32_t>::max() };
-        }
-
-        constexpr bool operator==(const SourcePosition& other) const = default;
-    };
-
     class Token
     {
     public:
-        enum class Type
+        enum class Type : std::uint8_t
         {
             TT_EOF, ERROR, NEWLINE,
 
@@ -52,14 +31,35 @@ namespace wf
         {
         }
 
-        constexpr Token(Type type, const SourcePosition& position, std::string_view text) noexcept
-            : m_type(type), m_position(position), m_text(text)
+        constexpr Token(Type type, SourceOffset offset, std::uint32_t length) noexcept
+            : m_type(type), m_offset(offset), m_length(length)
         {
         }
 
+        constexpr Token(Type type, SourceOffset offset, std::uint32_t length, UInt int_value) noexcept
+            : m_type(type), m_offset(offset), m_length(length), m_int_value(int_value)
+        {
+        }
+
+        constexpr Token(Type type, SourceOffset offset, std::uint32_t length, Float float_value) noexcept
+            : m_type(type), m_offset(offset), m_length(length), m_float_value(float_value)
+        {
+        }
+
+        static constexpr Token make_error(SourceOffset offset, const char* message) noexcept
+        {
+            Token token(Type::ERROR, offset, 0);
+            token.m_error_message = message;
+            return token;
+        }
+
         constexpr Type get_type() const noexcept { return m_type; }
-        constexpr SourcePosition get_position() const noexcept { return m_position; }
-        constexpr std::string_view get_text() const noexcept { return m_text; }
+        constexpr SourceOffset get_offset() const noexcept { return m_offset; }
+        constexpr std::uint32_t get_length() const noexcept { return m_length; }
+        // Value of an INT_CONSTANT or FLOAT_CONSTANT token, parsed by the tokenizer.
+        constexpr UInt get_int_value() const noexcept { return m_int_value; }
+        constexpr Float get_float_value() const noexcept { return m_float_value; }
+        constexpr const char* get_error_message() const noexcept { return m_error_message; }
 
         constexpr bool is_keyword() const noexcept
         {
@@ -69,8 +69,14 @@ namespace wf
         }
     private:
         Type m_type;
-        SourcePosition m_position;
-        std::string_view m_text;
+        SourceOffset m_offset = 0;
+        std::uint32_t m_length = 0;
+        union
+        {
+            UInt m_int_value = 0;
+            Float m_float_value;
+            const char* m_error_message;
+        };
     };
 }
 
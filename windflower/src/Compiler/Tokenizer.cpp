@@ -1,135 +1,208 @@
 #include "Tokenizer.hpp"
 #include "Utils/Array.hpp"
 
-#include <cctype>
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define WF_TOKENIZER_SSE2
+    #include <emmintrin.h>
+#endif
 
 namespace wf
 {
-    static auto keyword_to_string = arr_from_designators<std::string_view, static_cast<std::size_t>(Token::Type::TT_COUNT), Token::Type>({
-        // While not technically a keyword, its easier to tokenize if we assume its one.
-        { Token::Type::UNDERSCORE,  "_"      },
-
-        { Token::Type::KW_VOID,     "Void"      },
-        { Token::Type::KW_INT,      "Int"       },
-        { Token::Type::KW_FLOAT,    "Float"     },
+    namespace
+    {
+        enum CharClass : std::uint8_t
+        {
+            CHAR_DIGIT = 1 << 0,
+            CHAR_IDENTIFIER_START = 1 << 1,
+            CHAR_IDENTIFIER = 1 << 2,
+            // Whitespace other than newlines.
+            CHAR_BLANK = 1 << 3,
+        };
 
-        { Token::Type::KW_VAR,      "var"       },
-        { Token::Type::KW_EXTERN,   "extern"    },
+        // Unlike <cctype>, the classification does not depend on the current locale.
+        constexpr StaticArray<std::uint8_t, 256> CHAR_CLASSES = []()
+        {
+            StaticArray<std::uint8_t, 256> classes{};
+            for(int c = '0'; c <= '9'; c++) classes[c] = CHAR_DIGIT | CHAR_IDENTIFIER;
+            for(int c = 'a'; c <= 'z'; c++) classes[c] = CHAR_IDENTIFIER_START | CHAR_IDENTIFIER;
+            for(int c = 'A'; c <= 'Z'; c++) classes[c] = CHAR_IDENTIFIER_START | CHAR_IDENTIFIER;
+            classes['_'] = CHAR_IDENTIFIER_START | CHAR_IDENTIFIER;
+            for(char c : { ' ', '\t', '\v', '\f', '\r' }) classes[static_cast<unsigned char>(c)] = CHAR_BLANK;
+            return classes;
+        }();
 
-        { Token::Type::KW_RETURN,   "return"    },
-    });
+        constexpr bool is_class(char c, std::uint8_t char_class)
+        {
+            return (CHAR_CLASSES[static_cast<unsigned char>(c)] & char_class) != 0;
+        }
 
-    Tokenizer::Tokenizer(std::string_view name, std::string_view source)
-        : m_begin(source.data()), m_end(source.data() + source.length()), m_current(m_begin),
-            m_position(name, 1, 1)
-    {
-    }
+#ifdef WF_TOKENIZER_SSE2
+        // Lanes of `chunk` holding a byte in [low, high]. Biasing by -128 lets the signed compare act as an
+        // unsigned range check.
+        __m128i in_range(__m128i chunk, char low, char high)
+        {
+            const __m128i biased = _mm_add_epi8(chunk, _mm_set1_epi8(static_cast<char>(-128 - low)));
+            return _mm_cmplt_epi8(biased, _mm_set1_epi8(static_cast<char>(-128 + (high - low) + 1)));
+        }
 
-    Token Tokenizer::next()
-    {
-        skip_whitespace();
-        m_begin = m_current;
-        if(is_finished()) return make_token(m_position, Token::Type::TT_EOF);
+        __m128i match_chunk(__m128i chunk, std::uint8_t char_class)
+        {
+            switch(char_class)
+            {
+                case CHAR_DIGIT:
+                    return in_range(chunk, '0', '9');
+                case CHAR_IDENTIFIER:
+                    return _mm_or_si128(
+                        _mm_or_si128(in_range(_mm_or_si128(chunk, _mm_set1_epi8(0x20)), 'a', 'z'), in_range(chunk, '0', '9')),
+                        _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'))
+                    );
+                default:
+                    return _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+                        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), in_range(chunk, '\v', '\f'))
+                    );
+            }
+        }
+#endif
 
-        SourcePosition start_position = m_position;
+        // Returns the first character at or after `current` that is not in `char_class`. Runs are classified
+        // 16 bytes at a time where SSE2 is available.
+        template<std::uint8_t CharClass>
+        const char* skip_class(const char* current, const char* end)
+        {
+#ifdef WF_TOKENIZER_SSE2
+            while(end - current >= 16)
+            {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+                const unsigned mismatches = ~static_cast<unsigned>(_mm_movemask_epi8(match_chunk(chunk, CharClass))) & 0xFFFF;
+                if(mismatches != 0) return current + std::countr_zero(mismatches);
+                current += 16;
+            }
+#endif
+            while(current != end && is_class(*current, CharClass)) current++;
+            return current;
+        }
 
-        if(std::isdigit(peek()))
+        struct KeywordEntry
         {
-            while(std::isdigit(peek())) advance();
-            if(peek() != '.') return make_token(start_position, Token::Type::INT_CONSTANT);
-            advance();
+            std::string_view text;
+            Token::Type type = Token::Type::IDENTIFIER;
+        };
+
+        constexpr std::size_t KEYWORD_TABLE_SIZE = 16;
 
-            while(std::isdigit(peek())) advance();
-            return make_token(start_position, Token::Type::FLOAT_CONSTANT);
+        constexpr std::size_t hash_keyword(std::string_view text)
+        {
+            return (static_cast<unsigned char>(text.front()) + static_cast<unsigned char>(text.back()) * 3
+                + text.length()) & (KEYWORD_TABLE_SIZE - 1);
         }
 
-        if(std::isalpha(peek()) || peek() == '_')
+        // Perfect hash table of the keywords. A collision fails to compile.
+        constexpr StaticArray<KeywordEntry, KEYWORD_TABLE_SIZE> KEYWORDS = []()
         {
-            switch(peek())
+            const KeywordEntry keywords[] = {
+                // While not technically a keyword, its easier to tokenize if we assume its one.
+                { "_",          Token::Type::UNDERSCORE     },
+
+                { "Void",       Token::Type::KW_VOID        },
+                { "Int",        Token::Type::KW_INT         },
+                { "Float",      Token::Type::KW_FLOAT       },
+
+                { "var",        Token::Type::KW_VAR         },
+                { "extern",     Token::Type::KW_EXTERN      },
+
+                { "return",     Token::Type::KW_RETURN      },
+            };
+
+            StaticArray<KeywordEntry, KEYWORD_TABLE_SIZE> table{};
+            for(const KeywordEntry& keyword : keywords)
             {
-                case '_': return finish_keyword(start_position, Token::Type::UNDERSCORE);
-                case 'e': return finish_keyword(start_position, Token::Type::KW_EXTERN);
-                case 'F': return finish_keyword(start_position, Token::Type::KW_FLOAT);
-                case 'I': return finish_keyword(start_position, Token::Type::KW_INT);
-                case 'r': return finish_keyword(start_position, Token::Type::KW_RETURN);
-                case 'v':
-                    advance();
-                    switch(peek())
-                    {
-                        case 'a': return finish_keyword(start_position, Token::Type::KW_VAR);
-                        case 'o': return finish_keyword(start_position, Token::Type::KW_VOID);
-                        default:
-                            break;
-                    }
-                default:
-                    break;
+                KeywordEntry& slot = table[hash_keyword(keyword.text)];
+                if(slot.type != Token::Type::IDENTIFIER) throw "Keyword hash collision.";
+                slot = keyword;
             }
+            return table;
+        }();
 
-            while(std::isalpha(peek()) || std::isdigit(peek()) || peek() == '_') advance();
-            return make_token(start_position, Token::Type::IDENTIFIER);
+        constexpr Token::Type find_keyword(std::string_view text)
+        {
+            const KeywordEntry& entry = KEYWORDS[hash_keyword(text)];
+            return entry.text == text? entry.type : Token::Type::IDENTIFIER;
         }
+    }
+
+    Tokenizer::Tokenizer(std::string_view source)
+        : m_source(source.data()), m_begin(source.data()), m_end(source.data() + source.length()), m_current(m_begin)
+    {
+    }
+
+    Token Tokenizer::next()
+    {
+        skip_whitespace();
+        m_begin = m_current;
+        if(is_finished()) return make_token(Token::Type::TT_EOF);
+
+        if(is_class(peek(), CHAR_DIGIT)) return make_number();
+        if(is_class(peek(), CHAR_IDENTIFIER_START)) return make_identifier();
 
         switch(peek())
         {
             case '\n':
                 advance();
-                return make_token(start_position, Token::Type::NEWLINE);
+                return make_token(Token::Type::NEWLINE);
             case '+':
                 advance();
-                return make_token(start_position, Token::Type::PLUS);
+                return make_token(Token::Type::PLUS);
             case '-':
                 advance();
                 if(peek() == '>')
                 {
                     advance();
-                    return make_token(start_position, Token::Type::ARROW);
+                    return make_token(Token::Type::ARROW);
                 }
-                return make_token(start_position, Token::Type::MINUS);
+                return make_token(Token::Type::MINUS);
             case '*':
                 advance();
-                return make_token(start_position, Token::Type::STAR);
+                return make_token(Token::Type::STAR);
             case '/':
                 advance();
-                return make_token(start_position, Token::Type::SLASH);
+                return make_token(Token::Type::SLASH);
             case '%':
                 advance();
-                return make_token(start_position, Token::Type::PERCENT);
+                return make_token(Token::Type::PERCENT);
             case '(':
                 advance();
-                return make_token(start_position, Token::Type::LEFT_PAREN);
+                return make_token(Token::Type::LEFT_PAREN);
             case ')':
                 advance();
-                return make_token(start_position, Token::Type::RIGHT_PAREN);
+                return make_token(Token::Type::RIGHT_PAREN);
             case ',':
                 advance();
-                return make_token(start_position, Token::Type::COMMA);
+                return make_token(Token::Type::COMMA);
             case ':':
                 advance();
                 if(peek() == '=')
                 {
                     advance();
-                    return make_token(start_position, Token::Type::COLON_EQUALS);
+                    return make_token(Token::Type::COLON_EQUALS);
                 }
 
-                return make_token(start_position, Token::Type::COLON);
+                return make_token(Token::Type::COLON);
             default:
                 break;
         }
 
         advance();
-        return Token(Token::Type::ERROR, start_position, "Unknown character.");
+        return make_error("Unknown character.");
     }
 
     void Tokenizer::advance()
     {
         if(is_finished()) return;
-
-        m_position.column++;
-        if(peek() == '\n')
-        {
-            m_position.line++;
-            m_position.column = 1;
-        }
         m_current++;
     }
 
@@ -146,35 +219,43 @@ namespace wf
         return m_current[1];
     }
 
-    Token Tokenizer::make_token(SourcePosition position, Token::Type type)
+    Token Tokenizer::make_token(Token::Type type)
     {
-        return Token(type, position, { m_begin, static_cast<std::size_t>(m_current - m_begin) });
+        return Token(type, get_start_offset(), get_length());
     }
 
-    Token Tokenizer::finish_keyword(SourcePosition position, Token::Type type)
+    Token Tokenizer::make_error(const char* message)
     {
-        const std::string_view keyword_text = keyword_to_string[static_cast<std::size_t>(type)];
-
-        bool is_keyword = true;
-        std::size_t i = 0;
+        return Token::make_error(get_start_offset(), message);
+    }
 
-        while(std::isalpha(peek()) || std::isdigit(peek()) || peek() == '_')
+    Token Tokenizer::make_number()
+    {
+        m_current = skip_class<CHAR_DIGIT>(m_current, m_end);
+        if(peek() != '.')
         {
-            if(i < keyword_text.length() && is_keyword && peek() != keyword_text[i])
+            UInt value;
+            if(std::from_chars(m_begin, m_current, value).ec != std::errc())
             {
-                is_keyword = false;
+                return make_error("Integer constant is too large.");
             }
-
-            advance();
-            i++;
+            return Token(Token::Type::INT_CONSTANT, get_start_offset(), get_length(), value);
         }
+        advance();
+        m_current = skip_class<CHAR_DIGIT>(m_current, m_end);
 
-        if(i != keyword_text.length())
+        Float value;
+        if(std::from_chars(m_begin, m_current, value).ec != std::errc())
         {
-            is_keyword = false;
+            return make_error("Float constant is too large.");
         }
+        return Token(Token::Type::FLOAT_CONSTANT, get_start_offset(), get_length(), value);
+    }
 
-        return make_token(position, is_keyword? type : Token::Type::IDENTIFIER);
+    Token Tokenizer::make_identifier()
+    {
+        m_current = skip_class<CHAR_IDENTIFIER>(m_current, m_end);
+        return make_token(find_keyword({ m_begin, static_cast<std::size_t>(m_current - m_begin) }));
     }
 
     bool Tokenizer::is_finished()
@@ -191,21 +272,21 @@ namespace wf
                 case '-':
                     if(peek_next() == '-')
                     {
-                        while(!is_finished() && peek() != '\n')
-                        {
-                            advance();
-                        }
+                        const void* newline = std::memchr(m_current, '\n', static_cast<std::size_t>(m_end - m_current));
+                        m_current = newline != nullptr? static_cast<const char*>(newline) : m_end;
                         break;
                     }
                     return;
                 case '\n':
                     if(!m_newline_ignore) return;
+                    advance();
+                    break;
                 case ' ':
                 case '\t':
                 case '\v':
                 case '\f':
                 case '\r':
-                    advance();
+                    m_current = skip_class<CHAR_BLANK>(m_current, m_end);
                     break;
                 default:
                     return;
@@ -8,25 +8,29 @@ namespace wf
     class Tokenizer
     {
     public:
-        Tokenizer(std::string_view name, std::string_view source);
+        explicit Tokenizer(std::string_view source);
 
         Token next();
         void set_newline_ignore(bool value) { m_newline_ignore = value; }
     private:
-        bool m_newline_ignore;
+        bool m_newline_ignore = false;
 
+        const char* const m_source;
         const char* m_begin;
         const char* m_end;
         const char* m_current;
 
-        SourcePosition m_position;
-
         void advance();
         char peek();
         char peek_next();
 
-        Token make_token(SourcePosition position, Token::Type type);
-        Token finish_keyword(SourcePosition position, Token::Type type);
+        SourceOffset get_start_offset() const { return static_cast<SourceOffset>(m_begin - m_source); }
+        std::uint32_t get_length() const { return static_cast<std::uint32_t>(m_current - m_begin); }
+
+        Token make_token(Token::Type type);
+        Token make_error(const char* message);
+        Token make_number();
+        Token make_identifier();
 
         bool is_finished();
         void skip_whitespace();
@@ -1,21 +1,29 @@
 #include "State.hpp"
 
+#include <cassert>
+
 #include "Utils/Format.hpp"
+#include "Vm/Aot.hpp"
 #include "Vm/Bytecode.hpp"
+#include "Vm/BytecodeFile.hpp"
+#include "Vm/Module.hpp"
+#include "Vm/Peephole.hpp"
 #include "Vm/Object.hpp"
 #include "Utils/Allocate.hpp"
 
 #include "Compiler/Parser.hpp"
 #include "Compiler/Resolver.hpp"
 #include "Compiler/CodeGen.hpp"
+#include "Compiler/Ir/IrOptimizer.hpp"
 
 namespace wf
 {
     State::State(const EnvironmentCreateInfo& create_info)
-        : allocator(*create_info.allocator), interned_strings(this), vm(this)
+        : allocator(*create_info.allocator), jit_enabled(create_info.enable_jit && is_jit_supported()),
+            interned_strings(this), vm(this)
     {
         // Global frame
-        stack.push_frame(nullptr, 0, 0);
+        stack.push_frame(nullptr, nullptr, 0);
     }
 
     State::~State()
@@ -61,7 +69,10 @@ namespace wf
 
     void Environment::reserve(std::size_t count)
     {
-        m_state->stack.reserve(count);
+        if(!m_state->stack.reserve(count))
+        {
+            throw VmError(String("Stack overflow.", m_state));
+        }
     }
 
     void Environment::release(std::size_t count)
@@ -76,29 +87,95 @@ namespace wf
 
     bool Environment::compile(std::size_t idx, const CompileInfo& compile_info)
     {
-        BytecodeObject* result_code = construct_ptr<BytecodeObject>(m_state, m_state);
-        m_state->stack.index(idx) = result_code;
-        Parser parser(m_state, compile_info);
-        Resolver resolver(m_state);
-        CodeGen code_gen(m_state, result_code);
+        if(compile_info.source.length() >= Source::MAX_LENGTH)
+        {
+            m_state->stack.index(idx) = StringObject::from_text(m_state, "Source is too large.");
+            return false;
+        }
 
-        Node* ast = parser.parse();
-        if(ast == nullptr)
+        const Source source(m_state, compile_info.name, compile_info.source);
+        Ast ast(m_state);
+        ActionTree actions(m_state);
+        BytecodeBuilder builder(m_state);
+        Parser parser(m_state, source, &ast);
+        Resolver resolver(m_state, source, &ast, &actions);
+        CodeGen code_gen(m_state, source, &builder, compile_info.fast_math);
+
+        NodeIndex root = parser.parse();
+        if(root == NO_NODE)
         {
             m_state->stack.index(idx) = StringObject::from_text(m_state, parser.get_error_message());
             return false;
         }
 
-        Action* action_tree = resolver.resolve_ast(ast);
+        ActionIndex action_tree = resolver.resolve_ast(root);
 
-        if(action_tree == nullptr)
+        if(action_tree == NO_ACTION)
         {
             m_state->stack.index(idx) = StringObject::from_text(m_state, resolver.get_error_message());
             return false;
         }
 
-        code_gen.generate(action_tree);
+        bool generated;
+        if(compile_info.optimization_level > 0)
+        {
+            ActionTree optimized_actions(m_state);
+            generated = code_gen.generate(optimized_actions,
+                optimize_actions(m_state, actions, action_tree, &optimized_actions));
+            if(generated)
+            {
+                PeepholeOptimizer optimizer(m_state, &builder, get_peephole_rules());
+                const std::size_t code_size = builder.code.size();
+                optimizer.run();
+                PeepholeProfile::get().record(optimizer.get_hit_counts(), code_size, builder.code.size());
+            }
+        }
+        else
+        {
+            generated = code_gen.generate(actions, action_tree);
+        }
 
+        if(!generated)
+        {
+            m_state->stack.index(idx) = StringObject::from_text(m_state, code_gen.get_error_message());
+            return false;
+        }
+
+        const CompiledModule module(freeze_bytecode(m_state, builder));
+        m_state->stack.index(idx) = construct_ptr<BytecodeObject>(m_state, m_state, module);
+        return true;
+    }
+
+    CompiledModule Environment::get_compiled_module(std::size_t idx)
+    {
+        return m_state->stack.index(idx).as_bytecode()->module;
+    }
+
+    void Environment::load_module(std::size_t idx, const CompiledModule& module)
+    {
+        assert(!module.is_empty());
+        m_state->stack.index(idx) = construct_ptr<BytecodeObject>(m_state, m_state, module);
+    }
+
+    void Environment::emit_bytecode(std::size_t return_idx, std::size_t idx)
+    {
+        String result(m_state);
+        write_bytecode_file(m_state->stack.index(idx).as_bytecode(), result);
+        m_state->stack.index(return_idx) = StringObject::from_text(m_state, result);
+    }
+
+    bool Environment::load_bytecode(std::size_t idx, std::span<const std::byte> bytecode)
+    {
+        String error(m_state);
+        ModuleData* module_data = load_bytecode_file(m_state, bytecode, error);
+        if(module_data == nullptr)
+        {
+            m_state->stack.index(idx) = StringObject::from_text(m_state, error);
+            return false;
+        }
+
+        const CompiledModule module(module_data);
+        m_state->stack.index(idx) = construct_ptr<BytecodeObject>(m_state, m_state, module);
         return true;
     }
 
@@ -108,6 +185,15 @@ namespace wf
                 disassemble_bytecode_object( m_state, m_state->stack.index(idx).as_bytecode() ));
     }
 
+    bool Environment::transpile_bytecode(std::size_t return_idx, std::size_t idx, std::string_view function_name)
+    {
+        String result(m_state);
+        const bool success = transpile_bytecode_object(m_state, m_state->stack.index(idx).as_bytecode(),
+                function_name, result);
+        m_state->stack.index(return_idx) = StringObject::from_text(m_state, result);
+        return success;
+    }
+
     TypeId Environment::get_bytecode_return_type(std::size_t idx)
     {
         return m_state->stack.index(idx).as_bytecode()->return_type;
@@ -123,6 +209,16 @@ namespace wf
         m_state->vm.call(idx, 0);
     }
 
+    void Environment::call_batch(std::size_t idx, Int* output_column, std::size_t n)
+    {
+        m_state->vm.call_batch(idx, output_column, n);
+    }
+
+    void Environment::call_batch(std::size_t idx, Float* output_column, std::size_t n)
+    {
+        m_state->vm.call_batch(idx, output_column, n);
+    }
+
     void Environment::store_int(std::size_t idx, Int value)
     {
         m_state->stack.index(idx).as_int = static_cast<UInt>(value);
@@ -39,6 +39,7 @@ namespace wf
         ~State();
         Allocator& allocator;
         Object* allocated_objects = nullptr;
+        const bool jit_enabled;
 
         HashSet<StringObject*, std::hash<StringObject*>, InternTableEquality> interned_strings;
 
@@ -0,0 +1,61 @@
+#ifndef WF_INT_RANGE_HPP
+#define WF_INT_RANGE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+namespace wf
+{
+    // Inclusive bounds of the values an int expression can take, compared as unsigned values like the VM divides
+    // them. Results that may wrap around cover every value. The compiler proves divisors non-zero with these
+    // rules and the bytecode verifier checks its proofs with the same ones.
+    struct IntRange
+    {
+        std::uint64_t min = 0;
+        std::uint64_t max = std::numeric_limits<std::uint64_t>::max();
+
+        bool excludes_zero() const { return min > 0; }
+    };
+
+    constexpr IntRange negate_range(IntRange operand)
+    {
+        // Negation maps [min, max] to [-max, -min] as long as the range does not wrap around 0.
+        if(operand.min == 0) return operand.max == 0? operand : IntRange();
+        return { 0 - operand.max, 0 - operand.min };
+    }
+
+    constexpr IntRange add_ranges(IntRange lhs, IntRange rhs)
+    {
+        if(lhs.max > std::numeric_limits<std::uint64_t>::max() - rhs.max) return {};
+        return { lhs.min + rhs.min, lhs.max + rhs.max };
+    }
+
+    constexpr IntRange subtract_ranges(IntRange lhs, IntRange rhs)
+    {
+        if(lhs.min < rhs.max) return {};
+        return { lhs.min - rhs.max, lhs.max - rhs.min };
+    }
+
+    constexpr IntRange multiply_ranges(IntRange lhs, IntRange rhs)
+    {
+        if(rhs.max != 0 && lhs.max > std::numeric_limits<std::uint64_t>::max() / rhs.max) return {};
+        return { lhs.min * rhs.min, lhs.max * rhs.max };
+    }
+
+    // Dividing by 0 stops the program, so the divisor of a result that exists is at least 1.
+    constexpr IntRange divide_ranges(IntRange lhs, IntRange rhs)
+    {
+        if(rhs.max == 0) return {};
+        return { lhs.min / rhs.max, lhs.max / std::max<std::uint64_t>(rhs.min, 1) };
+    }
+
+    constexpr IntRange modulo_ranges(IntRange lhs, IntRange rhs)
+    {
+        if(rhs.max == 0) return {};
+        if(lhs.max < std::max<std::uint64_t>(rhs.min, 1)) return lhs;
+        return { 0, std::min(lhs.max, rhs.max - 1) };
+    }
+}
+
+#endif
\ No newline at end of file
@@ -1,9 +1,14 @@
 #ifndef WF_NUMERIC_HPP
 #define WF_NUMERIC_HPP
 
+#include <bit>
 #include <cstdint>
 #include <concepts>
 
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+#endif
+
 namespace wf
 {
     template<typename T> requires std::integral<T>
@@ -12,6 +17,50 @@ namespace wf
         return (static_cast<T>(1) << ones_count) - static_cast<T>(1);
     }
 
+    // High 64 bits of the 128-bit product.
+    inline std::uint64_t multiply_high(std::uint64_t lhs, std::uint64_t rhs)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        return __umulh(lhs, rhs);
+#else
+        return static_cast<std::uint64_t>((static_cast<unsigned __int128>(lhs) * rhs) >> 64);
+#endif
+    }
+
+    // Unsigned division by a constant divisor of at least 2 as a multiplication, following Granlund and
+    // Montgomery, "Division by Invariant Integers using Multiplication". The magic number is
+    // floor(2^64 * (2^l - divisor) / divisor) + 1 with l = ceil(log2(divisor)).
+    constexpr std::uint32_t get_division_magic_shift(std::uint64_t divisor)
+    {
+        return 63 - static_cast<std::uint32_t>(std::countl_zero(divisor - 1));
+    }
+
+    constexpr std::uint64_t get_division_magic(std::uint64_t divisor)
+    {
+        // 2^l - divisor is below the divisor, so the quotient fits and a bitwise long division computes it.
+        const std::uint32_t l = get_division_magic_shift(divisor) + 1;
+        std::uint64_t remainder = l == 64? 0 - divisor : (std::uint64_t(1) << l) - divisor;
+        std::uint64_t quotient = 0;
+        for(std::uint32_t i = 0; i < 64; i++)
+        {
+            const bool carry = (remainder >> 63) != 0;
+            remainder <<= 1;
+            quotient <<= 1;
+            if(carry || remainder >= divisor)
+            {
+                remainder -= divisor;
+                quotient |= 1;
+            }
+        }
+        return quotient + 1;
+    }
+
+    inline std::uint64_t divide_by_magic(std::uint64_t dividend, std::uint64_t magic, std::uint32_t shift)
+    {
+        const std::uint64_t high = multiply_high(dividend, magic);
+        return (high + ((dividend - high) >> 1)) >> shift;
+    }
+
     template<typename T> requires(std::is_enum_v<T>)
     constexpr std::underlying_type_t<T> to_underlying(const T& value)
     {
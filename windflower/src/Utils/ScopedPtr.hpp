@@ -47,7 +47,7 @@ namespace wf
     template<typename T, typename... Args>
     ScopedPtr<T> construct_scoped(State* state, Args&&... args)
     {
-        return ScopedPtr<T>(new T(std::forward<Args>(args)...), state);
+        return ScopedPtr<T>(construct_ptr<T>(state, std::forward<Args>(args)...), state);
     }
 }
 
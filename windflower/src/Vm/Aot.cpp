@@ -0,0 +1,559 @@
+#include "Aot.hpp"
+
+#include <bit>
+
+#include "Utils/Format.hpp"
+
+namespace wf
+{
+    AotRegistration* AotRegistration::s_first_registration = nullptr;
+
+    AotRegistration::AotRegistration(const AotBytecode& bytecode, AotFunc function)
+        : m_bytecode(bytecode), m_function(function), m_next(s_first_registration)
+    {
+        s_first_registration = this;
+    }
+
+    AotFunc AotRegistration::find(const BytecodeObject* code)
+    {
+        const std::uint64_t fingerprint = bytecode_fingerprint(code);
+        for(const AotRegistration* registration = s_first_registration; registration != nullptr;
+            registration = registration->m_next)
+        {
+            if(registration->m_bytecode.fingerprint == fingerprint && registration->matches(code))
+            {
+                return registration->m_function;
+            }
+        }
+        return nullptr;
+    }
+
+    bool AotRegistration::matches(const BytecodeObject* code) const
+    {
+        if(m_bytecode.return_type != static_cast<std::uint32_t>(code->return_type)
+            || m_bytecode.code.size() != code->code.size() || m_bytecode.constants.size() != code->constants.size()
+            || m_bytecode.constant_types.size() != code->constants.size())
+        {
+            return false;
+        }
+
+        for(std::size_t i = 0; i < code->code.size(); i++)
+        {
+            if(m_bytecode.code[i] != std::bit_cast<std::uint32_t>(code->code[i])) return false;
+        }
+
+        for(std::size_t i = 0; i < code->constants.size(); i++)
+        {
+            if(m_bytecode.constant_types[i] != static_cast<std::uint8_t>(code->constant_type_infos[i])
+                || m_bytecode.constants[i] != code->constants[i].as_int)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void hash_u64(std::uint64_t& hash, std::uint64_t value)
+    {
+        // FNV-1a
+        for(std::uint32_t i = 0; i < 8; i++)
+        {
+            hash ^= (value >> (i * 8)) & 0xFF;
+            hash *= 0x100000001B3;
+        }
+    }
+
+    std::uint64_t bytecode_fingerprint(const BytecodeObject* code)
+    {
+        std::uint64_t hash = 0xCBF29CE484222325;
+
+        hash_u64(hash, static_cast<std::uint64_t>(code->return_type));
+        hash_u64(hash, code->code.size());
+        for(const Instruction& instruction : code->code)
+        {
+            hash_u64(hash, std::bit_cast<std::uint32_t>(instruction));
+        }
+
+        hash_u64(hash, code->constants.size());
+        for(std::size_t i = 0; i < code->constants.size(); i++)
+        {
+            hash_u64(hash, static_cast<std::uint64_t>(code->constant_type_infos[i]));
+            hash_u64(hash, code->constants[i].as_int);
+        }
+
+        return hash;
+    }
+
+    // Registers hold an Int or a Float depending on the last instruction that wrote them. The generated
+    // function declares one local per register and type, named iN and fN.
+    class CppTranspiler
+    {
+    public:
+        CppTranspiler(State* const state, const BytecodeObject* code, std::string_view function_name)
+            : m_state(state), m_code(code), m_function_name(function_name),
+              m_register_types(state), m_used_int_registers(state), m_used_float_registers(state),
+              m_body(state)
+        {
+        }
+
+        bool transpile(String& result)
+        {
+            for(std::size_t i = 0; i < m_code->constants.size(); i++)
+            {
+                if(m_code->constant_type_infos[i] == ConstantType::STRING)
+                {
+                    result = format(m_state, "String constants are not supported.");
+                    return false;
+                }
+            }
+
+            // Every entry of the line table changes the line.
+            LineTableReader line_reader(m_code->line_table);
+            BytecodeLineInfo line_entry;
+            bool has_line_entry = line_reader.next(line_entry);
+            bool returned = false;
+            for(std::size_t i = 0; i < m_code->code.size() && !returned; i++)
+            {
+                for(; has_line_entry && line_entry.offset <= i; has_line_entry = line_reader.next(line_entry))
+                {
+                    format_to(m_body, "        // line {}\n", line_entry.line);
+                }
+
+                const WideInstruction instruction = WideInstruction::decode(m_code->code, i);
+                if(!transpile_instruction(instruction, i + 1, returned))
+                {
+                    result = format(m_state, "Instruction at offset {} is not supported.", i);
+                    return false;
+                }
+            }
+
+            if(!returned)
+            {
+                format_to(m_body, "        return 0;\n");
+            }
+
+            write_translation_unit(result);
+            return true;
+        }
+    private:
+        enum class RegisterType
+        {
+            UNKNOWN, INT, FLOAT,
+        };
+
+        State* const m_state;
+        const BytecodeObject* const m_code;
+        const std::string_view m_function_name;
+
+        DynamicArray<RegisterType> m_register_types;
+        DynamicArray<bool> m_used_int_registers;
+        DynamicArray<bool> m_used_float_registers;
+        String m_body;
+
+        void grow_registers(std::uint32_t index)
+        {
+            if(index < m_register_types.size()) return;
+
+            m_register_types.resize(index + 1, RegisterType::UNKNOWN);
+            m_used_int_registers.resize(index + 1, false);
+            m_used_float_registers.resize(index + 1, false);
+        }
+
+        String int_register(std::uint32_t index)
+        {
+            grow_registers(index);
+            m_used_int_registers[index] = true;
+            return format(m_state, "i{}", index);
+        }
+
+        String float_register(std::uint32_t index)
+        {
+            grow_registers(index);
+            m_used_float_registers[index] = true;
+            return format(m_state, "f{}", index);
+        }
+
+        // A register read as Int that was last written as a Float keeps its bits, as in the interpreter.
+        String read_int(std::uint32_t index)
+        {
+            grow_registers(index);
+            if(m_register_types[index] == RegisterType::FLOAT)
+            {
+                return format(m_state, "std::bit_cast<wf::UInt>({})", float_register(index));
+            }
+            return int_register(index);
+        }
+
+        String read_float(std::uint32_t index)
+        {
+            grow_registers(index);
+            if(m_register_types[index] == RegisterType::INT)
+            {
+                return format(m_state, "std::bit_cast<wf::Float>({})", int_register(index));
+            }
+            return float_register(index);
+        }
+
+        String write_int(std::uint32_t index)
+        {
+            grow_registers(index);
+            m_register_types[index] = RegisterType::INT;
+            return int_register(index);
+        }
+
+        String write_float(std::uint32_t index)
+        {
+            grow_registers(index);
+            m_register_types[index] = RegisterType::FLOAT;
+            return float_register(index);
+        }
+
+        String constant(std::uint32_t index)
+        {
+            return format(m_state, "k{}", index);
+        }
+
+        String immediate(std::int32_t value)
+        {
+            return format(m_state, "{}u", static_cast<UInt>(static_cast<Int>(value)));
+        }
+
+        void write_int_op(std::uint32_t destination, const String& left, std::string_view operation, const String& right)
+        {
+            // Operands are read before the destination changes type.
+            format_to(m_body, "        {2} = {0} {1} {3};\n", left, operation, write_int(destination), right);
+        }
+
+        void write_float_op(std::uint32_t destination, const String& left, std::string_view operation, const String& right)
+        {
+            format_to(m_body, "        {2} = {0} {1} {3};\n", left, operation, write_float(destination), right);
+        }
+
+        void write_int_division(std::uint32_t destination, const String& left, std::string_view operation,
+                const String& right, std::size_t next_offset)
+        {
+            format_to(m_body, "        if({} == 0) return {};\n", right, next_offset);
+            write_int_op(destination, left, operation, right);
+        }
+
+        void write_constant_int_division(std::uint32_t destination, const String& left, std::string_view operation,
+                std::uint32_t right, std::size_t next_offset, bool& returned)
+        {
+            if(m_code->constants[right].as_int == 0)
+            {
+                format_to(m_body, "        return {};\n", next_offset);
+                returned = true;
+                return;
+            }
+            write_int_op(destination, left, operation, constant(right));
+        }
+
+        void write_move(std::uint32_t destination, std::uint32_t source)
+        {
+            grow_registers(source);
+            if(m_register_types[source] == RegisterType::FLOAT)
+            {
+                const String value = read_float(source);
+                format_to(m_body, "        {} = {};\n", write_float(destination), value);
+            }
+            else
+            {
+                const String value = read_int(source);
+                format_to(m_body, "        {} = {};\n", write_int(destination), value);
+            }
+        }
+
+        void write_load_constant(std::uint32_t destination, std::uint32_t index)
+        {
+            const String destination_name = m_code->constant_type_infos[index] == ConstantType::FLOAT?
+                write_float(destination) : write_int(destination);
+            format_to(m_body, "        {} = {};\n", destination_name, constant(index));
+        }
+
+        void write_return_value(std::uint32_t source)
+        {
+            grow_registers(source);
+            if(m_register_types[source] == RegisterType::FLOAT)
+            {
+                format_to(m_body, "        *return_value = std::bit_cast<wf::UInt>({});\n", read_float(source));
+            }
+            else
+            {
+                format_to(m_body, "        *return_value = {};\n", read_int(source));
+            }
+            format_to(m_body, "        return 0;\n");
+        }
+
+        void write_return_constant(std::uint32_t index)
+        {
+            if(m_code->constant_type_infos[index] == ConstantType::FLOAT)
+            {
+                format_to(m_body, "        *return_value = std::bit_cast<wf::UInt>({});\n", constant(index));
+            }
+            else
+            {
+                format_to(m_body, "        *return_value = {};\n", constant(index));
+            }
+            format_to(m_body, "        return 0;\n");
+        }
+
+        bool transpile_instruction(const WideInstruction& instruction, std::size_t next_offset, bool& returned)
+        {
+            const std::uint32_t a = instruction.get_op_a();
+            const std::uint32_t b = instruction.get_op_b();
+            const std::uint32_t c = instruction.get_op_c();
+            const std::uint32_t d = instruction.get_op_d();
+
+            switch(instruction.get_opcode())
+            {
+                case Opcode::NO_OP:
+                case Opcode::WIDE:
+                case Opcode::RESERVE:
+                    break;
+                case Opcode::RETURN:
+                    format_to(m_body, "        return 0;\n");
+                    returned = true;
+                    break;
+                case Opcode::RETURN_VALUE:
+                    write_return_value(a);
+                    returned = true;
+                    break;
+                case Opcode::RETURN_CONSTANT:
+                    write_return_constant(d);
+                    returned = true;
+                    break;
+                case Opcode::MOVE:
+                    write_move(a, d);
+                    break;
+                case Opcode::LOAD_CONSTANT:
+                    write_load_constant(a, d);
+                    break;
+                case Opcode::NEGATION_INT:
+                    write_int_op(a, format(m_state, "0u"), "-", read_int(d));
+                    break;
+                case Opcode::NEGATION_FLOAT:
+                {
+                    const String operand = read_float(d);
+                    format_to(m_body, "        {} = -{};\n", write_float(a), operand);
+                    break;
+                }
+                case Opcode::INT_TO_FLOAT:
+                {
+                    const String operand = read_int(d);
+                    format_to(m_body, "        {} = static_cast<wf::Float>(static_cast<wf::Int>({}));\n",
+                        write_float(a), operand);
+                    break;
+                }
+                case Opcode::FLOAT_TO_INT:
+                {
+                    const String operand = read_float(d);
+                    format_to(m_body, "        {} = static_cast<wf::UInt>(static_cast<wf::Int>({}));\n",
+                        write_int(a), operand);
+                    break;
+                }
+                case Opcode::ADD_INT:
+                    write_int_op(a, read_int(b), "+", read_int(c));
+                    break;
+                case Opcode::SUBTRACT_INT:
+                    write_int_op(a, read_int(b), "-", read_int(c));
+                    break;
+                case Opcode::MULTIPLY_INT:
+                    write_int_op(a, read_int(b), "*", read_int(c));
+                    break;
+                case Opcode::DIVIDE_INT:
+                    write_int_division(a, read_int(b), "/", read_int(c), next_offset);
+                    break;
+                case Opcode::MODULO_INT:
+                    write_int_division(a, read_int(b), "%", read_int(c), next_offset);
+                    break;
+                case Opcode::ADD_FLOAT:
+                    write_float_op(a, read_float(b), "+", read_float(c));
+                    break;
+                case Opcode::SUBTRACT_FLOAT:
+                    write_float_op(a, read_float(b), "-", read_float(c));
+                    break;
+                case Opcode::MULTIPLY_FLOAT:
+                    write_float_op(a, read_float(b), "*", read_float(c));
+                    break;
+                case Opcode::DIVIDE_FLOAT:
+                    write_float_op(a, read_float(b), "/", read_float(c));
+                    break;
+                case Opcode::ADD_INT_RK:
+                    write_int_op(a, read_int(b), "+", constant(c));
+                    break;
+                case Opcode::SUBTRACT_INT_RK:
+                    write_int_op(a, read_int(b), "-", constant(c));
+                    break;
+                case Opcode::MULTIPLY_INT_RK:
+                    write_int_op(a, read_int(b), "*", constant(c));
+                    break;
+                case Opcode::DIVIDE_INT_RK:
+                    write_constant_int_division(a, read_int(b), "/", c, next_offset, returned);
+                    break;
+                case Opcode::MODULO_INT_RK:
+                    write_constant_int_division(a, read_int(b), "%", c, next_offset, returned);
+                    break;
+                case Opcode::ADD_FLOAT_RK:
+                    write_float_op(a, read_float(b), "+", constant(c));
+                    break;
+                case Opcode::SUBTRACT_FLOAT_RK:
+                    write_float_op(a, read_float(b), "-", constant(c));
+                    break;
+                case Opcode::MULTIPLY_FLOAT_RK:
+                    write_float_op(a, read_float(b), "*", constant(c));
+                    break;
+                case Opcode::DIVIDE_FLOAT_RK:
+                    write_float_op(a, read_float(b), "/", constant(c));
+                    break;
+                case Opcode::SUBTRACT_INT_KR:
+                    write_int_op(a, constant(b), "-", read_int(c));
+                    break;
+                case Opcode::DIVIDE_INT_KR:
+                    write_int_division(a, constant(b), "/", read_int(c), next_offset);
+                    break;
+                case Opcode::MODULO_INT_KR:
+                    write_int_division(a, constant(b), "%", read_int(c), next_offset);
+                    break;
+                case Opcode::SUBTRACT_FLOAT_KR:
+                    write_float_op(a, constant(b), "-", read_float(c));
+                    break;
+                case Opcode::DIVIDE_FLOAT_KR:
+                    write_float_op(a, constant(b), "/", read_float(c));
+                    break;
+                case Opcode::ADD_INT_RI:
+                    write_int_op(a, read_int(b), "+", immediate(instruction.get_op_sc()));
+                    break;
+                case Opcode::SUBTRACT_INT_RI:
+                    write_int_op(a, read_int(b), "-", immediate(instruction.get_op_sc()));
+                    break;
+                case Opcode::MULTIPLY_INT_RI:
+                    write_int_op(a, read_int(b), "*", immediate(instruction.get_op_sc()));
+                    break;
+                case Opcode::SHIFT_LEFT_INT_RI:
+                    write_int_op(a, read_int(b), "<<", immediate(static_cast<std::int32_t>(c & 63)));
+                    break;
+                case Opcode::SHIFT_RIGHT_INT_RI:
+                    write_int_op(a, read_int(b), ">>", immediate(static_cast<std::int32_t>(c & 63)));
+                    break;
+                case Opcode::AND_INT_RK:
+                    write_int_op(a, read_int(b), "&", constant(c));
+                    break;
+                // The divisor is a constant expression, so the C++ compiler picks the multiplication itself.
+                case Opcode::DIVIDE_INT_MAGIC:
+                    write_int_op(a, read_int(b), "/", constant(c));
+                    break;
+                case Opcode::MODULO_INT_MAGIC:
+                    write_int_op(a, read_int(b), "%", constant(c));
+                    break;
+                case Opcode::FMA_FLOAT:
+                {
+                    const String left = read_float(b);
+                    const String right = read_float(c);
+                    const String accumulator = read_float(a);
+                    format_to(m_body, "        {} = std::fma({}, {}, {});\n", write_float(a), left, right, accumulator);
+                    break;
+                }
+                case Opcode::DIVIDE_INT_NOCHECK:
+                    write_int_op(a, read_int(b), "/", read_int(c));
+                    break;
+                case Opcode::MODULO_INT_NOCHECK:
+                    write_int_op(a, read_int(b), "%", read_int(c));
+                    break;
+                default:
+                    return false;
+            }
+
+            return true;
+        }
+
+        void write_translation_unit(String& result)
+        {
+            result = format(m_state,
+                "// Generated by wfc, do not edit.\n"
+                "#include <Windflower/Windflower.hpp>\n"
+                "\n"
+                "#include <array>\n"
+                "#include <bit>\n"
+                "#include <cmath>\n"
+                "#include <cstdint>\n"
+                "\n"
+                "namespace\n"
+                "{{\n"
+            );
+
+            for(std::size_t i = 0; i < m_code->constants.size(); i++)
+            {
+                const Value& value = m_code->constants[i];
+                if(m_code->constant_type_infos[i] == ConstantType::FLOAT)
+                {
+                    format_to(result, "    constexpr wf::Float k{} = std::bit_cast<wf::Float>(UINT64_C({:#018x})); // {}\n",
+                        i, value.as_int, value.as_float);
+                }
+                else
+                {
+                    format_to(result, "    constexpr wf::UInt k{} = {}u;\n", i, value.as_int);
+                }
+            }
+
+            format_to(result, "\n    std::size_t {}(wf::UInt* return_value)\n    {{\n", m_function_name);
+            for(std::size_t i = 0; i < m_register_types.size(); i++)
+            {
+                if(m_used_int_registers[i]) format_to(result, "        [[maybe_unused]] wf::UInt i{} = 0;\n", i);
+                if(m_used_float_registers[i]) format_to(result, "        [[maybe_unused]] wf::Float f{} = 0;\n", i);
+            }
+            format_to(result, "        (void)return_value;\n\n");
+
+            result += m_body;
+            format_to(result, "    }}\n\n");
+
+            write_registration(result);
+            format_to(result, "}}\n");
+        }
+        // The registration carries the whole bytecode, so that only identical code runs the generated function.
+        void write_registration(String& result)
+        {
+            format_to(result, "    constexpr std::array<std::uint32_t, {}> {}_code = {{", m_code->code.size(),
+                m_function_name);
+            for(std::size_t i = 0; i < m_code->code.size(); i++)
+            {
+                format_to(result, "{}{:#010x}u,", i % 8 == 0? "\n        " : " ",
+                    std::bit_cast<std::uint32_t>(m_code->code[i]));
+            }
+            format_to(result, "\n    }};\n");
+
+            format_to(result, "    constexpr std::array<std::uint8_t, {}> {}_constant_types = {{",
+                m_code->constants.size(), m_function_name);
+            for(std::size_t i = 0; i < m_code->constants.size(); i++)
+            {
+                format_to(result, "{}{},", i % 16 == 0? "\n        " : " ",
+                    static_cast<std::uint32_t>(m_code->constant_type_infos[i]));
+            }
+            format_to(result, "\n    }};\n");
+
+            format_to(result, "    constexpr std::array<wf::UInt, {}> {}_constants = {{", m_code->constants.size(),
+                m_function_name);
+            for(std::size_t i = 0; i < m_code->constants.size(); i++)
+            {
+                format_to(result, "\n        UINT64_C({:#018x}),", m_code->constants[i].as_int);
+            }
+            format_to(result, "\n    }};\n\n");
+
+            format_to(result,
+                "    const wf::AotRegistration {0}_registration({{\n"
+                "        .fingerprint = UINT64_C({1:#018x}),\n"
+                "        .return_type = {2},\n"
+                "        .code = {0}_code,\n"
+                "        .constant_types = {0}_constant_types,\n"
+                "        .constants = {0}_constants\n"
+                "    }}, &{0});\n",
+                m_function_name, bytecode_fingerprint(m_code), static_cast<std::uint32_t>(m_code->return_type));
+        }
+    };
+
+    bool transpile_bytecode_object(State* const state, const BytecodeObject* code, std::string_view function_name,
+            String& result)
+    {
+        CppTranspiler transpiler(state, code, function_name);
+        return transpiler.transpile(result);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef WF_AOT_HPP
+#define WF_AOT_HPP
+
+#include "Object.hpp"
+#include "Utils/String.hpp"
+
+namespace wf
+{
+    // Hash of the bytecode a wfc generated function was produced from, checked before comparing it in full.
+    std::uint64_t bytecode_fingerprint(const BytecodeObject* code);
+
+    // Emits a C++ translation unit implementing `code` as `function_name`. Returns false and leaves a
+    // message in `result` if the bytecode cannot be translated.
+    bool transpile_bytecode_object(State* const state, const BytecodeObject* code, std::string_view function_name,
+            String& result);
+}
+
+#endif
\ No newline at end of file
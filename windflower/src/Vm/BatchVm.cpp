@@ -0,0 +1,344 @@
+#include "BatchVm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+// Kernels have no loop-carried dependencies even when the destination is one of the operands.
+#if defined(__clang__)
+    #define WF_BATCH_VECTORIZE _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+    #define WF_BATCH_VECTORIZE _Pragma("GCC ivdep")
+#else
+    #define WF_BATCH_VECTORIZE
+#endif
+
+namespace wf
+{
+    static_assert(sizeof(Value) == sizeof(UInt) && sizeof(Value) == sizeof(Float));
+
+    template<typename T>
+    static T get_scalar(const Value& value)
+    {
+        if constexpr(std::is_same_v<T, Float>) return value.as_float;
+        else return value.as_int;
+    }
+
+    template<typename T>
+    static void set_scalar(Value& value, T scalar)
+    {
+        if constexpr(std::is_same_v<T, Float>) value.as_float = scalar;
+        else value.as_int = scalar;
+    }
+
+    struct ColumnOperand
+    {
+        const Value* column;
+
+        template<typename T>
+        T get(std::size_t row) const { return get_scalar<T>(column[row]); }
+    };
+
+    // Operand that is the same for every row, a constant or an immediate.
+    struct BroadcastOperand
+    {
+        Value value;
+
+        template<typename T>
+        T get(std::size_t) const { return get_scalar<T>(value); }
+    };
+
+    // Kernels run over the whole block, rows past the ones in use only hold padding. They read and write
+    // the union members rather than copying Values, which keeps the loops vectorizable.
+    template<typename From, typename To, typename Operand, typename Operation>
+    static void unary_kernel(Value* destination, Operand operand, Operation operation)
+    {
+        WF_BATCH_VECTORIZE
+        for(std::size_t row = 0; row < BatchVm::BLOCK_SIZE; row++)
+        {
+            set_scalar<To>(destination[row], operation(operand.template get<From>(row)));
+        }
+    }
+
+    template<typename T, typename Left, typename Right, typename Operation>
+    static void binary_kernel(Value* destination, Left left, Right right, Operation operation)
+    {
+        WF_BATCH_VECTORIZE
+        for(std::size_t row = 0; row < BatchVm::BLOCK_SIZE; row++)
+        {
+            set_scalar<T>(destination[row], operation(left.template get<T>(row), right.template get<T>(row)));
+        }
+    }
+
+    // Integer division only runs over the rows in use, padding rows could divide by zero.
+    template<typename Left, typename Right, typename Operation>
+    static void unchecked_int_division_kernel(Value* destination, Left left, Right right, std::size_t row_count,
+            Operation operation)
+    {
+        for(std::size_t row = 0; row < row_count; row++)
+        {
+            set_scalar<UInt>(destination[row], operation(left.template get<UInt>(row), right.template get<UInt>(row)));
+        }
+    }
+
+    // Returns false without dividing if a row in use divides by zero, storing the first such row in `error_row`.
+    template<typename Left, typename Right, typename Operation>
+    static bool int_division_kernel(Value* destination, Left left, Right right, std::size_t row_count,
+            Operation operation, std::size_t& error_row)
+    {
+        bool has_zero_divisor = false;
+        for(std::size_t row = 0; row < row_count; row++)
+        {
+            has_zero_divisor |= right.template get<UInt>(row) == 0;
+        }
+
+        if(has_zero_divisor)
+        {
+            error_row = 0;
+            while(right.template get<UInt>(error_row) != 0) error_row++;
+            return false;
+        }
+
+        unchecked_int_division_kernel(destination, left, right, row_count, operation);
+        return true;
+    }
+
+    static constexpr auto identity = [](UInt value) { return value; };
+    static constexpr auto negate_int = [](UInt value) { return -value; };
+    static constexpr auto negate_float = [](Float value) { return -value; };
+    static constexpr auto int_to_float = [](UInt value) { return static_cast<Float>(static_cast<Int>(value)); };
+    static constexpr auto float_to_int = [](Float value) { return static_cast<UInt>(static_cast<Int>(value)); };
+
+    static constexpr auto add = [](auto left, auto right) { return left + right; };
+    static constexpr auto subtract = [](auto left, auto right) { return left - right; };
+    static constexpr auto multiply = [](auto left, auto right) { return left * right; };
+    static constexpr auto divide = [](auto left, auto right) { return left / right; };
+    static constexpr auto modulo = [](UInt left, UInt right) { return left % right; };
+    static constexpr auto shift_left = [](UInt left, UInt right) { return left << right; };
+    static constexpr auto shift_right = [](UInt left, UInt right) { return left >> right; };
+    static constexpr auto bitwise_and = [](UInt left, UInt right) { return left & right; };
+
+    BatchVm::BatchVm(State* state, const BytecodeObject* function)
+        : m_function(function), m_registers(state)
+    {
+        m_registers.resize(function->frame_size * BLOCK_SIZE, Value(UInt(0)));
+    }
+
+    template<typename T>
+    std::size_t BatchVm::run(T* output_column, std::size_t row_count, std::size_t& error_row)
+    {
+        static_assert(sizeof(T) == sizeof(Value));
+
+        for(std::size_t first_row = 0; first_row < row_count; first_row += BLOCK_SIZE)
+        {
+            const std::size_t block_row_count = std::min(BLOCK_SIZE, row_count - first_row);
+            T* const output = output_column + first_row;
+
+            std::size_t error_offset = run_block(block_row_count, output, error_row);
+            if(error_offset == 0) continue;
+
+            // A row before the failing one may still fail at a later instruction. Code has no side effects, so
+            // running only the rows before it again finds the row a row by row loop would stop at, and stores the
+            // results of the rows before that one.
+            std::size_t earlier_error_row = 0;
+            while(error_row != 0)
+            {
+                const std::size_t earlier_error_offset = run_block(error_row, output, earlier_error_row);
+                if(earlier_error_offset == 0) break;
+
+                error_offset = earlier_error_offset;
+                error_row = earlier_error_row;
+            }
+
+            error_row += first_row;
+            return error_offset;
+        }
+
+        return 0;
+    }
+
+    template std::size_t BatchVm::run<Int>(Int* output_column, std::size_t row_count, std::size_t& error_row);
+    template std::size_t BatchVm::run<Float>(Float* output_column, std::size_t row_count, std::size_t& error_row);
+
+    std::size_t BatchVm::run_block(std::size_t row_count, void* output, std::size_t& error_row)
+    {
+        const std::span<const Instruction> code = m_function->code;
+        const Value* constants = m_function->constants.data();
+        auto column = [this](std::uint32_t index) { return ColumnOperand{ get_column(index) }; };
+        auto constant = [constants](std::uint32_t index) { return BroadcastOperand{ constants[index] }; };
+
+        for(std::size_t i = 0; i < code.size(); i++)
+        {
+            const WideInstruction instruction = WideInstruction::decode(code, i);
+            const std::size_t next_offset = i + 1;
+
+            const std::uint32_t b = instruction.get_op_b();
+            const std::uint32_t c = instruction.get_op_c();
+            const std::uint32_t d = instruction.get_op_d();
+            Value* const a = get_column(instruction.get_op_a());
+            const BroadcastOperand immediate{ Value(static_cast<UInt>(static_cast<Int>(instruction.get_op_sc()))) };
+            const BroadcastOperand shift{ Value(static_cast<UInt>(c & 63)) };
+
+            switch(instruction.get_opcode())
+            {
+                case Opcode::NO_OP:
+                case Opcode::WIDE:
+                case Opcode::RESERVE:
+                    break;
+                case Opcode::RETURN:
+                    return 0;
+                case Opcode::RETURN_VALUE:
+                    std::memcpy(output, a, row_count * sizeof(Value));
+                    return 0;
+                case Opcode::RETURN_CONSTANT:
+                    std::fill_n(static_cast<Value*>(output), row_count, constants[d]);
+                    return 0;
+                case Opcode::MOVE:
+                    unary_kernel<UInt, UInt>(a, column(d), identity);
+                    break;
+                case Opcode::LOAD_CONSTANT:
+                    unary_kernel<UInt, UInt>(a, constant(d), identity);
+                    break;
+                case Opcode::NEGATION_INT:
+                    unary_kernel<UInt, UInt>(a, column(d), negate_int);
+                    break;
+                case Opcode::NEGATION_FLOAT:
+                    unary_kernel<Float, Float>(a, column(d), negate_float);
+                    break;
+                case Opcode::INT_TO_FLOAT:
+                    unary_kernel<UInt, Float>(a, column(d), int_to_float);
+                    break;
+                case Opcode::FLOAT_TO_INT:
+                    unary_kernel<Float, UInt>(a, column(d), float_to_int);
+                    break;
+                case Opcode::ADD_INT:
+                    binary_kernel<UInt>(a, column(b), column(c), add);
+                    break;
+                case Opcode::SUBTRACT_INT:
+                    binary_kernel<UInt>(a, column(b), column(c), subtract);
+                    break;
+                case Opcode::MULTIPLY_INT:
+                    binary_kernel<UInt>(a, column(b), column(c), multiply);
+                    break;
+                case Opcode::DIVIDE_INT:
+                    if(!int_division_kernel(a, column(b), column(c), row_count, divide, error_row)) return next_offset;
+                    break;
+                case Opcode::MODULO_INT:
+                    if(!int_division_kernel(a, column(b), column(c), row_count, modulo, error_row)) return next_offset;
+                    break;
+                case Opcode::ADD_FLOAT:
+                    binary_kernel<Float>(a, column(b), column(c), add);
+                    break;
+                case Opcode::SUBTRACT_FLOAT:
+                    binary_kernel<Float>(a, column(b), column(c), subtract);
+                    break;
+                case Opcode::MULTIPLY_FLOAT:
+                    binary_kernel<Float>(a, column(b), column(c), multiply);
+                    break;
+                case Opcode::DIVIDE_FLOAT:
+                    binary_kernel<Float>(a, column(b), column(c), divide);
+                    break;
+                case Opcode::ADD_INT_RK:
+                    binary_kernel<UInt>(a, column(b), constant(c), add);
+                    break;
+                case Opcode::SUBTRACT_INT_RK:
+                    binary_kernel<UInt>(a, column(b), constant(c), subtract);
+                    break;
+                case Opcode::MULTIPLY_INT_RK:
+                    binary_kernel<UInt>(a, column(b), constant(c), multiply);
+                    break;
+                case Opcode::DIVIDE_INT_RK:
+                    if(!int_division_kernel(a, column(b), constant(c), row_count, divide, error_row)) return next_offset;
+                    break;
+                case Opcode::MODULO_INT_RK:
+                    if(!int_division_kernel(a, column(b), constant(c), row_count, modulo, error_row)) return next_offset;
+                    break;
+                case Opcode::ADD_FLOAT_RK:
+                    binary_kernel<Float>(a, column(b), constant(c), add);
+                    break;
+                case Opcode::SUBTRACT_FLOAT_RK:
+                    binary_kernel<Float>(a, column(b), constant(c), subtract);
+                    break;
+                case Opcode::MULTIPLY_FLOAT_RK:
+                    binary_kernel<Float>(a, column(b), constant(c), multiply);
+                    break;
+                case Opcode::DIVIDE_FLOAT_RK:
+                    binary_kernel<Float>(a, column(b), constant(c), divide);
+                    break;
+                case Opcode::SUBTRACT_INT_KR:
+                    binary_kernel<UInt>(a, constant(b), column(c), subtract);
+                    break;
+                case Opcode::DIVIDE_INT_KR:
+                    if(!int_division_kernel(a, constant(b), column(c), row_count, divide, error_row)) return next_offset;
+                    break;
+                case Opcode::MODULO_INT_KR:
+                    if(!int_division_kernel(a, constant(b), column(c), row_count, modulo, error_row)) return next_offset;
+                    break;
+                case Opcode::SUBTRACT_FLOAT_KR:
+                    binary_kernel<Float>(a, constant(b), column(c), subtract);
+                    break;
+                case Opcode::DIVIDE_FLOAT_KR:
+                    binary_kernel<Float>(a, constant(b), column(c), divide);
+                    break;
+                case Opcode::ADD_INT_RI:
+                    binary_kernel<UInt>(a, column(b), immediate, add);
+                    break;
+                case Opcode::SUBTRACT_INT_RI:
+                    binary_kernel<UInt>(a, column(b), immediate, subtract);
+                    break;
+                case Opcode::MULTIPLY_INT_RI:
+                    binary_kernel<UInt>(a, column(b), immediate, multiply);
+                    break;
+                case Opcode::SHIFT_LEFT_INT_RI:
+                    binary_kernel<UInt>(a, column(b), shift, shift_left);
+                    break;
+                case Opcode::SHIFT_RIGHT_INT_RI:
+                    binary_kernel<UInt>(a, column(b), shift, shift_right);
+                    break;
+                case Opcode::AND_INT_RK:
+                    binary_kernel<UInt>(a, column(b), constant(c), bitwise_and);
+                    break;
+                case Opcode::DIVIDE_INT_MAGIC:
+                case Opcode::MODULO_INT_MAGIC:
+                {
+                    const UInt divisor = constants[c].as_int;
+                    const UInt magic = constants[c + 1].as_int;
+                    const std::uint32_t magic_shift = get_division_magic_shift(divisor);
+                    if(instruction.get_opcode() == Opcode::DIVIDE_INT_MAGIC)
+                    {
+                        unary_kernel<UInt, UInt>(a, column(b), [=](UInt value) {
+                            return divide_by_magic(value, magic, magic_shift);
+                        });
+                    }
+                    else
+                    {
+                        unary_kernel<UInt, UInt>(a, column(b), [=](UInt value) {
+                            return value - divide_by_magic(value, magic, magic_shift) * divisor;
+                        });
+                    }
+                    break;
+                }
+                case Opcode::FMA_FLOAT:
+                {
+                    const Value* const left = get_column(b);
+                    const Value* const right = get_column(c);
+                    WF_BATCH_VECTORIZE
+                    for(std::size_t row = 0; row < BLOCK_SIZE; row++)
+                    {
+                        a[row].as_float = std::fma(left[row].as_float, right[row].as_float, a[row].as_float);
+                    }
+                    break;
+                }
+                case Opcode::DIVIDE_INT_NOCHECK:
+                    unchecked_int_division_kernel(a, column(b), column(c), row_count, divide);
+                    break;
+                case Opcode::MODULO_INT_NOCHECK:
+                    unchecked_int_division_kernel(a, column(b), column(c), row_count, modulo);
+                    break;
+            }
+        }
+
+        return 0;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef WF_BATCH_VM_HPP
+#define WF_BATCH_VM_HPP
+
+#include "Object.hpp"
+
+namespace wf
+{
+    // Runs a function over many rows at once. Every register holds a column of BLOCK_SIZE rows and each
+    // instruction runs a kernel over the whole block, so dispatch is paid once per block instead of once
+    // per row.
+    class BatchVm
+    {
+    public:
+        static constexpr std::size_t BLOCK_SIZE = 128;
+
+        BatchVm(State* state, const BytecodeObject* function);
+
+        // Returns 0, or the code offset following the integer division by zero that stopped the first failing row.
+        // In that case `error_row` is that row, and the rows before it hold their results.
+        template<typename T>
+        std::size_t run(T* output_column, std::size_t row_count, std::size_t& error_row);
+    private:
+        const BytecodeObject* const m_function;
+        DynamicArray<Value> m_registers;
+
+        Value* get_column(std::uint32_t index) { return m_registers.data() + index * BLOCK_SIZE; }
+
+        // Like run(), with `error_row` relative to the block.
+        std::size_t run_block(std::size_t row_count, void* output, std::size_t& error_row);
+    };
+}
+
+#endif
\ No newline at end of file
@@ -20,37 +20,97 @@ namespace wf
         return format(state, "I({})", operand);
     }
 
+    static String signed_immediate_operand(State* const state, std::int32_t operand)
+    {
+        return format(state, "I({})", operand);
+    }
+
+    static void write_operands(String& result, std::string_view name,
+            const String& first, const String& second, const String& third)
+    {
+        format_to(result, "{1:<{0}}{2:<{0}}{3:<{0}}{4}\n", width, name, first, second, third);
+    }
+
+    static void write_three_register_op(State* const state, String& result,
+            std::string_view name, const WideInstruction& instruction)
+    {
+        write_operands(result, name,
+            register_operand(state, instruction.get_op_a()),
+            register_operand(state, instruction.get_op_b()),
+            register_operand(state, instruction.get_op_c())
+        );
+    }
+
+    static void write_register_constant_op(State* const state, String& result,
+            std::string_view name, const WideInstruction& instruction)
+    {
+        write_operands(result, name,
+            register_operand(state, instruction.get_op_a()),
+            register_operand(state, instruction.get_op_b()),
+            constant_operand(state, instruction.get_op_c())
+        );
+    }
+
+    static void write_constant_register_op(State* const state, String& result,
+            std::string_view name, const WideInstruction& instruction)
+    {
+        write_operands(result, name,
+            register_operand(state, instruction.get_op_a()),
+            constant_operand(state, instruction.get_op_b()),
+            register_operand(state, instruction.get_op_c())
+        );
+    }
+
+    static void write_register_immediate_op(State* const state, String& result,
+            std::string_view name, const WideInstruction& instruction)
+    {
+        write_operands(result, name,
+            register_operand(state, instruction.get_op_a()),
+            register_operand(state, instruction.get_op_b()),
+            signed_immediate_operand(state, instruction.get_op_sc())
+        );
+    }
+
     static void write_constant_op(State* const state, String& result,
-            std::string_view name, const Instruction& instruction)
+            std::string_view name, const WideInstruction& instruction)
     {
         format_to(result,
             "{1:<{0}}{2:<{0}}{3}\n", width, name,
                 register_operand(state, instruction.get_op_a()),
-                constant_operand(state, instruction.get_op_b())
+                constant_operand(state, instruction.get_op_d())
+        );
+    }
+
+    static void write_one_constant_op(State* const state, String& result,
+            std::string_view name, const WideInstruction& instruction)
+    {
+        format_to(result,
+            "{1:<{0}}{2}\n", width, name,
+                constant_operand(state, instruction.get_op_d())
         );
     }
 
     static void write_two_register_op(State* const state, String& result,
-            std::string_view name, const Instruction& instruction)
+            std::string_view name, const WideInstruction& instruction)
     {
         format_to(result,
             "{1:<{0}}{2:<{0}}{3}\n", width, name,
                 register_operand(state, instruction.get_op_a()),
-                register_operand(state, instruction.get_op_b())
+                register_operand(state, instruction.get_op_d())
         );
     }
 
     static void write_one_register_op(State* const state, String& result,
-            std::string_view name, const Instruction& instruction)
+            std::string_view name, const WideInstruction& instruction)
     {
         format_to(result,
             "{1:<{0}}{2}\n", width, name,
-                register_operand(state, instruction.get_op_long())
+                register_operand(state, instruction.get_op_a())
         );
     }
 
     static void write_one_immediate_op(State* const state, String& result,
-            std::string_view name, const Instruction& instruction)
+            std::string_view name, const WideInstruction& instruction)
     {
         format_to(result,
             "{1:<{0}}{2}\n", width, name,
@@ -67,20 +127,34 @@ namespace wf
     {
         String result = format(state, "<***> Disassembled bytecode <***>\ncode:\n");
 
-        for(const Instruction& instruction : code->code)
+        for(std::size_t i = 0; i < code->code.size(); i++)
         {
             result += format(state, "    ");
+
+            // The operands of a prefixed instruction are shown in full after the prefix.
+            const WideInstruction instruction = WideInstruction::decode(code->code, i);
+            if(instruction.is_wide())
+            {
+                write_no_operand_op(result, "wide");
+                result += format(state, "    ");
+            }
             switch(instruction.get_opcode())
             {
                 case Opcode::NO_OP:
                     write_no_operand_op(result, "nop");
                     break;
+                case Opcode::WIDE:
+                    write_no_operand_op(result, "wide");
+                    break;
                 case Opcode::RETURN:
-                    write_no_operand_op(result, "nop");
+                    write_no_operand_op(result, "ret");
                     break;
                 case Opcode::RETURN_VALUE:
                     write_one_register_op(state, result, "retv", instruction);
                     break;
+                case Opcode::RETURN_CONSTANT:
+                    write_one_constant_op(state, result, "retk", instruction);
+                    break;
                 case Opcode::RESERVE:
                     write_one_immediate_op(state, result, "rsv", instruction);
                     break;
@@ -91,43 +165,118 @@ namespace wf
                     write_constant_op(state, result, "ldk", instruction);
                     break;
                 case Opcode::NEGATION_INT:
-                    write_one_register_op(state, result, "unmi", instruction);
+                    write_two_register_op(state, result, "unmi", instruction);
                     break;
                 case Opcode::NEGATION_FLOAT:
-                    write_one_register_op(state, result, "unmf", instruction);
+                    write_two_register_op(state, result, "unmf", instruction);
                     break;
                 case Opcode::INT_TO_FLOAT:
-                    write_one_register_op(state, result, "itof", instruction);
+                    write_two_register_op(state, result, "itof", instruction);
                     break;
                 case Opcode::FLOAT_TO_INT:
-                    write_one_register_op(state, result, "ftoi", instruction);
+                    write_two_register_op(state, result, "ftoi", instruction);
                     break;
                 case Opcode::ADD_INT:
-                    write_two_register_op(state, result, "addi", instruction);
+                    write_three_register_op(state, result, "addi", instruction);
                     break;
                 case Opcode::SUBTRACT_INT:
-                    write_two_register_op(state, result, "subi", instruction);
+                    write_three_register_op(state, result, "subi", instruction);
                     break;
                 case Opcode::MULTIPLY_INT:
-                    write_two_register_op(state, result, "muli", instruction);
+                    write_three_register_op(state, result, "muli", instruction);
                     break;
                 case Opcode::DIVIDE_INT:
-                    write_two_register_op(state, result, "divi", instruction);
+                    write_three_register_op(state, result, "divi", instruction);
                     break;
                 case Opcode::MODULO_INT:
-                    write_two_register_op(state, result, "modi", instruction);
+                    write_three_register_op(state, result, "modi", instruction);
                     break;
                 case Opcode::ADD_FLOAT:
-                    write_two_register_op(state, result, "addf", instruction);
+                    write_three_register_op(state, result, "addf", instruction);
                     break;
                 case Opcode::SUBTRACT_FLOAT:
-                    write_two_register_op(state, result, "subf", instruction);
+                    write_three_register_op(state, result, "subf", instruction);
                     break;
                 case Opcode::MULTIPLY_FLOAT:
-                    write_two_register_op(state, result, "mulf", instruction);
+                    write_three_register_op(state, result, "mulf", instruction);
                     break;
                 case Opcode::DIVIDE_FLOAT:
-                    write_two_register_op(state, result, "divf", instruction);
+                    write_three_register_op(state, result, "divf", instruction);
+                    break;
+                case Opcode::ADD_INT_RK:
+                    write_register_constant_op(state, result, "addi", instruction);
+                    break;
+                case Opcode::SUBTRACT_INT_RK:
+                    write_register_constant_op(state, result, "subi", instruction);
+                    break;
+                case Opcode::MULTIPLY_INT_RK:
+                    write_register_constant_op(state, result, "muli", instruction);
+                    break;
+                case Opcode::DIVIDE_INT_RK:
+                    write_register_constant_op(state, result, "divi", instruction);
+                    break;
+                case Opcode::MODULO_INT_RK:
+                    write_register_constant_op(state, result, "modi", instruction);
+                    break;
+                case Opcode::ADD_FLOAT_RK:
+                    write_register_constant_op(state, result, "addf", instruction);
+                    break;
+                case Opcode::SUBTRACT_FLOAT_RK:
+                    write_register_constant_op(state, result, "subf", instruction);
+                    break;
+                case Opcode::MULTIPLY_FLOAT_RK:
+                    write_register_constant_op(state, result, "mulf", instruction);
+                    break;
+                case Opcode::DIVIDE_FLOAT_RK:
+                    write_register_constant_op(state, result, "divf", instruction);
+                    break;
+                case Opcode::SUBTRACT_INT_KR:
+                    write_constant_register_op(state, result, "subi", instruction);
+                    break;
+                case Opcode::DIVIDE_INT_KR:
+                    write_constant_register_op(state, result, "divi", instruction);
+                    break;
+                case Opcode::MODULO_INT_KR:
+                    write_constant_register_op(state, result, "modi", instruction);
+                    break;
+                case Opcode::SUBTRACT_FLOAT_KR:
+                    write_constant_register_op(state, result, "subf", instruction);
+                    break;
+                case Opcode::DIVIDE_FLOAT_KR:
+                    write_constant_register_op(state, result, "divf", instruction);
+                    break;
+                case Opcode::ADD_INT_RI:
+                    write_register_immediate_op(state, result, "addi", instruction);
+                    break;
+                case Opcode::SUBTRACT_INT_RI:
+                    write_register_immediate_op(state, result, "subi", instruction);
+                    break;
+                case Opcode::MULTIPLY_INT_RI:
+                    write_register_immediate_op(state, result, "muli", instruction);
+                    break;
+                case Opcode::SHIFT_LEFT_INT_RI:
+                    write_register_immediate_op(state, result, "shli", instruction);
+                    break;
+                case Opcode::SHIFT_RIGHT_INT_RI:
+                    write_register_immediate_op(state, result, "shri", instruction);
+                    break;
+                case Opcode::AND_INT_RK:
+                    write_register_constant_op(state, result, "andi", instruction);
+                    break;
+                case Opcode::DIVIDE_INT_MAGIC:
+                    write_register_constant_op(state, result, "divi", instruction);
+                    break;
+                case Opcode::MODULO_INT_MAGIC:
+                    write_register_constant_op(state, result, "modi", instruction);
+                    break;
+                case Opcode::FMA_FLOAT:
+                    write_three_register_op(state, result, "fmaf", instruction);
+                    break;
+                case Opcode::DIVIDE_INT_NOCHECK:
+                    write_three_register_op(state, result, "divn", instruction);
+                    break;
+                case Opcode::MODULO_INT_NOCHECK:
+                    write_three_register_op(state, result, "modn", instruction);
                     break;
             }
         }
@@ -0,0 +1,234 @@
+#include "BytecodeFile.hpp"
+
+#include <bit>
+#include <cstring>
+
+#include "State.hpp"
+#include "Vm/Verifier.hpp"
+#include "Utils/Allocate.hpp"
+#include "Utils/Format.hpp"
+
+namespace wf
+{
+    static_assert(std::is_trivially_copyable_v<BytecodeFileHeader> && sizeof(BytecodeFileHeader) == 128);
+    static_assert(sizeof(Instruction) == 4 && sizeof(Value) == 8 && sizeof(ConstantType) == 1);
+    static_assert(sizeof(LineTableCheckpoint) == 12);
+
+    static constexpr std::size_t SECTION_ALIGNMENT = 8;
+
+    static std::size_t align_up(std::size_t size, std::size_t alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    template<typename T>
+    static BytecodeFileSection append_section(String& result, std::span<const T> elements)
+    {
+        result.resize(align_up(result.size(), SECTION_ALIGNMENT), '\0');
+
+        const BytecodeFileSection section = { .offset = result.size(), .count = elements.size() };
+        result.append(reinterpret_cast<const char*>(elements.data()), elements.size_bytes());
+        return section;
+    }
+
+    void write_bytecode_file(const BytecodeObject* code, String& result)
+    {
+        State* const state = result.get_allocator().get_state();
+
+        // STRING constants are stored as indices into the string table.
+        DynamicArray<Value> constants(code->constants.begin(), code->constants.end(), state);
+        DynamicArray<BytecodeFileString> strings(state);
+        String string_data(state);
+        for(std::size_t i = 0; i < constants.size(); i++)
+        {
+            if(code->constant_type_infos[i] != ConstantType::STRING) continue;
+
+            const StringObject* string = constants[i].as_string();
+            strings.push_back({ .offset = string_data.size(), .length = string->length });
+            string_data.append(string->text, string->length);
+            string_data.push_back('\0');
+            constants[i] = Value(static_cast<UInt>(strings.size() - 1));
+        }
+
+        result.assign(sizeof(BytecodeFileHeader), '\0');
+
+        const BytecodeFileHeader header = {
+            .magic = BytecodeFileHeader::MAGIC,
+            .version = BytecodeFileHeader::VERSION,
+            .opcode_count = OPCODE_COUNT,
+            .return_type = static_cast<std::uint32_t>(code->return_type),
+            .code = append_section(result, code->code),
+            .constants = append_section(result, std::span<const Value>(constants)),
+            .constant_types = append_section(result, code->constant_type_infos),
+            .line_data = append_section(result, code->line_table.data),
+            .line_checkpoints = append_section(result, code->line_table.checkpoints),
+            .strings = append_section(result, std::span<const BytecodeFileString>(strings)),
+            .string_data = append_section(result, std::span<const char>(string_data))
+        };
+
+        std::memcpy(result.data(), &header, sizeof(header));
+    }
+
+    template<typename T>
+    static bool get_section(std::span<const std::byte> file, const BytecodeFileSection& section,
+            std::span<const T>& result)
+    {
+        if(section.offset % alignof(T) != 0 || section.offset > file.size()) return false;
+        if(section.count > (file.size() - section.offset) / sizeof(T)) return false;
+
+        result = { reinterpret_cast<const T*>(file.data() + section.offset), static_cast<std::size_t>(section.count) };
+        return true;
+    }
+
+    static bool verify_file(const BytecodeFileHeader& header, std::span<const Instruction> code,
+            std::span<const ConstantType> constant_types, std::span<const Value> constants,
+            const LineTable& line_table, std::span<const BytecodeFileString> strings,
+            std::span<const char> string_data, std::uint32_t& frame_size, String& error)
+    {
+        if(header.version != BytecodeFileHeader::VERSION || header.opcode_count != OPCODE_COUNT)
+        {
+            format_to(error, "unsupported version {}", header.version);
+            return false;
+        }
+
+        if(header.return_type > static_cast<std::uint32_t>(TypeId::FLOAT))
+        {
+            format_to(error, "invalid return type {}", header.return_type);
+            return false;
+        }
+
+        if(constant_types.size() != constants.size())
+        {
+            format_to(error, "every constant needs a type");
+            return false;
+        }
+
+        for(std::size_t i = 0; i < constants.size(); i++)
+        {
+            if(constant_types[i] > ConstantType::STRING)
+            {
+                format_to(error, "constant {}: invalid type", i);
+                return false;
+            }
+            if(constant_types[i] == ConstantType::STRING && constants[i].as_int >= strings.size())
+            {
+                format_to(error, "constant {}: string {} does not exist", i, constants[i].as_int);
+                return false;
+            }
+        }
+
+        for(std::size_t i = 0; i < strings.size(); i++)
+        {
+            if(strings[i].offset >= string_data.size() || strings[i].length >= string_data.size() - strings[i].offset
+                || string_data[strings[i].offset + strings[i].length] != '\0')
+            {
+                format_to(error, "string {}: out of bounds or not terminated", i);
+                return false;
+            }
+        }
+
+        if(!line_table.is_valid(code.size()))
+        {
+            format_to(error, "malformed line table");
+            return false;
+        }
+
+        return verify_bytecode(code, constant_types, constants, frame_size, error);
+    }
+
+    ModuleData* load_bytecode_file(State* state, std::span<const std::byte> file, String& error)
+    {
+        error = "Invalid bytecode file: ";
+
+        if constexpr(std::endian::native != std::endian::little)
+        {
+            format_to(error, "precompiled bytecode needs a little-endian host");
+            return nullptr;
+        }
+
+        BytecodeFileHeader header;
+        if(file.size() < sizeof(header) || reinterpret_cast<std::uintptr_t>(file.data()) % SECTION_ALIGNMENT != 0)
+        {
+            format_to(error, "too short or not aligned to {} bytes", SECTION_ALIGNMENT);
+            return nullptr;
+        }
+
+        std::memcpy(&header, file.data(), sizeof(header));
+        if(header.magic != BytecodeFileHeader::MAGIC)
+        {
+            format_to(error, "not a bytecode file");
+            return nullptr;
+        }
+
+        std::span<const Instruction> code;
+        std::span<const Value> constants;
+        std::span<const ConstantType> constant_types;
+        LineTable line_table;
+        std::span<const BytecodeFileString> strings;
+        std::span<const char> string_data;
+        if(!get_section(file, header.code, code) || !get_section(file, header.constants, constants)
+            || !get_section(file, header.constant_types, constant_types)
+            || !get_section(file, header.line_data, line_table.data)
+            || !get_section(file, header.line_checkpoints, line_table.checkpoints)
+            || !get_section(file, header.strings, strings)
+            || !get_section(file, header.string_data, string_data))
+        {
+            format_to(error, "section out of bounds");
+            return nullptr;
+        }
+
+        std::uint32_t frame_size = 0;
+        if(!verify_file(header, code, constant_types, constants, line_table, strings, string_data, frame_size, error))
+        {
+            return nullptr;
+        }
+
+        // The header lives in its own allocation. Only constants that refer to strings need patching, files
+        // without any keep using their constants in place.
+        const bool has_strings = !strings.empty();
+        std::size_t size = sizeof(ModuleData);
+        const std::size_t constants_offset = size = align_up(size, alignof(Value));
+        size += has_strings? constants.size() * sizeof(Value) : 0;
+        const std::size_t strings_offset = size = align_up(size, alignof(StringObject));
+        size += strings.size() * sizeof(StringObject);
+
+        std::byte* memory = static_cast<std::byte*>(allocate(state, size));
+
+        StringObject* string_objects = reinterpret_cast<StringObject*>(memory + strings_offset);
+        for(std::size_t i = 0; i < strings.size(); i++)
+        {
+            const std::string_view text(string_data.data() + strings[i].offset, strings[i].length);
+            new(string_objects + i) StringObject(StringInfo{
+                .text = text.data(),
+                .length = text.length(),
+                .hash = std::hash<std::string_view>()(text)
+            });
+        }
+
+        if(has_strings)
+        {
+            Value* patched_constants = reinterpret_cast<Value*>(memory + constants_offset);
+            for(std::size_t i = 0; i < constants.size(); i++)
+            {
+                patched_constants[i] = constant_types[i] == ConstantType::STRING?
+                    Value(string_objects + constants[i].as_int) : constants[i];
+            }
+            constants = { patched_constants, constants.size() };
+        }
+
+        return new(memory) ModuleData{
+            .allocator = state->allocator,
+            .allocation = memory,
+            .allocation_size = size,
+            .reference_count = 1,
+            .line_table = line_table,
+            .code = code,
+            .constant_type_infos = constant_types,
+            .constants = constants,
+            .strings = { string_objects, strings.size() },
+            .return_type = static_cast<TypeId>(header.return_type),
+            .frame_size = frame_size,
+            .is_verified = true
+        };
+    }
+}
\ No newline at end of file
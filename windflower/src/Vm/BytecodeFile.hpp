@@ -0,0 +1,54 @@
+#ifndef WF_BYTECODE_FILE_HPP
+#define WF_BYTECODE_FILE_HPP
+
+#include <array>
+#include <span>
+
+#include "Module.hpp"
+#include "Utils/String.hpp"
+
+namespace wf
+{
+    // Precompiled bytecode (.wfc) files. Integers are little-endian and every section starts at a multiple of 8
+    // bytes from the start of the file, so a loaded file runs its code and constants in place.
+    struct BytecodeFileSection
+    {
+        std::uint64_t offset;
+        std::uint64_t count;
+    };
+
+    // Entry of the string table, `length` bytes of text followed by a null terminator in the string data.
+    struct BytecodeFileString
+    {
+        std::uint64_t offset;
+        std::uint64_t length;
+    };
+
+    struct BytecodeFileHeader
+    {
+        static constexpr std::array<char, 4> MAGIC = { 'W', 'F', 'B', 'C' };
+        // Must be bumped whenever the instruction set or the layout of the file changes.
+        static constexpr std::uint32_t VERSION = 5;
+
+        std::array<char, 4> magic;
+        std::uint32_t version;
+        std::uint32_t opcode_count;
+        std::uint32_t return_type;
+
+        BytecodeFileSection code; // Instruction
+        BytecodeFileSection constants; // Value, STRING constants hold an index into the string table.
+        BytecodeFileSection constant_types; // ConstantType, one per constant.
+        BytecodeFileSection line_data; // std::uint8_t, see LineTable.
+        BytecodeFileSection line_checkpoints; // LineTableCheckpoint
+        BytecodeFileSection strings; // BytecodeFileString
+        BytecodeFileSection string_data; // char
+    };
+
+    void write_bytecode_file(const BytecodeObject* code, String& result);
+
+    // Verifies `file` and returns a module that uses its code, constants and strings in place, or nullptr and a
+    // message in `error` if the file is malformed.
+    ModuleData* load_bytecode_file(State* state, std::span<const std::byte> file, String& error);
+}
+
+#endif
\ No newline at end of file
@@ -1,29 +1,55 @@
 #ifndef WF_INSTRUCTIONS_HPP
 #define WF_INSTRUCTIONS_HPP
 
+#include <cstddef>
 #include <cstdint>
+#include <span>
+#include <string_view>
 
 #include "Utils/Numeric.hpp"
 
+// Expands X(opcode) for every entry of Opcode, which it must be kept in sync with.
+#define WF_FOR_EACH_OPCODE(X)                                                                           \
+    X(NO_OP) X(WIDE) X(RETURN) X(RETURN_VALUE)                                                          \
+    X(RESERVE) X(MOVE) X(LOAD_CONSTANT)                                                                 \
+    X(NEGATION_INT) X(NEGATION_FLOAT)                                                                   \
+    X(INT_TO_FLOAT) X(FLOAT_TO_INT)                                                                     \
+    X(ADD_INT) X(SUBTRACT_INT) X(MULTIPLY_INT) X(DIVIDE_INT) X(MODULO_INT)                              \
+    X(ADD_FLOAT) X(SUBTRACT_FLOAT) X(MULTIPLY_FLOAT) X(DIVIDE_FLOAT)                                    \
+    X(ADD_INT_RK) X(SUBTRACT_INT_RK) X(MULTIPLY_INT_RK) X(DIVIDE_INT_RK) X(MODULO_INT_RK)               \
+    X(ADD_FLOAT_RK) X(SUBTRACT_FLOAT_RK) X(MULTIPLY_FLOAT_RK) X(DIVIDE_FLOAT_RK)                        \
+    X(SUBTRACT_INT_KR) X(DIVIDE_INT_KR) X(MODULO_INT_KR)                                                \
+    X(SUBTRACT_FLOAT_KR) X(DIVIDE_FLOAT_KR)                                                             \
+    X(ADD_INT_RI) X(SUBTRACT_INT_RI) X(MULTIPLY_INT_RI)                                                 \
+    X(SHIFT_LEFT_INT_RI) X(SHIFT_RIGHT_INT_RI) X(AND_INT_RK)                                            \
+    X(DIVIDE_INT_MAGIC) X(MODULO_INT_MAGIC) X(FMA_FLOAT)                                                \
+    X(DIVIDE_INT_NOCHECK) X(MODULO_INT_NOCHECK)                                                         \
+    X(RETURN_CONSTANT)
+
 namespace wf
 {
-    enum class Opcode : std::uint32_t
+    // R(x): register x of the active frame.
+    // K(x): constant x of the active function.
+    // I(x): signed immediate x.
+    enum class Opcode : std::uint8_t
     {
         NO_OP, // nop
+        WIDE, // wide           Extends the operands of the next instruction, see WideInstruction.
 
         RETURN, // ret
-        RETURN_VALUE, // retv
+        RETURN_VALUE, // retv       R(A)
 
-        RESERVE, // rsv
-        MOVE, // mov
-        LOAD_CONSTANT, // ldk
+        RESERVE, // rsv             I(long)
+        MOVE, // mov                R(A) := R(D)
+        LOAD_CONSTANT, // ldk       R(A) := K(D)
 
-        NEGATION_INT, // unmi
-        NEGATION_FLOAT, // unmf
+        NEGATION_INT, // unmi       R(A) := -R(D)
+        NEGATION_FLOAT, // unmf     R(A) := -R(D)
 
-        INT_TO_FLOAT,
-        FLOAT_TO_INT,
+        INT_TO_FLOAT, // itof       R(A) := Float(R(D))
+        FLOAT_TO_INT, // ftoi       R(A) := Int(R(D))
 
+        // R(A) := R(B) op R(C)
         ADD_INT, // addi
         SUBTRACT_INT, // subi
         MULTIPLY_INT, // muli
@@ -34,28 +60,196 @@ namespace wf
         SUBTRACT_FLOAT, // subf
         MULTIPLY_FLOAT, // mulf
         DIVIDE_FLOAT, // divf
+
+        // R(A) := R(B) op K(C)
+        ADD_INT_RK, // addi
+        SUBTRACT_INT_RK, // subi
+        MULTIPLY_INT_RK, // muli
+        DIVIDE_INT_RK, // divi
+        MODULO_INT_RK, // modi
+
+        ADD_FLOAT_RK, // addf
+        SUBTRACT_FLOAT_RK, // subf
+        MULTIPLY_FLOAT_RK, // mulf
+        DIVIDE_FLOAT_RK, // divf
+
+        // R(A) := K(B) op R(C), only needed by non-commutative operations.
+        SUBTRACT_INT_KR, // subi
+        DIVIDE_INT_KR, // divi
+        MODULO_INT_KR, // modi
+
+        SUBTRACT_FLOAT_KR, // subf
+        DIVIDE_FLOAT_KR, // divf
+
+        // R(A) := R(B) op I(sC)
+        ADD_INT_RI, // addi
+        SUBTRACT_INT_RI, // subi
+        MULTIPLY_INT_RI, // muli
+
+        // Cheaper forms of int operations by constants, see CodeGen.
+        SHIFT_LEFT_INT_RI, // shli      R(A) := R(B) << I(C), C modulo 64
+        SHIFT_RIGHT_INT_RI, // shri     R(A) := R(B) >> I(C), C modulo 64
+        AND_INT_RK, // andi             R(A) := R(B) & K(C)
+        // R(A) := R(B) op K(C) where K(C) is at least 3 and not a power of two, and K(C + 1) holds
+        // get_division_magic(K(C)).
+        DIVIDE_INT_MAGIC, // divi
+        MODULO_INT_MAGIC, // modi
+
+        FMA_FLOAT, // fmaf              R(A) := R(B) * R(C) + R(A), rounded once
+
+        // R(A) := R(B) op R(C) where R(C) is known not to be 0, so it is not checked.
+        DIVIDE_INT_NOCHECK, // divn
+        MODULO_INT_NOCHECK, // modn
+
+        // Superinstructions, fusions of the opcode pairs that profiles of real code show most often.
+        RETURN_CONSTANT, // retk    K(D), ldk followed by retv
     };
 
+    // Must be kept in sync with the last entry of Opcode.
+    constexpr std::size_t OPCODE_COUNT = static_cast<std::size_t>(Opcode::RETURN_CONSTANT) + 1;
+
+    // Name of the Opcode enumerator, for tools that report on opcodes.
+    constexpr std::string_view get_opcode_name(Opcode opcode)
+    {
+        switch(opcode)
+        {
+            #define WF_OPCODE_NAME_CASE(opcode) case Opcode::opcode: return #opcode;
+            WF_FOR_EACH_OPCODE(WF_OPCODE_NAME_CASE)
+            #undef WF_OPCODE_NAME_CASE
+        }
+        return "UNKNOWN";
+    }
+
+    enum class OperandKind : std::uint8_t
+    {
+        UNUSED, REGISTER, CONSTANT, IMMEDIATE,
+    };
+
+    // What the operands of an instruction refer to. A REGISTER in A is the register the instruction writes,
+    // which retv and fmaf read as well, see reads_op_a(). Every other REGISTER is one it reads. The long operand
+    // of rsv is not described.
+    struct OperandLayout
+    {
+        OperandKind a = OperandKind::UNUSED;
+        OperandKind b = OperandKind::UNUSED;
+        OperandKind c = OperandKind::UNUSED;
+        OperandKind d = OperandKind::UNUSED;
+    };
+
+    constexpr OperandLayout get_operand_layout(Opcode opcode)
+    {
+        constexpr OperandKind R = OperandKind::REGISTER;
+        constexpr OperandKind K = OperandKind::CONSTANT;
+        constexpr OperandKind I = OperandKind::IMMEDIATE;
+
+        switch(opcode)
+        {
+            case Opcode::NO_OP:
+            case Opcode::WIDE:
+            case Opcode::RETURN:
+            case Opcode::RESERVE:
+                return {};
+            case Opcode::RETURN_VALUE:
+                return { .a = R };
+            case Opcode::MOVE:
+            case Opcode::NEGATION_INT:
+            case Opcode::NEGATION_FLOAT:
+            case Opcode::INT_TO_FLOAT:
+            case Opcode::FLOAT_TO_INT:
+                return { .a = R, .d = R };
+            case Opcode::LOAD_CONSTANT:
+                return { .a = R, .d = K };
+            case Opcode::ADD_INT:
+            case Opcode::SUBTRACT_INT:
+            case Opcode::MULTIPLY_INT:
+            case Opcode::DIVIDE_INT:
+            case Opcode::MODULO_INT:
+            case Opcode::ADD_FLOAT:
+            case Opcode::SUBTRACT_FLOAT:
+            case Opcode::MULTIPLY_FLOAT:
+            case Opcode::DIVIDE_FLOAT:
+                return { .a = R, .b = R, .c = R };
+            case Opcode::ADD_INT_RK:
+            case Opcode::SUBTRACT_INT_RK:
+            case Opcode::MULTIPLY_INT_RK:
+            case Opcode::DIVIDE_INT_RK:
+            case Opcode::MODULO_INT_RK:
+            case Opcode::ADD_FLOAT_RK:
+            case Opcode::SUBTRACT_FLOAT_RK:
+            case Opcode::MULTIPLY_FLOAT_RK:
+            case Opcode::DIVIDE_FLOAT_RK:
+                return { .a = R, .b = R, .c = K };
+            case Opcode::SUBTRACT_INT_KR:
+            case Opcode::DIVIDE_INT_KR:
+            case Opcode::MODULO_INT_KR:
+            case Opcode::SUBTRACT_FLOAT_KR:
+            case Opcode::DIVIDE_FLOAT_KR:
+                return { .a = R, .b = K, .c = R };
+            case Opcode::ADD_INT_RI:
+            case Opcode::SUBTRACT_INT_RI:
+            case Opcode::MULTIPLY_INT_RI:
+            case Opcode::SHIFT_LEFT_INT_RI:
+            case Opcode::SHIFT_RIGHT_INT_RI:
+                return { .a = R, .b = R, .c = I };
+            case Opcode::AND_INT_RK:
+            case Opcode::DIVIDE_INT_MAGIC:
+            case Opcode::MODULO_INT_MAGIC:
+                return { .a = R, .b = R, .c = K };
+            case Opcode::FMA_FLOAT:
+            case Opcode::DIVIDE_INT_NOCHECK:
+            case Opcode::MODULO_INT_NOCHECK:
+                return { .a = R, .b = R, .c = R };
+            case Opcode::RETURN_CONSTANT:
+                return { .d = K };
+        }
+        return {};
+    }
+
+    constexpr bool reads_op_a(Opcode opcode)
+    {
+        return opcode == Opcode::RETURN_VALUE || opcode == Opcode::FMA_FLOAT;
+    }
+
+    // Byte-aligned instruction layout, from the least significant byte:
+    //
+    //  | opcode |   A    |   B    |   C    |
+    //  | opcode |   A    |        D        |
+    //  | opcode |          long            |
     class Instruction
     {
     public:
-        static constexpr std::uint32_t OPCODE_BIT_WIDTH = 6;
-        static constexpr std::uint32_t OP_A_BIT_WIDTH = 13;
-        static constexpr std::uint32_t OP_B_BIT_WIDTH = 13;
-        static constexpr std::uint32_t OP_LONG_BIT_WIDTH = 26;
-        static_assert(OPCODE_BIT_WIDTH + OP_A_BIT_WIDTH + OP_B_BIT_WIDTH == sizeof(std::uint32_t) * 8);
+        static constexpr std::uint32_t OPCODE_BIT_WIDTH = 8;
+        static constexpr std::uint32_t OP_A_BIT_WIDTH = 8;
+        static constexpr std::uint32_t OP_B_BIT_WIDTH = 8;
+        static constexpr std::uint32_t OP_C_BIT_WIDTH = 8;
+        static constexpr std::uint32_t OP_D_BIT_WIDTH = OP_B_BIT_WIDTH + OP_C_BIT_WIDTH;
+        static constexpr std::uint32_t OP_LONG_BIT_WIDTH = OP_A_BIT_WIDTH + OP_D_BIT_WIDTH;
+        static_assert(OPCODE_BIT_WIDTH + OP_A_BIT_WIDTH + OP_B_BIT_WIDTH + OP_C_BIT_WIDTH == sizeof(std::uint32_t) * 8);
         static_assert(OPCODE_BIT_WIDTH + OP_LONG_BIT_WIDTH == sizeof(std::uint32_t) * 8);
 
-        static constexpr std::uint32_t OPCODE_SHIFT = sizeof(std::uint32_t) * 8 - OPCODE_BIT_WIDTH;
-        static constexpr std::uint32_t OP_A_SHIFT = sizeof(std::uint32_t) * 8 - OPCODE_BIT_WIDTH - OP_A_BIT_WIDTH;
-        static constexpr std::uint32_t OP_B_SHIFT = sizeof(std::uint32_t) * 8 - OPCODE_BIT_WIDTH - OP_A_BIT_WIDTH - OP_B_BIT_WIDTH;
-        static constexpr std::uint32_t OP_LONG_SHIFT = sizeof(std::uint32_t) * 8 - OPCODE_BIT_WIDTH - OP_LONG_BIT_WIDTH;
+        static constexpr std::uint32_t OPCODE_SHIFT = 0;
+        static constexpr std::uint32_t OP_A_SHIFT = OPCODE_SHIFT + OPCODE_BIT_WIDTH;
+        static constexpr std::uint32_t OP_B_SHIFT = OP_A_SHIFT + OP_A_BIT_WIDTH;
+        static constexpr std::uint32_t OP_C_SHIFT = OP_B_SHIFT + OP_B_BIT_WIDTH;
+        static constexpr std::uint32_t OP_D_SHIFT = OP_B_SHIFT;
+        static constexpr std::uint32_t OP_LONG_SHIFT = OP_A_SHIFT;
 
         static constexpr std::uint32_t OPCODE_MASK = filled_by_ones(OPCODE_BIT_WIDTH) << OPCODE_SHIFT;
         static constexpr std::uint32_t OP_A_MASK = filled_by_ones(OP_A_BIT_WIDTH) << OP_A_SHIFT;
         static constexpr std::uint32_t OP_B_MASK = filled_by_ones(OP_B_BIT_WIDTH) << OP_B_SHIFT;
+        static constexpr std::uint32_t OP_C_MASK = filled_by_ones(OP_C_BIT_WIDTH) << OP_C_SHIFT;
+        static constexpr std::uint32_t OP_D_MASK = filled_by_ones(OP_D_BIT_WIDTH) << OP_D_SHIFT;
         static constexpr std::uint32_t OP_LONG_MASK = filled_by_ones(OP_LONG_BIT_WIDTH) << OP_LONG_SHIFT;
 
+        static constexpr std::uint32_t MAX_OP_A = filled_by_ones(OP_A_BIT_WIDTH);
+        static constexpr std::uint32_t MAX_OP_B = filled_by_ones(OP_B_BIT_WIDTH);
+        static constexpr std::uint32_t MAX_OP_C = filled_by_ones(OP_C_BIT_WIDTH);
+        static constexpr std::uint32_t MAX_OP_D = filled_by_ones(OP_D_BIT_WIDTH);
+        static constexpr std::uint32_t MAX_OP_LONG = filled_by_ones(OP_LONG_BIT_WIDTH);
+
+        static constexpr std::int32_t MIN_OP_SC = -(1 << (OP_C_BIT_WIDTH - 1));
+        static constexpr std::int32_t MAX_OP_SC = (1 << (OP_C_BIT_WIDTH - 1)) - 1;
+
         constexpr Instruction()
             : m_instruction(0)
         {
@@ -66,11 +260,21 @@ namespace wf
         {
         }
 
-        constexpr Instruction(Opcode opcode, std::uint32_t op_a, std::uint32_t op_b)
+        constexpr Instruction(Opcode opcode, std::uint32_t op_a, std::uint32_t op_b, std::uint32_t op_c)
             : m_instruction(
                 (static_cast<std::uint32_t>(opcode) << OPCODE_SHIFT)
                     | (op_a << OP_A_SHIFT)
                     | (op_b << OP_B_SHIFT)
+                    | (op_c << OP_C_SHIFT)
+            )
+        {
+        }
+
+        constexpr Instruction(Opcode opcode, std::uint32_t op_a, std::uint32_t op_d)
+            : m_instruction(
+                (static_cast<std::uint32_t>(opcode) << OPCODE_SHIFT)
+                    | (op_a << OP_A_SHIFT)
+                    | (op_d << OP_D_SHIFT)
             )
         {
         }
@@ -85,7 +289,7 @@ namespace wf
 
         constexpr Opcode get_opcode() const noexcept
         {
-            return Opcode{ (m_instruction & OPCODE_MASK) >> OPCODE_SHIFT };
+            return Opcode{ static_cast<std::uint8_t>((m_instruction & OPCODE_MASK) >> OPCODE_SHIFT) };
         }
 
         constexpr std::uint32_t get_op_a() const noexcept
@@ -98,6 +302,22 @@ namespace wf
             return (m_instruction & OP_B_MASK) >> OP_B_SHIFT;
         }
 
+        constexpr std::uint32_t get_op_c() const noexcept
+        {
+            return (m_instruction & OP_C_MASK) >> OP_C_SHIFT;
+        }
+
+        // C interpreted as a two's complement immediate.
+        constexpr std::int32_t get_op_sc() const noexcept
+        {
+            return static_cast<std::int8_t>(get_op_c());
+        }
+
+        constexpr std::uint32_t get_op_d() const noexcept
+        {
+            return (m_instruction & OP_D_MASK) >> OP_D_SHIFT;
+        }
+
         constexpr std::uint32_t get_op_long() const noexcept
         {
             return (m_instruction & OP_LONG_MASK) >> OP_LONG_SHIFT;
@@ -106,6 +326,114 @@ namespace wf
     private:
         std::uint32_t m_instruction;
     };
+
+    // An instruction preceded by a WIDE prefix. The operand bytes of the prefix are the high bytes of the
+    // operands of the instruction that follows it:
+    //
+    //  |  WIDE  | A high | B high | C high |
+    //  |  WIDE  | A high |     D high      |
+    //  |  WIDE  |long hi |     unused      |
+    //
+    // Only instructions whose operands do not fit the regular layout are prefixed.
+    class WideInstruction
+    {
+    public:
+        static constexpr std::uint32_t MAX_OP_A = (Instruction::MAX_OP_A << Instruction::OP_A_BIT_WIDTH) | Instruction::MAX_OP_A;
+        static constexpr std::uint32_t MAX_OP_B = (Instruction::MAX_OP_B << Instruction::OP_B_BIT_WIDTH) | Instruction::MAX_OP_B;
+        static constexpr std::uint32_t MAX_OP_C = (Instruction::MAX_OP_C << Instruction::OP_C_BIT_WIDTH) | Instruction::MAX_OP_C;
+        static constexpr std::uint32_t MAX_OP_D = (Instruction::MAX_OP_D << Instruction::OP_D_BIT_WIDTH) | Instruction::MAX_OP_D;
+        static constexpr std::uint32_t MAX_OP_LONG
+            = (Instruction::MAX_OP_A << Instruction::OP_LONG_BIT_WIDTH) | Instruction::MAX_OP_LONG;
+
+        static constexpr std::int32_t MIN_OP_SC = -(1 << (Instruction::OP_C_BIT_WIDTH * 2 - 1));
+        static constexpr std::int32_t MAX_OP_SC = (1 << (Instruction::OP_C_BIT_WIDTH * 2 - 1)) - 1;
+
+        // Decodes an instruction that has no prefix.
+        constexpr explicit WideInstruction(Instruction instruction)
+            : m_prefix(Opcode::WIDE), m_instruction(instruction), m_is_wide(false)
+        {
+        }
+
+        constexpr WideInstruction(Instruction prefix, Instruction instruction)
+            : m_prefix(prefix), m_instruction(instruction), m_is_wide(true)
+        {
+        }
+
+        // Decodes the instruction at `index` together with its prefix, if any, and leaves `index` at the instruction.
+        // A prefix at the end of the code decodes as an instruction of its own.
+        static constexpr WideInstruction decode(std::span<const Instruction> code, std::size_t& index)
+        {
+            if(code[index].get_opcode() == Opcode::WIDE && index + 1 < code.size())
+            {
+                index++;
+                return WideInstruction(code[index - 1], code[index]);
+            }
+            return WideInstruction(code[index]);
+        }
+
+        // Splits operands into a prefix and the instruction following it.
+        static constexpr Instruction make_prefix(std::uint32_t op_a, std::uint32_t op_b, std::uint32_t op_c)
+        {
+            return Instruction(Opcode::WIDE, op_a >> Instruction::OP_A_BIT_WIDTH, op_b >> Instruction::OP_B_BIT_WIDTH,
+                op_c >> Instruction::OP_C_BIT_WIDTH);
+        }
+
+        static constexpr Instruction make_prefix(std::uint32_t op_a, std::uint32_t op_d)
+        {
+            return Instruction(Opcode::WIDE, op_a >> Instruction::OP_A_BIT_WIDTH, op_d >> Instruction::OP_D_BIT_WIDTH);
+        }
+
+        static constexpr Instruction make_prefix(std::uint32_t op_long)
+        {
+            return Instruction(Opcode::WIDE, op_long >> Instruction::OP_LONG_BIT_WIDTH, 0, 0);
+        }
+
+        constexpr Opcode get_opcode() const noexcept
+        {
+            return m_instruction.get_opcode();
+        }
+
+        constexpr bool is_wide() const noexcept
+        {
+            return m_is_wide;
+        }
+
+        constexpr std::uint32_t get_op_a() const noexcept
+        {
+            return m_instruction.get_op_a() | (m_prefix.get_op_a() << Instruction::OP_A_BIT_WIDTH);
+        }
+
+        constexpr std::uint32_t get_op_b() const noexcept
+        {
+            return m_instruction.get_op_b() | (m_prefix.get_op_b() << Instruction::OP_B_BIT_WIDTH);
+        }
+
+        constexpr std::uint32_t get_op_c() const noexcept
+        {
+            return m_instruction.get_op_c() | (m_prefix.get_op_c() << Instruction::OP_C_BIT_WIDTH);
+        }
+
+        // Only prefixed instructions sign extend C from its full width, like the Vm reads them.
+        constexpr std::int32_t get_op_sc() const noexcept
+        {
+            return m_is_wide? static_cast<std::int16_t>(get_op_c()) : m_instruction.get_op_sc();
+        }
+
+        constexpr std::uint32_t get_op_d() const noexcept
+        {
+            return m_instruction.get_op_d() | (m_prefix.get_op_d() << Instruction::OP_D_BIT_WIDTH);
+        }
+
+        constexpr std::uint32_t get_op_long() const noexcept
+        {
+            return m_instruction.get_op_long() | (m_prefix.get_op_a() << Instruction::OP_LONG_BIT_WIDTH);
+        }
+
+    private:
+        Instruction m_prefix;
+        Instruction m_instruction;
+        bool m_is_wide;
+    };
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,524 @@
+#include "Jit.hpp"
+
+#include <cstring>
+#include <optional>
+
+#include "Object.hpp"
+#include "Utils/Array.hpp"
+
+#if defined(WF_JIT_X86_64)
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+namespace wf
+{
+#if defined(WF_JIT_X86_64)
+    // Template code generator: every instruction is translated to a fixed sequence that works on the frame
+    // in memory. The frame is addressed through rdi and the constants through rsi, the return slot is kept in
+    // r8 since rdx is clobbered by divisions. Integer results go through rax and float results through xmm0,
+    // which also remember the register they were last loaded from or stored to, so that a chain of
+    // instructions does not reload the value it just produced.
+    class X64Emitter
+    {
+    public:
+        enum class Base : std::uint8_t
+        {
+            FRAME = 7, // rdi
+            CONSTANTS = 6, // rsi
+        };
+
+        enum Register : std::uint8_t
+        {
+            RAX = 0, RCX = 1,
+        };
+
+        struct Operand
+        {
+            Base base;
+            std::uint32_t index;
+        };
+
+        X64Emitter(State* state)
+            : m_code(state)
+        {
+        }
+
+        DynamicArray<std::uint8_t>& get_code() { return m_code; }
+
+        void emit_prologue()
+        {
+            emit({ 0x49, 0x89, 0xD0 }); // mov r8, rdx
+        }
+
+        void emit_return(std::optional<Operand> value)
+        {
+            if(value.has_value())
+            {
+                load_int(value.value());
+                emit({ 0x49, 0x89, 0x00 }); // mov [r8], rax
+            }
+            emit({ 0x31, 0xC0, 0xC3 }); // xor eax, eax; ret
+        }
+
+        void emit_move(std::uint32_t destination, Operand source)
+        {
+            load_int(source);
+            store_int(destination);
+        }
+
+        // op rax, qword [operand] with a REX.W opcode.
+        void emit_int_op(std::initializer_list<std::uint8_t> opcode, std::uint32_t destination,
+                Operand left, Operand right)
+        {
+            load_int(left);
+            emit_memory_op(opcode, RAX, right);
+            m_rax_register.reset();
+            store_int(destination);
+        }
+
+        // op rax, imm32 with a REX.W opcode.
+        void emit_int_immediate_op(std::initializer_list<std::uint8_t> opcode, std::uint32_t destination,
+                Operand left, std::int32_t immediate)
+        {
+            load_int(left);
+            emit(opcode);
+            emit_u32(static_cast<std::uint32_t>(immediate));
+            m_rax_register.reset();
+            store_int(destination);
+        }
+
+        // Without `check_divisor` the divisor is known not to be 0, like that of divisions without a check.
+        void emit_int_division(bool is_modulo, std::uint32_t destination, Operand left, Operand right,
+                std::optional<UInt> constant_divisor, std::size_t next_offset, bool check_divisor = true)
+        {
+            if(constant_divisor.has_value() && constant_divisor.value() == 0)
+            {
+                emit_error_return(next_offset);
+                return;
+            }
+
+            load_int(left);
+            emit_memory_op({ 0x48, 0x8B }, RCX, right); // mov rcx, [right]
+            if(check_divisor && !constant_divisor.has_value())
+            {
+                emit({ 0x48, 0x85, 0xC9 }); // test rcx, rcx
+                emit({ 0x75, 0x06 }); // jnz over the error return
+                emit_error_return(next_offset);
+            }
+
+            emit({ 0x31, 0xD2 }); // xor edx, edx
+            emit({ 0x48, 0xF7, 0xF1 }); // div rcx
+            if(is_modulo)
+            {
+                emit({ 0x48, 0x89, 0xD0 }); // mov rax, rdx
+            }
+            m_rax_register.reset();
+            store_int(destination);
+        }
+
+        // shl or shr rax, imm8, selected by the ModRM reg field of C1.
+        void emit_int_shift(std::uint8_t operation, std::uint32_t destination, Operand left, std::uint32_t shift)
+        {
+            load_int(left);
+            const std::uint8_t modrm = static_cast<std::uint8_t>(0xC0 | (operation << 3));
+            emit({ 0x48, 0xC1, modrm, static_cast<std::uint8_t>(shift & 63) });
+            m_rax_register.reset();
+            store_int(destination);
+        }
+
+        // Division by a constant through its magic number, see divide_by_magic().
+        void emit_int_magic_division(bool is_modulo, std::uint32_t destination, Operand left, Operand divisor,
+                Operand magic, std::uint32_t shift)
+        {
+            load_int(left);
+            emit({ 0x48, 0x89, 0xC1 }); // mov rcx, rax
+            emit_memory_op({ 0x48, 0xF7 }, 4, magic); // mul qword [magic]
+            emit({ 0x48, 0x89, 0xC8 }); // mov rax, rcx
+            emit({ 0x48, 0x29, 0xD0 }); // sub rax, rdx
+            emit({ 0x48, 0xD1, 0xE8 }); // shr rax, 1
+            emit({ 0x48, 0x01, 0xD0 }); // add rax, rdx
+            emit({ 0x48, 0xC1, 0xE8, static_cast<std::uint8_t>(shift) }); // shr rax, shift
+            if(is_modulo)
+            {
+                emit_memory_op({ 0x48, 0x0F, 0xAF }, RAX, divisor); // imul rax, [divisor]
+                emit({ 0x48, 0x29, 0xC1 }); // sub rcx, rax
+                emit({ 0x48, 0x89, 0xC8 }); // mov rax, rcx
+            }
+            m_rax_register.reset();
+            store_int(destination);
+        }
+
+        void emit_int_negation(std::uint32_t destination, Operand operand)
+        {
+            load_int(operand);
+            emit({ 0x48, 0xF7, 0xD8 }); // neg rax
+            m_rax_register.reset();
+            store_int(destination);
+        }
+
+        void emit_float_negation(std::uint32_t destination, Operand operand)
+        {
+            load_int(operand);
+            emit({ 0x48, 0x0F, 0xBA, 0xF8, 0x3F }); // btc rax, 63
+            m_rax_register.reset();
+            store_int(destination);
+        }
+
+        // op xmm0, qword [operand] with an F2-prefixed SSE2 opcode.
+        void emit_float_op(std::uint8_t opcode, std::uint32_t destination, Operand left, Operand right)
+        {
+            load_float(left);
+            emit_memory_op({ 0xF2, 0x0F, opcode }, 0, right);
+            m_xmm0_register.reset();
+            store_float(destination);
+        }
+
+        // Needs a CPU with FMA3, see has_fma().
+        void emit_float_fma(std::uint32_t destination, Operand left, Operand right)
+        {
+            load_float(frame(destination));
+            emit_memory_op({ 0xF2, 0x0F, 0x10 }, 1, left); // movsd xmm1, [left]
+            emit_memory_op({ 0xC4, 0xE2, 0xF1, 0xB9 }, 0, right); // vfmadd231sd xmm0, xmm1, [right]
+            m_xmm0_register.reset();
+            store_float(destination);
+        }
+
+        static bool has_fma()
+        {
+            return __builtin_cpu_supports("fma");
+        }
+
+        void emit_int_to_float(std::uint32_t destination, Operand operand)
+        {
+            emit({ 0x66, 0x0F, 0xEF, 0xC0 }); // pxor xmm0, xmm0
+            emit_memory_op({ 0xF2, 0x48, 0x0F, 0x2A }, 0, operand); // cvtsi2sd xmm0, [operand]
+            m_xmm0_register.reset();
+            store_float(destination);
+        }
+
+        void emit_float_to_int(std::uint32_t destination, Operand operand)
+        {
+            emit_memory_op({ 0xF2, 0x48, 0x0F, 0x2C }, RAX, operand); // cvttsd2si rax, [operand]
+            m_rax_register.reset();
+            store_int(destination);
+        }
+
+        static Operand frame(std::uint32_t index) { return { Base::FRAME, index }; }
+        static Operand constant(std::uint32_t index) { return { Base::CONSTANTS, index }; }
+    private:
+        DynamicArray<std::uint8_t> m_code;
+        std::optional<std::uint32_t> m_rax_register;
+        std::optional<std::uint32_t> m_xmm0_register;
+
+        void emit(std::initializer_list<std::uint8_t> bytes)
+        {
+            m_code.insert(m_code.end(), bytes.begin(), bytes.end());
+        }
+
+        void emit_u32(std::uint32_t value)
+        {
+            for(std::uint32_t i = 0; i < 4; i++)
+            {
+                m_code.push_back(static_cast<std::uint8_t>(value >> (i * 8)));
+            }
+        }
+
+        // Emits the opcode followed by a ModRM byte addressing [base + index * 8].
+        void emit_memory_op(std::initializer_list<std::uint8_t> opcode, std::uint8_t reg, Operand operand)
+        {
+            emit(opcode);
+
+            const std::uint32_t displacement = operand.index * sizeof(Value);
+            const std::uint8_t modrm_reg_rm = static_cast<std::uint8_t>((reg << 3) | static_cast<std::uint8_t>(operand.base));
+            if(displacement <= 0x7F)
+            {
+                m_code.push_back(static_cast<std::uint8_t>(0x40 | modrm_reg_rm));
+                m_code.push_back(static_cast<std::uint8_t>(displacement));
+            }
+            else
+            {
+                m_code.push_back(static_cast<std::uint8_t>(0x80 | modrm_reg_rm));
+                emit_u32(displacement);
+            }
+        }
+
+        void emit_error_return(std::size_t next_offset)
+        {
+            m_code.push_back(0xB8); // mov eax, imm32
+            emit_u32(static_cast<std::uint32_t>(next_offset));
+            m_code.push_back(0xC3); // ret
+        }
+
+        void load_int(Operand operand)
+        {
+            if(operand.base == Base::FRAME && m_rax_register == operand.index) return;
+
+            emit_memory_op({ 0x48, 0x8B }, RAX, operand); // mov rax, [operand]
+            m_rax_register.reset();
+            if(operand.base == Base::FRAME) m_rax_register = operand.index;
+        }
+
+        void store_int(std::uint32_t destination)
+        {
+            emit_memory_op({ 0x48, 0x89 }, RAX, frame(destination)); // mov [destination], rax
+            m_rax_register = destination;
+            if(m_xmm0_register == destination) m_xmm0_register.reset();
+        }
+
+        void load_float(Operand operand)
+        {
+            if(operand.base == Base::FRAME && m_xmm0_register == operand.index) return;
+
+            emit_memory_op({ 0xF2, 0x0F, 0x10 }, 0, operand); // movsd xmm0, [operand]
+            m_xmm0_register.reset();
+            if(operand.base == Base::FRAME) m_xmm0_register = operand.index;
+        }
+
+        void store_float(std::uint32_t destination)
+        {
+            emit_memory_op({ 0xF2, 0x0F, 0x11 }, 0, frame(destination)); // movsd [destination], xmm0
+            m_xmm0_register = destination;
+            if(m_rax_register == destination) m_rax_register.reset();
+        }
+    };
+
+    static bool jit_translate(X64Emitter& emitter, const BytecodeObject* function)
+    {
+        using Operand = X64Emitter::Operand;
+
+        const std::initializer_list<std::uint8_t> ADD_RAX_MEMORY = { 0x48, 0x03 };
+        const std::initializer_list<std::uint8_t> SUB_RAX_MEMORY = { 0x48, 0x2B };
+        const std::initializer_list<std::uint8_t> IMUL_RAX_MEMORY = { 0x48, 0x0F, 0xAF };
+        const std::initializer_list<std::uint8_t> AND_RAX_MEMORY = { 0x48, 0x23 };
+        const std::initializer_list<std::uint8_t> ADD_RAX_IMMEDIATE = { 0x48, 0x05 };
+        const std::initializer_list<std::uint8_t> SUB_RAX_IMMEDIATE = { 0x48, 0x2D };
+        const std::initializer_list<std::uint8_t> IMUL_RAX_IMMEDIATE = { 0x48, 0x69, 0xC0 };
+        const std::uint8_t SHL = 4;
+        const std::uint8_t SHR = 5;
+        const std::uint8_t ADDSD = 0x58;
+        const std::uint8_t MULSD = 0x59;
+        const std::uint8_t SUBSD = 0x5C;
+        const std::uint8_t DIVSD = 0x5E;
+
+        const std::span<const Instruction> code = function->code;
+        auto frame = X64Emitter::frame;
+        auto constant = X64Emitter::constant;
+        auto constant_int = [function](std::uint32_t index) -> std::optional<UInt> {
+            return function->constants[index].as_int;
+        };
+
+        emitter.emit_prologue();
+        for(std::size_t i = 0; i < code.size(); i++)
+        {
+            const WideInstruction instruction = WideInstruction::decode(code, i);
+            const std::size_t next_offset = i + 1;
+            const std::uint32_t a = instruction.get_op_a();
+            const Operand b = frame(instruction.get_op_b());
+            const Operand c = frame(instruction.get_op_c());
+            const Operand kb = constant(instruction.get_op_b());
+            const Operand kc = constant(instruction.get_op_c());
+
+            switch(instruction.get_opcode())
+            {
+                // The caller reserves the whole frame before entering.
+                case Opcode::NO_OP:
+                case Opcode::WIDE:
+                case Opcode::RESERVE:
+                    break;
+                case Opcode::RETURN:
+                    emitter.emit_return(std::nullopt);
+                    break;
+                case Opcode::RETURN_VALUE:
+                    emitter.emit_return(frame(a));
+                    break;
+                case Opcode::RETURN_CONSTANT:
+                    emitter.emit_return(constant(instruction.get_op_d()));
+                    break;
+                case Opcode::MOVE:
+                    emitter.emit_move(a, frame(instruction.get_op_d()));
+                    break;
+                case Opcode::LOAD_CONSTANT:
+                    emitter.emit_move(a, constant(instruction.get_op_d()));
+                    break;
+                case Opcode::NEGATION_INT:
+                    emitter.emit_int_negation(a, frame(instruction.get_op_d()));
+                    break;
+                case Opcode::NEGATION_FLOAT:
+                    emitter.emit_float_negation(a, frame(instruction.get_op_d()));
+                    break;
+                case Opcode::INT_TO_FLOAT:
+                    emitter.emit_int_to_float(a, frame(instruction.get_op_d()));
+                    break;
+                case Opcode::FLOAT_TO_INT:
+                    emitter.emit_float_to_int(a, frame(instruction.get_op_d()));
+                    break;
+                case Opcode::ADD_INT:
+                    emitter.emit_int_op(ADD_RAX_MEMORY, a, b, c);
+                    break;
+                case Opcode::SUBTRACT_INT:
+                    emitter.emit_int_op(SUB_RAX_MEMORY, a, b, c);
+                    break;
+                case Opcode::MULTIPLY_INT:
+                    emitter.emit_int_op(IMUL_RAX_MEMORY, a, b, c);
+                    break;
+                case Opcode::DIVIDE_INT:
+                    emitter.emit_int_division(false, a, b, c, std::nullopt, next_offset);
+                    break;
+                case Opcode::MODULO_INT:
+                    emitter.emit_int_division(true, a, b, c, std::nullopt, next_offset);
+                    break;
+                case Opcode::ADD_FLOAT:
+                    emitter.emit_float_op(ADDSD, a, b, c);
+                    break;
+                case Opcode::SUBTRACT_FLOAT:
+                    emitter.emit_float_op(SUBSD, a, b, c);
+                    break;
+                case Opcode::MULTIPLY_FLOAT:
+                    emitter.emit_float_op(MULSD, a, b, c);
+                    break;
+                case Opcode::DIVIDE_FLOAT:
+                    emitter.emit_float_op(DIVSD, a, b, c);
+                    break;
+                case Opcode::ADD_INT_RK:
+                    emitter.emit_int_op(ADD_RAX_MEMORY, a, b, kc);
+                    break;
+                case Opcode::SUBTRACT_INT_RK:
+                    emitter.emit_int_op(SUB_RAX_MEMORY, a, b, kc);
+                    break;
+                case Opcode::MULTIPLY_INT_RK:
+                    emitter.emit_int_op(IMUL_RAX_MEMORY, a, b, kc);
+                    break;
+                case Opcode::DIVIDE_INT_RK:
+                    emitter.emit_int_division(false, a, b, kc, constant_int(instruction.get_op_c()), next_offset);
+                    break;
+                case Opcode::MODULO_INT_RK:
+                    emitter.emit_int_division(true, a, b, kc, constant_int(instruction.get_op_c()), next_offset);
+                    break;
+                case Opcode::ADD_FLOAT_RK:
+                    emitter.emit_float_op(ADDSD, a, b, kc);
+                    break;
+                case Opcode::SUBTRACT_FLOAT_RK:
+                    emitter.emit_float_op(SUBSD, a, b, kc);
+                    break;
+                case Opcode::MULTIPLY_FLOAT_RK:
+                    emitter.emit_float_op(MULSD, a, b, kc);
+                    break;
+                case Opcode::DIVIDE_FLOAT_RK:
+                    emitter.emit_float_op(DIVSD, a, b, kc);
+                    break;
+                case Opcode::SUBTRACT_INT_KR:
+                    emitter.emit_int_op(SUB_RAX_MEMORY, a, kb, c);
+                    break;
+                case Opcode::DIVIDE_INT_KR:
+                    emitter.emit_int_division(false, a, kb, c, std::nullopt, next_offset);
+                    break;
+                case Opcode::MODULO_INT_KR:
+                    emitter.emit_int_division(true, a, kb, c, std::nullopt, next_offset);
+                    break;
+                case Opcode::SUBTRACT_FLOAT_KR:
+                    emitter.emit_float_op(SUBSD, a, kb, c);
+                    break;
+                case Opcode::DIVIDE_FLOAT_KR:
+                    emitter.emit_float_op(DIVSD, a, kb, c);
+                    break;
+                case Opcode::ADD_INT_RI:
+                    emitter.emit_int_immediate_op(ADD_RAX_IMMEDIATE, a, b, instruction.get_op_sc());
+                    break;
+                case Opcode::SUBTRACT_INT_RI:
+                    emitter.emit_int_immediate_op(SUB_RAX_IMMEDIATE, a, b, instruction.get_op_sc());
+                    break;
+                case Opcode::MULTIPLY_INT_RI:
+                    emitter.emit_int_immediate_op(IMUL_RAX_IMMEDIATE, a, b, instruction.get_op_sc());
+                    break;
+                case Opcode::SHIFT_LEFT_INT_RI:
+                    emitter.emit_int_shift(SHL, a, b, instruction.get_op_c());
+                    break;
+                case Opcode::SHIFT_RIGHT_INT_RI:
+                    emitter.emit_int_shift(SHR, a, b, instruction.get_op_c());
+                    break;
+                case Opcode::AND_INT_RK:
+                    emitter.emit_int_op(AND_RAX_MEMORY, a, b, kc);
+                    break;
+                case Opcode::DIVIDE_INT_MAGIC:
+                case Opcode::MODULO_INT_MAGIC:
+                    emitter.emit_int_magic_division(instruction.get_opcode() == Opcode::MODULO_INT_MAGIC, a, b, kc,
+                        constant(instruction.get_op_c() + 1),
+                        get_division_magic_shift(function->constants[instruction.get_op_c()].as_int));
+                    break;
+                case Opcode::FMA_FLOAT:
+                    if(!X64Emitter::has_fma()) return false;
+                    emitter.emit_float_fma(a, b, c);
+                    break;
+                case Opcode::DIVIDE_INT_NOCHECK:
+                    emitter.emit_int_division(false, a, b, c, std::nullopt, next_offset, false);
+                    break;
+                case Opcode::MODULO_INT_NOCHECK:
+                    emitter.emit_int_division(true, a, b, c, std::nullopt, next_offset, false);
+                    break;
+                default:
+                    return false;
+            }
+        }
+
+        // Falling off the end of the code behaves like RETURN.
+        emitter.emit_return(std::nullopt);
+        return true;
+    }
+
+    void jit_compile(State* state, BytecodeObject* function)
+    {
+        JitCode& jit_code = function->jit_code;
+        X64Emitter emitter(state);
+
+        if(!jit_translate(emitter, function))
+        {
+            jit_code.status = JitStatus::UNSUPPORTED;
+            return;
+        }
+
+        const DynamicArray<std::uint8_t>& code = emitter.get_code();
+        const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const std::size_t memory_size = (code.size() + page_size - 1) / page_size * page_size;
+
+        void* memory = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED)
+        {
+            jit_code.status = JitStatus::UNSUPPORTED;
+            return;
+        }
+
+        std::memcpy(memory, code.data(), code.size());
+        if(mprotect(memory, memory_size, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(memory, memory_size);
+            jit_code.status = JitStatus::UNSUPPORTED;
+            return;
+        }
+
+        jit_code.status = JitStatus::COMPILED;
+        jit_code.entry = reinterpret_cast<JitEntry>(memory);
+        jit_code.memory = memory;
+        jit_code.memory_size = memory_size;
+    }
+
+    void jit_release(JitCode& code)
+    {
+        if(code.memory != nullptr)
+        {
+            munmap(code.memory, code.memory_size);
+        }
+        code = JitCode();
+    }
+#else
+    void jit_compile(State*, BytecodeObject* function)
+    {
+        function->jit_code.status = JitStatus::UNSUPPORTED;
+    }
+
+    void jit_release(JitCode& code)
+    {
+        code = JitCode();
+    }
+#endif
+}
\ No newline at end of file
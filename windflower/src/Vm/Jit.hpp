@@ -0,0 +1,49 @@
+#ifndef WF_JIT_HPP
+#define WF_JIT_HPP
+
+#include <cstddef>
+
+#include "Value.hpp"
+
+// The baseline JIT emits System V x86-64 code into mmap'd memory.
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+    #define WF_JIT_X86_64
+#endif
+
+namespace wf
+{
+    // Entry point of a natively compiled function. RETURN_VALUE stores its operand into `return_slot`.
+    // Returns 0, or the code offset following an integer division by zero so that the caller can raise
+    // the error through Vm::error().
+    using JitEntry = std::size_t(*)(Value* frame, const Value* constants, Value* return_slot);
+
+    enum class JitStatus
+    {
+        NOT_COMPILED, COMPILED, UNSUPPORTED,
+    };
+
+    struct JitCode
+    {
+        JitStatus status = JitStatus::NOT_COMPILED;
+        JitEntry entry = nullptr;
+
+        void* memory = nullptr;
+        std::size_t memory_size = 0;
+    };
+
+    constexpr bool is_jit_supported()
+    {
+#if defined(WF_JIT_X86_64)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Compiles `function` to native code. Functions using instructions the JIT does not handle, or any
+    // function on an unsupported platform, are marked JitStatus::UNSUPPORTED and keep being interpreted.
+    void jit_compile(State* state, BytecodeObject* function);
+    void jit_release(JitCode& code);
+}
+
+#endif
\ No newline at end of file
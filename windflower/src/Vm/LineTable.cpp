@@ -0,0 +1,115 @@
+#include "LineTable.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace wf
+{
+    static void write_varint(DynamicArray<std::uint8_t>& data, std::uint64_t value)
+    {
+        while(value >= 0x80)
+        {
+            data.push_back(static_cast<std::uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        data.push_back(static_cast<std::uint8_t>(value));
+    }
+
+    std::uint32_t LineTable::get_line(std::size_t offset) const
+    {
+        const auto checkpoint = std::upper_bound(checkpoints.begin(), checkpoints.end(), offset,
+            [](std::size_t offset, const LineTableCheckpoint& checkpoint) { return offset < checkpoint.offset; });
+        // The first entry has a checkpoint, so no entry precedes the offset.
+        if(checkpoint == checkpoints.begin()) return 0;
+
+        LineTableReader reader(*this, checkpoint[-1]);
+        std::uint32_t line = checkpoint[-1].line;
+        BytecodeLineInfo entry;
+        while(reader.next(entry) && entry.offset <= offset)
+        {
+            line = entry.line;
+        }
+        return line;
+    }
+
+    bool LineTable::is_valid(std::size_t code_size) const
+    {
+        LineTableReader reader(*this);
+        std::size_t entry_count = 0;
+        BytecodeLineInfo entry;
+        for(std::uint32_t previous_offset = 0; reader.next(entry); previous_offset = entry.offset, entry_count++)
+        {
+            if(entry.offset >= code_size || (entry_count != 0 && entry.offset <= previous_offset)) return false;
+
+            if(entry_count % CHECKPOINT_INTERVAL != 0) continue;
+
+            const std::size_t checkpoint = entry_count / CHECKPOINT_INTERVAL;
+            if(checkpoint >= checkpoints.size() || checkpoints[checkpoint].offset != entry.offset
+                || checkpoints[checkpoint].line != entry.line
+                || checkpoints[checkpoint].data_offset != reader.get_position())
+            {
+                return false;
+            }
+        }
+
+        return reader.is_at_end()
+            && checkpoints.size() == (entry_count + CHECKPOINT_INTERVAL - 1) / CHECKPOINT_INTERVAL;
+    }
+
+    bool LineTableReader::next(BytecodeLineInfo& entry)
+    {
+        std::uint64_t offset_delta = 0;
+        std::uint64_t line_delta = 0;
+        if(!read_varint(offset_delta) || !read_varint(line_delta)) return false;
+        if(offset_delta > std::numeric_limits<std::uint32_t>::max() - m_previous.offset) return false;
+
+        // Lines wrap around like the subtraction that encoded them.
+        const std::uint64_t line_difference = (line_delta >> 1) ^ (0 - (line_delta & 1));
+        m_previous = {
+            .offset = static_cast<std::uint32_t>(m_previous.offset + offset_delta),
+            .line = static_cast<std::uint32_t>(m_previous.line + line_difference)
+        };
+        entry = m_previous;
+        return true;
+    }
+
+    bool LineTableReader::read_varint(std::uint64_t& value)
+    {
+        value = 0;
+        for(unsigned shift = 0; m_position < m_data.size() && shift < 64; shift += 7)
+        {
+            const std::uint8_t byte = m_data[m_position++];
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    void encode_line_table(std::span<const BytecodeLineInfo> entries, DynamicArray<std::uint8_t>& data,
+            DynamicArray<LineTableCheckpoint>& checkpoints)
+    {
+        BytecodeLineInfo previous = { .offset = 0, .line = 0 };
+        std::size_t entry_count = 0;
+        for(const BytecodeLineInfo& entry : entries)
+        {
+            if(entry.line == previous.line) continue;
+            assert(entry_count == 0 || entry.offset > previous.offset);
+
+            const std::int64_t line_difference = std::int64_t(entry.line) - std::int64_t(previous.line);
+            write_varint(data, entry.offset - previous.offset);
+            write_varint(data, (static_cast<std::uint64_t>(line_difference) << 1)
+                ^ static_cast<std::uint64_t>(line_difference >> 63));
+
+            if(entry_count++ % LineTable::CHECKPOINT_INTERVAL == 0)
+            {
+                checkpoints.push_back({
+                    .offset = entry.offset,
+                    .line = entry.line,
+                    .data_offset = static_cast<std::uint32_t>(data.size())
+                });
+            }
+            previous = entry;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef WF_LINE_TABLE_HPP
+#define WF_LINE_TABLE_HPP
+
+#include <cstdint>
+#include <span>
+
+#include "Utils/Array.hpp"
+
+namespace wf
+{
+    // Line of the instructions from `offset` up to the next entry. Code generation records one whenever the line
+    // changes, frozen code stores them as a LineTable.
+    struct BytecodeLineInfo
+    {
+        std::uint32_t offset;
+        std::uint32_t line;
+    };
+
+    // Absolute position of every CHECKPOINT_INTERVAL-th entry of a LineTable, starting with the first one.
+    // `data_offset` is where the entry after it is encoded.
+    struct LineTableCheckpoint
+    {
+        std::uint32_t offset;
+        std::uint32_t line;
+        std::uint32_t data_offset;
+    };
+
+    // Compact line entries of frozen code, both arrays are stored as is in precompiled bytecode files. Each entry
+    // is encoded as the LEB128 varint of its offset minus the previous offset, followed by the zigzag encoded
+    // varint of its line minus the previous line. Lookups binary search the checkpoints and decode at most
+    // CHECKPOINT_INTERVAL - 1 entries after that.
+    struct LineTable
+    {
+        static constexpr std::size_t CHECKPOINT_INTERVAL = 16;
+
+        std::span<const std::uint8_t> data;
+        std::span<const LineTableCheckpoint> checkpoints;
+
+        // Line of the instruction at `offset`, or 0 if it has none.
+        std::uint32_t get_line(std::size_t offset) const;
+        // Checks that the entries decode to increasing offsets within `code_size` instructions and that the
+        // checkpoints match them.
+        bool is_valid(std::size_t code_size) const;
+    };
+
+    // Decodes the entries of a LineTable in order.
+    class LineTableReader
+    {
+    public:
+        explicit LineTableReader(const LineTable& table)
+            : m_data(table.data)
+        {
+        }
+
+        // Continues after the entry of `checkpoint`.
+        LineTableReader(const LineTable& table, const LineTableCheckpoint& checkpoint)
+            : m_data(table.data), m_position(checkpoint.data_offset),
+                m_previous{ .offset = checkpoint.offset, .line = checkpoint.line }
+        {
+        }
+
+        // Returns false once every entry is read, or if the data is malformed.
+        bool next(BytecodeLineInfo& entry);
+
+        bool is_at_end() const { return m_position == m_data.size(); }
+        std::size_t get_position() const { return m_position; }
+    private:
+        std::span<const std::uint8_t> m_data;
+        std::size_t m_position = 0;
+        BytecodeLineInfo m_previous = { .offset = 0, .line = 0 };
+
+        bool read_varint(std::uint64_t& value);
+    };
+
+    // Encodes `entries`, ordered by offset, into `data` and `checkpoints`. Entries that do not change the line
+    // are dropped.
+    void encode_line_table(std::span<const BytecodeLineInfo> entries, DynamicArray<std::uint8_t>& data,
+            DynamicArray<LineTableCheckpoint>& checkpoints);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "Module.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "State.hpp"
+#include "Vm/Verifier.hpp"
+#include "Utils/Allocate.hpp"
+
+namespace wf
+{
+    static std::size_t align_up(std::size_t size, std::size_t alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    // Frozen modules start on a cache line, as do their code and constants. Instructions are fetched and constants
+    // loaded without sharing a line with the header, whose reference count is written by every CompiledModule copy.
+    static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    // Byte offset of an array of `count` T placed after `size` bytes, `size` is advanced past the array.
+    template<typename T>
+    static std::size_t place_array(std::size_t& size, std::size_t count, std::size_t alignment = alignof(T))
+    {
+        const std::size_t offset = align_up(size, alignment);
+        size = offset + sizeof(T) * count;
+        return offset;
+    }
+
+    template<typename T>
+    static T* copy_array(std::byte* memory, std::size_t offset, const DynamicArray<T>& source)
+    {
+        T* destination = reinterpret_cast<T*>(memory + offset);
+        std::uninitialized_copy(source.begin(), source.end(), destination);
+        return destination;
+    }
+
+    ModuleData* freeze_bytecode(State* state, const BytecodeBuilder& builder)
+    {
+        std::size_t string_count = 0;
+        std::size_t string_pool_size = 0;
+        for(std::size_t i = 0; i < builder.constants.size(); i++)
+        {
+            if(builder.constant_type_infos[i] != ConstantType::STRING) continue;
+            string_count++;
+            string_pool_size += builder.constants[i].as_string()->length + 1;
+        }
+
+        DynamicArray<std::uint8_t> line_data(state);
+        DynamicArray<LineTableCheckpoint> line_checkpoints(state);
+        encode_line_table(builder.line_info, line_data, line_checkpoints);
+
+        // Sections are ordered by how often running code touches them, the line table and strings come last.
+        std::size_t size = sizeof(ModuleData);
+        const std::size_t code_offset = place_array<Instruction>(size, builder.code.size(), CACHE_LINE_SIZE);
+        const std::size_t constants_offset = place_array<Value>(size, builder.constants.size(), CACHE_LINE_SIZE);
+        const std::size_t constant_types_offset = place_array<ConstantType>(size, builder.constant_type_infos.size());
+        const std::size_t line_checkpoints_offset = place_array<LineTableCheckpoint>(size, line_checkpoints.size());
+        const std::size_t line_data_offset = place_array<std::uint8_t>(size, line_data.size());
+        const std::size_t strings_offset = place_array<StringObject>(size, string_count);
+        const std::size_t string_pool_offset = place_array<char>(size, string_pool_size);
+
+#ifndef NDEBUG
+        // Debug builds make sure the code generator only emits code the verifier accepts.
+        String error(state);
+        std::uint32_t verified_frame_size = 0;
+        assert(verify_bytecode(builder.code, builder.constant_type_infos, builder.constants, verified_frame_size,
+            error));
+        assert(verified_frame_size == builder.frame_size);
+#endif
+
+        // Allocators only guarantee fundamental alignment, so the block is aligned within a slightly larger one.
+        const std::size_t allocation_size = size + CACHE_LINE_SIZE - 1;
+        void* const allocation = allocate(state, allocation_size);
+        std::byte* memory = static_cast<std::byte*>(allocation)
+            + (0 - reinterpret_cast<std::uintptr_t>(allocation)) % CACHE_LINE_SIZE;
+
+        Value* constants = copy_array(memory, constants_offset, builder.constants);
+        StringObject* strings = reinterpret_cast<StringObject*>(memory + strings_offset);
+        char* string_pool = reinterpret_cast<char*>(memory + string_pool_offset);
+
+        std::size_t string_index = 0;
+        for(std::size_t i = 0; i < builder.constants.size(); i++)
+        {
+            if(builder.constant_type_infos[i] != ConstantType::STRING) continue;
+
+            const StringObject* source_string = builder.constants[i].as_string();
+            std::memcpy(string_pool, source_string->text, source_string->length + 1);
+
+            StringObject* string = new(strings + string_index++) StringObject(StringInfo{
+                .text = string_pool,
+                .length = source_string->length,
+                .hash = source_string->hash
+            });
+            constants[i] = Value(string);
+            string_pool += source_string->length + 1;
+        }
+
+        return new(memory) ModuleData{
+            .allocator = state->allocator,
+            .allocation = allocation,
+            .allocation_size = allocation_size,
+            .reference_count = 1,
+            .line_table = {
+                .data = { copy_array(memory, line_data_offset, line_data), line_data.size() },
+                .checkpoints = {
+                    copy_array(memory, line_checkpoints_offset, line_checkpoints), line_checkpoints.size()
+                }
+            },
+            .code = { copy_array(memory, code_offset, builder.code), builder.code.size() },
+            .constant_type_infos = {
+                copy_array(memory, constant_types_offset, builder.constant_type_infos),
+                builder.constant_type_infos.size()
+            },
+            .constants = { constants, builder.constants.size() },
+            .strings = { strings, string_count },
+            .return_type = builder.return_type,
+            .frame_size = builder.frame_size,
+            .is_verified = true
+        };
+    }
+
+    CompiledModule::CompiledModule(ModuleData* data)
+        : m_data(data)
+    {
+    }
+
+    CompiledModule::CompiledModule(const CompiledModule& other)
+        : m_data(other.m_data)
+    {
+        if(m_data != nullptr)
+        {
+            m_data->reference_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    CompiledModule::CompiledModule(CompiledModule&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr))
+    {
+    }
+
+    CompiledModule& CompiledModule::operator=(const CompiledModule& other)
+    {
+        CompiledModule copy(other);
+        std::swap(m_data, copy.m_data);
+        return *this;
+    }
+
+    CompiledModule& CompiledModule::operator=(CompiledModule&& other) noexcept
+    {
+        std::swap(m_data, other.m_data);
+        return *this;
+    }
+
+    CompiledModule::~CompiledModule()
+    {
+        if(m_data == nullptr || m_data->reference_count.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        for(StringObject& string : m_data->strings)
+        {
+            string.~StringObject();
+        }
+
+        Allocator& allocator = m_data->allocator;
+        void* const allocation = m_data->allocation;
+        const std::size_t allocation_size = m_data->allocation_size;
+        m_data->~ModuleData();
+        allocator(allocation, allocation_size, 0);
+    }
+}
\ No newline at end of file
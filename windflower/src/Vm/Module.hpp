@@ -0,0 +1,59 @@
+#ifndef WF_MODULE_HPP
+#define WF_MODULE_HPP
+
+#include <atomic>
+#include <span>
+
+#include "Object.hpp"
+
+namespace wf
+{
+    // Code generated for one compilation, frozen into a module once complete.
+    struct BytecodeBuilder
+    {
+        BytecodeBuilder(State* state)
+            : line_info(state), code(state), constant_type_infos(state), constants(state)
+        {
+        }
+
+        DynamicArray<BytecodeLineInfo> line_info;
+        DynamicArray<Instruction> code;
+        DynamicArray<ConstantType> constant_type_infos;
+        DynamicArray<Value> constants;
+
+        TypeId return_type = TypeId::VOID;
+        // Registers the code uses, which its RESERVE instruction reserves.
+        std::uint32_t frame_size = 0;
+    };
+
+    // Immutable compiled code. The allocation holding the header belongs to no State, so a module can be loaded
+    // into any number of Environments on any thread. Frozen modules keep their code, constants, line table and
+    // strings in the same cache line aligned block right after the header, modules loaded from a bytecode file
+    // point into the file instead.
+    struct ModuleData
+    {
+        Allocator& allocator;
+        // Start of the allocation, which a frozen module's header may be placed after to align it.
+        void* const allocation;
+        const std::size_t allocation_size;
+        std::atomic<std::size_t> reference_count;
+
+        LineTable line_table;
+        std::span<const Instruction> code;
+        std::span<const ConstantType> constant_type_infos;
+        std::span<const Value> constants;
+        // Strings referenced by STRING constants. They are not interned in any State.
+        std::span<StringObject> strings;
+
+        TypeId return_type;
+        std::uint32_t frame_size;
+        // Set once the code is known to pass verify_bytecode(), which the Vm relies on to run it without checking
+        // operands or types. Files are verified when loaded, compiled code is correct by construction.
+        bool is_verified = false;
+    };
+
+    // Returns a module holding a single reference.
+    ModuleData* freeze_bytecode(State* state, const BytecodeBuilder& builder);
+}
+
+#endif
\ No newline at end of file
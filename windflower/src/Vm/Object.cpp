@@ -1,6 +1,7 @@
 #include "Object.hpp"
 
 #include "State.hpp"
+#include "Vm/Module.hpp"
 
 namespace wf
 {
@@ -25,9 +26,25 @@ namespace wf
     {
     }
 
+    StringObject::StringObject(const StringInfo& string_info)
+        : state(nullptr), text(string_info.text), length(string_info.length), hash(string_info.hash)
+    {
+    }
+
     StringObject::~StringObject()
     {
-        deallocate(state, const_cast<char*>(text), length + 1);
+        if(state != nullptr)
+        {
+            deallocate(state, const_cast<char*>(text), length + 1);
+        }
+    }
+
+    BytecodeObject::BytecodeObject(State* state, const CompiledModule& module)
+        : Object(state), module(module), line_table(module.m_data->line_table), code(module.m_data->code),
+            constant_type_infos(module.m_data->constant_type_infos), constants(module.m_data->constants),
+            return_type(module.m_data->return_type), frame_size(module.m_data->frame_size),
+            is_verified(module.m_data->is_verified)
+    {
     }
 
     StringObject* StringObject::from_text(State* state, std::string_view source_string)
@@ -1,19 +1,17 @@
 #ifndef WF_OBJECT_HPP
 #define WF_OBJECT_HPP
 
+#include <span>
+
 #include "Utils/Array.hpp"
 #include "Instructions.hpp"
+#include "Jit.hpp"
+#include "LineTable.hpp"
 #include "Value.hpp"
 
 namespace wf
 {
-    struct BytecodeLineInfo
-    {
-        std::size_t offset;
-        std::uint16_t line;
-    };
-
-    enum class ConstantType
+    enum class ConstantType : std::uint8_t
     {
         INT, FLOAT, STRING,
     };
@@ -29,6 +27,8 @@ namespace wf
         };
 
         Object(State* state);
+        // Objects owned by a module rather than a State.
+        Object() = default;
 
         Object* next = nullptr;
 
@@ -47,6 +47,8 @@ namespace wf
         WF_POLYMORPHIC_SIZING
 
         StringObject(State* state, const StringInfo& string_info);
+        // String frozen into a module, `string_info.text` is owned by the module.
+        StringObject(const StringInfo& string_info);
 
         ~StringObject();
 
@@ -62,17 +64,32 @@ namespace wf
     {
         WF_POLYMORPHIC_SIZING
 
-        BytecodeObject(State* state)
-            : Object(state), line_info(state), code(state), constant_type_infos(state), constants(state)
+        // Views the code of `module`, which is shared rather than copied.
+        BytecodeObject(State* state, const CompiledModule& module);
+
+        ~BytecodeObject()
         {
+            jit_release(jit_code);
         }
 
-        DynamicArray<BytecodeLineInfo> line_info;
-        DynamicArray<Instruction> code;
-        DynamicArray<ConstantType> constant_type_infos;
-        DynamicArray<Value> constants;
+        const CompiledModule module;
+
+        const LineTable line_table;
+        const std::span<const Instruction> code;
+        const std::span<const ConstantType> constant_type_infos;
+        const std::span<const Value> constants;
+
+        const TypeId return_type;
+        // Registers used by the code, as reserved by its RESERVE instruction.
+        const std::uint32_t frame_size;
+        // See ModuleData::is_verified.
+        const bool is_verified;
+
+        JitCode jit_code;
 
-        TypeId return_type = TypeId::VOID;
+        // Looked up on the first call, set if wfc generated code for this exact bytecode.
+        AotFunc aot_function = nullptr;
+        bool is_aot_function_resolved = false;
     };
 }
 
@@ -0,0 +1,366 @@
+// Opcode semantics shared by every dispatch strategy of Vm::run().
+//
+// This file is included from Vm.cpp with WF_VM_TARGET(opcode), WF_VM_DISPATCH() and WF_VM_DISPATCH_WIDE()
+// defined by the selected strategy. It is included a second time for instructions that follow a WIDE
+// prefix, so operands must only be read through the WF_VM_OP_* macros. Every handler ends by either
+// dispatching the next instruction or returning from the interpreter. Handlers have access to:
+//  - vm: the running Vm.
+//  - frame: register 0 of the active frame.
+//  - ip: the instruction following the one being executed.
+//  - constants: the constant table of the active function.
+
+WF_VM_TARGET(NO_OP)
+{
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(WIDE)
+{
+    WF_VM_DISPATCH_WIDE();
+}
+
+WF_VM_TARGET(RESERVE)
+{
+    if(!vm.m_state->stack.reserve(WF_VM_OP_LONG))
+    {
+        vm.error(ip, String("Stack overflow.", vm.m_state));
+    }
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(RETURN)
+{
+    vm.m_ip = vm.m_state->stack.get_saved_ip();
+    vm.m_state->stack.pop_frame();
+    return;
+}
+
+WF_VM_TARGET(RETURN_VALUE)
+{
+    const std::size_t saved_return_idx = vm.m_state->stack.get_return_idx();
+    const Value return_value = frame[WF_VM_OP_A];
+
+    vm.m_ip = vm.m_state->stack.get_saved_ip();
+    vm.m_state->stack.pop_frame();
+    vm.m_state->stack.index(saved_return_idx) = return_value;
+    return;
+}
+
+WF_VM_TARGET(RETURN_CONSTANT)
+{
+    const std::size_t saved_return_idx = vm.m_state->stack.get_return_idx();
+    const Value return_value = constants[WF_VM_OP_D];
+
+    vm.m_ip = vm.m_state->stack.get_saved_ip();
+    vm.m_state->stack.pop_frame();
+    vm.m_state->stack.index(saved_return_idx) = return_value;
+    return;
+}
+
+WF_VM_TARGET(MOVE)
+{
+    frame[WF_VM_OP_A] = frame[WF_VM_OP_D];
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(LOAD_CONSTANT)
+{
+    frame[WF_VM_OP_A] = constants[WF_VM_OP_D];
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(NEGATION_INT)
+{
+    frame[WF_VM_OP_A].as_int = -frame[WF_VM_OP_D].as_int;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(NEGATION_FLOAT)
+{
+    frame[WF_VM_OP_A].as_float = -frame[WF_VM_OP_D].as_float;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(INT_TO_FLOAT)
+{
+    frame[WF_VM_OP_A].as_float = static_cast<Float>(static_cast<Int>(frame[WF_VM_OP_D].as_int));
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(FLOAT_TO_INT)
+{
+    frame[WF_VM_OP_A].as_int = static_cast<UInt>(static_cast<Int>(frame[WF_VM_OP_D].as_float));
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(ADD_INT)
+{
+    frame[WF_VM_OP_A].as_int
+        = frame[WF_VM_OP_B].as_int + frame[WF_VM_OP_C].as_int;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(SUBTRACT_INT)
+{
+    frame[WF_VM_OP_A].as_int
+        = frame[WF_VM_OP_B].as_int - frame[WF_VM_OP_C].as_int;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(MULTIPLY_INT)
+{
+    frame[WF_VM_OP_A].as_int
+        = frame[WF_VM_OP_B].as_int * frame[WF_VM_OP_C].as_int;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(DIVIDE_INT)
+{
+    const UInt rhs = frame[WF_VM_OP_C].as_int;
+
+    if(rhs == 0)
+    {
+        vm.error(ip, String("Cannot divide an integer by 0.", vm.m_state));
+    }
+
+    frame[WF_VM_OP_A].as_int = frame[WF_VM_OP_B].as_int / rhs;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(MODULO_INT)
+{
+    const UInt rhs = frame[WF_VM_OP_C].as_int;
+
+    if(rhs == 0)
+    {
+        vm.error(ip, String("Cannot divide an integer by 0.", vm.m_state));
+    }
+
+    frame[WF_VM_OP_A].as_int = frame[WF_VM_OP_B].as_int % rhs;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(ADD_FLOAT)
+{
+    frame[WF_VM_OP_A].as_float
+        = frame[WF_VM_OP_B].as_float + frame[WF_VM_OP_C].as_float;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(SUBTRACT_FLOAT)
+{
+    frame[WF_VM_OP_A].as_float
+        = frame[WF_VM_OP_B].as_float - frame[WF_VM_OP_C].as_float;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(MULTIPLY_FLOAT)
+{
+    frame[WF_VM_OP_A].as_float
+        = frame[WF_VM_OP_B].as_float * frame[WF_VM_OP_C].as_float;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(DIVIDE_FLOAT)
+{
+    frame[WF_VM_OP_A].as_float
+        = frame[WF_VM_OP_B].as_float / frame[WF_VM_OP_C].as_float;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(ADD_INT_RK)
+{
+    frame[WF_VM_OP_A].as_int
+        = frame[WF_VM_OP_B].as_int + constants[WF_VM_OP_C].as_int;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(SUBTRACT_INT_RK)
+{
+    frame[WF_VM_OP_A].as_int
+        = frame[WF_VM_OP_B].as_int - constants[WF_VM_OP_C].as_int;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(MULTIPLY_INT_RK)
+{
+    frame[WF_VM_OP_A].as_int
+        = frame[WF_VM_OP_B].as_int * constants[WF_VM_OP_C].as_int;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(DIVIDE_INT_RK)
+{
+    const UInt rhs = constants[WF_VM_OP_C].as_int;
+
+    if(rhs == 0)
+    {
+        vm.error(ip, String("Cannot divide an integer by 0.", vm.m_state));
+    }
+
+    frame[WF_VM_OP_A].as_int = frame[WF_VM_OP_B].as_int / rhs;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(MODULO_INT_RK)
+{
+    const UInt rhs = constants[WF_VM_OP_C].as_int;
+
+    if(rhs == 0)
+    {
+        vm.error(ip, String("Cannot divide an integer by 0.", vm.m_state));
+    }
+
+    frame[WF_VM_OP_A].as_int = frame[WF_VM_OP_B].as_int % rhs;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(ADD_FLOAT_RK)
+{
+    frame[WF_VM_OP_A].as_float
+        = frame[WF_VM_OP_B].as_float + constants[WF_VM_OP_C].as_float;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(SUBTRACT_FLOAT_RK)
+{
+    frame[WF_VM_OP_A].as_float
+        = frame[WF_VM_OP_B].as_float - constants[WF_VM_OP_C].as_float;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(MULTIPLY_FLOAT_RK)
+{
+    frame[WF_VM_OP_A].as_float
+        = frame[WF_VM_OP_B].as_float * constants[WF_VM_OP_C].as_float;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(DIVIDE_FLOAT_RK)
+{
+    frame[WF_VM_OP_A].as_float
+        = frame[WF_VM_OP_B].as_float / constants[WF_VM_OP_C].as_float;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(SUBTRACT_INT_KR)
+{
+    frame[WF_VM_OP_A].as_int
+        = constants[WF_VM_OP_B].as_int - frame[WF_VM_OP_C].as_int;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(DIVIDE_INT_KR)
+{
+    const UInt rhs = frame[WF_VM_OP_C].as_int;
+
+    if(rhs == 0)
+    {
+        vm.error(ip, String("Cannot divide an integer by 0.", vm.m_state));
+    }
+
+    frame[WF_VM_OP_A].as_int = constants[WF_VM_OP_B].as_int / rhs;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(MODULO_INT_KR)
+{
+    const UInt rhs = frame[WF_VM_OP_C].as_int;
+
+    if(rhs == 0)
+    {
+        vm.error(ip, String("Cannot divide an integer by 0.", vm.m_state));
+    }
+
+    frame[WF_VM_OP_A].as_int = constants[WF_VM_OP_B].as_int % rhs;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(SUBTRACT_FLOAT_KR)
+{
+    frame[WF_VM_OP_A].as_float
+        = constants[WF_VM_OP_B].as_float - frame[WF_VM_OP_C].as_float;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(DIVIDE_FLOAT_KR)
+{
+    frame[WF_VM_OP_A].as_float
+        = constants[WF_VM_OP_B].as_float / frame[WF_VM_OP_C].as_float;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(ADD_INT_RI)
+{
+    frame[WF_VM_OP_A].as_int
+        = frame[WF_VM_OP_B].as_int + static_cast<UInt>(static_cast<Int>(WF_VM_OP_SC));
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(SUBTRACT_INT_RI)
+{
+    frame[WF_VM_OP_A].as_int
+        = frame[WF_VM_OP_B].as_int - static_cast<UInt>(static_cast<Int>(WF_VM_OP_SC));
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(MULTIPLY_INT_RI)
+{
+    frame[WF_VM_OP_A].as_int
+        = frame[WF_VM_OP_B].as_int * static_cast<UInt>(static_cast<Int>(WF_VM_OP_SC));
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(SHIFT_LEFT_INT_RI)
+{
+    frame[WF_VM_OP_A].as_int = frame[WF_VM_OP_B].as_int << (WF_VM_OP_C & 63);
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(SHIFT_RIGHT_INT_RI)
+{
+    frame[WF_VM_OP_A].as_int = frame[WF_VM_OP_B].as_int >> (WF_VM_OP_C & 63);
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(AND_INT_RK)
+{
+    frame[WF_VM_OP_A].as_int = frame[WF_VM_OP_B].as_int & constants[WF_VM_OP_C].as_int;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(DIVIDE_INT_MAGIC)
+{
+    const UInt divisor = constants[WF_VM_OP_C].as_int;
+    frame[WF_VM_OP_A].as_int = divide_by_magic(frame[WF_VM_OP_B].as_int, constants[WF_VM_OP_C + 1].as_int,
+        get_division_magic_shift(divisor));
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(MODULO_INT_MAGIC)
+{
+    const UInt divisor = constants[WF_VM_OP_C].as_int;
+    const UInt lhs = frame[WF_VM_OP_B].as_int;
+    frame[WF_VM_OP_A].as_int = lhs
+        - divide_by_magic(lhs, constants[WF_VM_OP_C + 1].as_int, get_division_magic_shift(divisor)) * divisor;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(FMA_FLOAT)
+{
+    frame[WF_VM_OP_A].as_float
+        = std::fma(frame[WF_VM_OP_B].as_float, frame[WF_VM_OP_C].as_float, frame[WF_VM_OP_A].as_float);
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(DIVIDE_INT_NOCHECK)
+{
+    frame[WF_VM_OP_A].as_int = frame[WF_VM_OP_B].as_int / frame[WF_VM_OP_C].as_int;
+    WF_VM_DISPATCH();
+}
+
+WF_VM_TARGET(MODULO_INT_NOCHECK)
+{
+    frame[WF_VM_OP_A].as_int = frame[WF_VM_OP_B].as_int % frame[WF_VM_OP_C].as_int;
+    WF_VM_DISPATCH();
+}
\ No newline at end of file
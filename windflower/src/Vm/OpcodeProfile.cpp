@@ -0,0 +1,19 @@
+#include "OpcodeProfile.hpp"
+
+namespace wf
+{
+    OpcodePairProfile& OpcodePairProfile::get()
+    {
+        thread_local OpcodePairProfile profile;
+        return profile;
+    }
+
+    bool OpcodePairProfile::is_enabled()
+    {
+#if defined(WF_VM_PROFILE_PAIRS)
+        return true;
+#else
+        return false;
+#endif
+    }
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef WF_OPCODE_PROFILE_HPP
+#define WF_OPCODE_PROFILE_HPP
+
+#include "Instructions.hpp"
+#include "Utils/Array.hpp"
+
+namespace wf
+{
+    // How often the interpreter ran each opcode directly after another one in the same function, counted per
+    // thread. Only libraries built with WF_VM_PROFILE_PAIRS defined (premake option "vm-profile-pairs") count
+    // anything, which slows every instruction down. A WIDE prefix is not counted, the instruction it extends is.
+    class OpcodePairProfile
+    {
+    public:
+        static OpcodePairProfile& get();
+        static bool is_enabled();
+
+        void begin_function() { m_previous = OPCODE_COUNT; }
+
+        void record(Opcode opcode)
+        {
+            if(opcode == Opcode::WIDE) return;
+
+            const std::size_t index = to_underlying(opcode);
+            if(m_previous != OPCODE_COUNT) m_counts[m_previous][index]++;
+            m_previous = index;
+        }
+
+        std::uint64_t get_count(Opcode first, Opcode second) const
+        {
+            return m_counts[to_underlying(first)][to_underlying(second)];
+        }
+
+        void reset() { *this = {}; }
+    private:
+        StaticArray<StaticArray<std::uint64_t, OPCODE_COUNT>, OPCODE_COUNT> m_counts = {};
+        // OPCODE_COUNT before the first instruction of a function.
+        std::size_t m_previous = OPCODE_COUNT;
+    };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,527 @@
+#include "Peephole.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <iterator>
+
+namespace wf
+{
+    static bool is_return(Opcode opcode)
+    {
+        return opcode == Opcode::RETURN || opcode == Opcode::RETURN_VALUE || opcode == Opcode::RETURN_CONSTANT;
+    }
+
+    PeepholeOptimizer::PeepholeOptimizer(State* state, BytecodeBuilder* code, std::span<const PeepholeRule> rules)
+        : m_state(state), m_code(code), m_rules(rules), m_hit_counts(rules.size(), 0, state), m_instructions(state),
+            m_code_offsets(state), m_removed(state), m_next(state), m_live_after(state), m_live_epochs(state),
+            m_float_constants(state)
+    {
+    }
+
+    void PeepholeOptimizer::run()
+    {
+        decode();
+
+        m_second = NO_INSTRUCTION;
+        for(std::uint32_t i = static_cast<std::uint32_t>(m_instructions.size()); i-- > 0;)
+        {
+            m_first = i;
+            while(!m_removed[m_first] && apply_rules()) {}
+
+            if(!m_removed[m_first]) advance();
+        }
+
+        encode();
+    }
+
+    bool PeepholeOptimizer::is_live_after_first(std::uint32_t reg) const
+    {
+        return is_live(reg);
+    }
+
+    bool PeepholeOptimizer::is_live_after_second(std::uint32_t reg) const
+    {
+        if(!has_second()) return false;
+
+        // Registers the second instruction does not access are as live after it as they are before it.
+        std::uint32_t registers[OPERAND_COUNT];
+        get_registers(m_instructions[m_second], registers);
+        for(std::size_t i = 0; i < OPERAND_COUNT; i++)
+        {
+            if(registers[i] == reg) return (m_live_after[m_second] >> i) & 1;
+        }
+        return is_live(reg);
+    }
+
+    void PeepholeOptimizer::replace_second(const PeepholeInstruction& instruction)
+    {
+        std::uint32_t old_registers[OPERAND_COUNT];
+        std::uint32_t new_registers[OPERAND_COUNT];
+        get_registers(m_instructions[m_second], old_registers);
+        get_registers(instruction, new_registers);
+
+        // A return can only be replaced by another one, before which exactly the registers it reads are live.
+        assert(is_return(get_second().opcode) == is_return(instruction.opcode));
+        if(is_return(instruction.opcode))
+        {
+            m_epoch++;
+            for(std::size_t i = 0; i < OPERAND_COUNT; i++)
+            {
+                if(new_registers[i] != NO_REGISTER && reads_operand(instruction, i)) set_live(new_registers[i], true);
+            }
+
+            m_instructions[m_second] = instruction;
+            m_live_after[m_second] = 0;
+            return;
+        }
+
+        std::uint8_t new_live_after = 0;
+        for(std::size_t i = 0; i < OPERAND_COUNT; i++)
+        {
+            if(new_registers[i] != NO_REGISTER && is_live_after_second(new_registers[i]))
+            {
+                new_live_after |= static_cast<std::uint8_t>(1 << i);
+            }
+        }
+
+        // Undo the effect of the old instruction on the liveness before it, then apply that of the new one.
+        for(std::size_t i = 0; i < OPERAND_COUNT; i++)
+        {
+            if(old_registers[i] != NO_REGISTER) set_live(old_registers[i], (m_live_after[m_second] >> i) & 1);
+        }
+        for(std::size_t i = 0; i < OPERAND_COUNT; i++)
+        {
+            if(new_registers[i] != NO_REGISTER) set_live(new_registers[i], (new_live_after >> i) & 1);
+        }
+        if(new_registers[0] != NO_REGISTER) set_live(new_registers[0], false);
+        for(std::size_t i = 0; i < OPERAND_COUNT; i++)
+        {
+            if(new_registers[i] != NO_REGISTER && reads_operand(instruction, i)) set_live(new_registers[i], true);
+        }
+
+        m_instructions[m_second] = instruction;
+        m_live_after[m_second] = new_live_after;
+    }
+
+    void PeepholeOptimizer::remove_first()
+    {
+        m_removed[m_first] = true;
+    }
+
+    void PeepholeOptimizer::remove_second()
+    {
+        // Liveness cannot be restored across a return, but everything after the first return is dead anyway.
+        assert(!is_return(get_second().opcode) || is_return(get_first().opcode));
+
+        std::uint32_t registers[OPERAND_COUNT];
+        get_registers(m_instructions[m_second], registers);
+        for(std::size_t i = 0; i < OPERAND_COUNT; i++)
+        {
+            if(registers[i] != NO_REGISTER) set_live(registers[i], (m_live_after[m_second] >> i) & 1);
+        }
+
+        m_removed[m_second] = true;
+        m_second = m_next[m_second];
+    }
+
+    std::uint32_t PeepholeOptimizer::get_float_constant(Float value)
+    {
+        if(!m_float_constants_mapped)
+        {
+            for(std::size_t i = 0; i < m_code->constants.size(); i++)
+            {
+                if(m_code->constant_type_infos[i] != ConstantType::FLOAT) continue;
+                m_float_constants.try_emplace(std::bit_cast<UInt>(m_code->constants[i].as_float),
+                        static_cast<std::uint32_t>(i));
+            }
+            m_float_constants_mapped = true;
+        }
+
+        const auto [it, inserted] = m_float_constants.try_emplace(std::bit_cast<UInt>(value),
+                static_cast<std::uint32_t>(m_code->constants.size()));
+        if(inserted)
+        {
+            m_code->constants.push_back(value);
+            m_code->constant_type_infos.push_back(ConstantType::FLOAT);
+        }
+        return it->second;
+    }
+
+    void PeepholeOptimizer::decode()
+    {
+        const DynamicArray<Instruction>& code = m_code->code;
+
+        std::uint32_t register_count = 0;
+        for(std::size_t i = 0; i < code.size(); i++)
+        {
+            m_code_offsets.push_back(static_cast<std::uint32_t>(i));
+
+            const WideInstruction instruction = WideInstruction::decode(code, i);
+            m_instructions.push_back({
+                .opcode = instruction.get_opcode(),
+                .op_a = instruction.get_op_a(),
+                .op_b = instruction.get_op_b(),
+                .op_c = instruction.get_op_c(),
+                .op_d = instruction.get_op_d(),
+                .op_long = instruction.get_op_long()
+            });
+
+            std::uint32_t registers[OPERAND_COUNT];
+            get_registers(m_instructions.back(), registers);
+            for(const std::uint32_t reg : registers)
+            {
+                if(reg != NO_REGISTER) register_count = std::max(register_count, reg + 1);
+            }
+        }
+
+        m_removed.assign(m_instructions.size(), false);
+        m_next.assign(m_instructions.size(), NO_INSTRUCTION);
+        m_live_after.assign(m_instructions.size(), 0);
+        m_live_epochs.assign(register_count, 0);
+    }
+
+    static bool fits_wide_instruction(const PeepholeInstruction& instruction, const OperandLayout& layout)
+    {
+        if(instruction.opcode == Opcode::RESERVE) return instruction.op_long <= WideInstruction::MAX_OP_LONG;
+        if(layout.d != OperandKind::UNUSED)
+        {
+            return instruction.op_a <= WideInstruction::MAX_OP_A && instruction.op_d <= WideInstruction::MAX_OP_D;
+        }
+        return instruction.op_a <= WideInstruction::MAX_OP_A && instruction.op_b <= WideInstruction::MAX_OP_B
+            && instruction.op_c <= WideInstruction::MAX_OP_C;
+    }
+
+    void PeepholeOptimizer::encode()
+    {
+        DynamicArray<Instruction> code(m_state);
+        // Offset of each instruction in the new code, or of the instruction following it if it was removed.
+        DynamicArray<std::uint32_t> new_offsets(m_state);
+
+        for(std::size_t i = 0; i < m_instructions.size(); i++)
+        {
+            new_offsets.push_back(static_cast<std::uint32_t>(code.size()));
+            if(m_removed[i]) continue;
+
+            const PeepholeInstruction& instruction = m_instructions[i];
+            const OperandLayout layout = get_operand_layout(instruction.opcode);
+            // Rules only combine operands that fit. Code that does not is kept as generated instead of masked.
+            if(!fits_wide_instruction(instruction, layout)) return;
+
+            if(instruction.opcode == Opcode::RESERVE)
+            {
+                if(instruction.op_long > Instruction::MAX_OP_LONG)
+                {
+                    code.push_back(WideInstruction::make_prefix(instruction.op_long));
+                }
+                code.emplace_back(instruction.opcode, instruction.op_long & Instruction::MAX_OP_LONG);
+            }
+            else if(layout.d != OperandKind::UNUSED)
+            {
+                if(instruction.op_a > Instruction::MAX_OP_A || instruction.op_d > Instruction::MAX_OP_D)
+                {
+                    code.push_back(WideInstruction::make_prefix(instruction.op_a, instruction.op_d));
+                }
+                code.emplace_back(instruction.opcode, instruction.op_a & Instruction::MAX_OP_A,
+                        instruction.op_d & Instruction::MAX_OP_D);
+            }
+            else
+            {
+                if(instruction.op_a > Instruction::MAX_OP_A || instruction.op_b > Instruction::MAX_OP_B
+                    || instruction.op_c > Instruction::MAX_OP_C)
+                {
+                    code.push_back(WideInstruction::make_prefix(instruction.op_a, instruction.op_b, instruction.op_c));
+                }
+                code.emplace_back(instruction.opcode, instruction.op_a & Instruction::MAX_OP_A,
+                        instruction.op_b & Instruction::MAX_OP_B, instruction.op_c & Instruction::MAX_OP_C);
+            }
+        }
+
+        // A line entry of a removed instruction moves to the instruction after it, which it already covered. An
+        // entry of that instruction itself takes precedence.
+        DynamicArray<BytecodeLineInfo> line_info(m_state);
+        std::size_t instruction = 0;
+        for(const BytecodeLineInfo& line : m_code->line_info)
+        {
+            while(m_code_offsets[instruction] < line.offset) instruction++;
+            assert(m_code_offsets[instruction] == line.offset);
+
+            const std::uint32_t offset = new_offsets[instruction];
+            if(offset == code.size()) break;
+
+            if(!line_info.empty() && line_info.back().offset == offset)
+            {
+                line_info.back().line = line.line;
+            }
+            else
+            {
+                line_info.push_back({ .offset = offset, .line = line.line });
+            }
+        }
+
+        m_code->code = std::move(code);
+        m_code->line_info = std::move(line_info);
+    }
+
+    bool PeepholeOptimizer::apply_rules()
+    {
+        for(std::size_t i = 0; i < m_rules.size(); i++)
+        {
+            if(m_rules[i].apply(*this))
+            {
+                m_hit_counts[i]++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void PeepholeOptimizer::advance()
+    {
+        const PeepholeInstruction& instruction = m_instructions[m_first];
+        std::uint32_t registers[OPERAND_COUNT];
+        get_registers(instruction, registers);
+
+        std::uint8_t live_after = 0;
+        for(std::size_t i = 0; i < OPERAND_COUNT; i++)
+        {
+            if(registers[i] != NO_REGISTER && is_live(registers[i])) live_after |= static_cast<std::uint8_t>(1 << i);
+        }
+        m_live_after[m_first] = live_after;
+
+        // Nothing after a return is ever read.
+        if(is_return(instruction.opcode))
+        {
+            m_epoch++;
+        }
+        else if(registers[0] != NO_REGISTER)
+        {
+            set_live(registers[0], false);
+        }
+        for(std::size_t i = 0; i < OPERAND_COUNT; i++)
+        {
+            if(registers[i] != NO_REGISTER && reads_operand(instruction, i)) set_live(registers[i], true);
+        }
+
+        m_next[m_first] = m_second;
+        m_second = m_first;
+    }
+
+    void PeepholeOptimizer::get_registers(const PeepholeInstruction& instruction,
+            std::uint32_t (&registers)[OPERAND_COUNT])
+    {
+        const OperandLayout layout = get_operand_layout(instruction.opcode);
+        registers[0] = layout.a == OperandKind::REGISTER? instruction.op_a : NO_REGISTER;
+        registers[1] = layout.b == OperandKind::REGISTER? instruction.op_b : NO_REGISTER;
+        registers[2] = layout.c == OperandKind::REGISTER? instruction.op_c : NO_REGISTER;
+        registers[3] = layout.d == OperandKind::REGISTER? instruction.op_d : NO_REGISTER;
+    }
+
+    bool PeepholeOptimizer::reads_operand(const PeepholeInstruction& instruction, std::size_t operand)
+    {
+        return operand != 0 || reads_op_a(instruction.opcode);
+    }
+
+    static bool remove_unreachable_code(PeepholeOptimizer& optimizer)
+    {
+        if(!is_return(optimizer.get_first().opcode) || !optimizer.has_second()) return false;
+
+        optimizer.remove_second();
+        return true;
+    }
+
+    static bool remove_dead_move(PeepholeOptimizer& optimizer)
+    {
+        const PeepholeInstruction& first = optimizer.get_first();
+        if(first.opcode != Opcode::MOVE) return false;
+        if(first.op_a != first.op_d && optimizer.is_live_after_first(first.op_a)) return false;
+
+        optimizer.remove_first();
+        return true;
+    }
+
+    // Forms of a binary operation taking one of its operands from the constants.
+    struct ConstantOperandForms
+    {
+        Opcode register_register;
+        Opcode register_constant;
+        // NO_OP if the operation has no such form.
+        Opcode constant_register;
+        bool is_commutative;
+    };
+
+    static constexpr ConstantOperandForms CONSTANT_OPERAND_FORMS[] = {
+        { Opcode::ADD_INT, Opcode::ADD_INT_RK, Opcode::NO_OP, true },
+        { Opcode::SUBTRACT_INT, Opcode::SUBTRACT_INT_RK, Opcode::SUBTRACT_INT_KR, false },
+        { Opcode::MULTIPLY_INT, Opcode::MULTIPLY_INT_RK, Opcode::NO_OP, true },
+        { Opcode::DIVIDE_INT, Opcode::DIVIDE_INT_RK, Opcode::DIVIDE_INT_KR, false },
+        { Opcode::MODULO_INT, Opcode::MODULO_INT_RK, Opcode::MODULO_INT_KR, false },
+        { Opcode::DIVIDE_INT_NOCHECK, Opcode::DIVIDE_INT_RK, Opcode::DIVIDE_INT_KR, false },
+        { Opcode::MODULO_INT_NOCHECK, Opcode::MODULO_INT_RK, Opcode::MODULO_INT_KR, false },
+        { Opcode::ADD_FLOAT, Opcode::ADD_FLOAT_RK, Opcode::NO_OP, true },
+        { Opcode::SUBTRACT_FLOAT, Opcode::SUBTRACT_FLOAT_RK, Opcode::SUBTRACT_FLOAT_KR, false },
+        { Opcode::MULTIPLY_FLOAT, Opcode::MULTIPLY_FLOAT_RK, Opcode::NO_OP, true },
+        { Opcode::DIVIDE_FLOAT, Opcode::DIVIDE_FLOAT_RK, Opcode::DIVIDE_FLOAT_KR, false },
+    };
+
+    // Returns the second instruction with the constant loaded by the first one in place of `temporary`, or one with
+    // opcode NO_OP if it cannot take a constant there.
+    static PeepholeInstruction get_constant_operand_form(const PeepholeInstruction& instruction,
+            std::uint32_t temporary, std::uint32_t constant)
+    {
+        if(instruction.opcode == Opcode::MOVE && instruction.op_d == temporary)
+        {
+            return { .opcode = Opcode::LOAD_CONSTANT, .op_a = instruction.op_a, .op_d = constant };
+        }
+
+        for(const ConstantOperandForms& forms : CONSTANT_OPERAND_FORMS)
+        {
+            if(forms.register_register != instruction.opcode) continue;
+
+            // Both operands would need the constant.
+            if(instruction.op_b == temporary && instruction.op_c == temporary) return {};
+
+            if(instruction.op_c == temporary && constant <= WideInstruction::MAX_OP_C)
+            {
+                return { .opcode = forms.register_constant, .op_a = instruction.op_a, .op_b = instruction.op_b,
+                    .op_c = constant };
+            }
+            if(instruction.op_b == temporary && forms.is_commutative && constant <= WideInstruction::MAX_OP_C)
+            {
+                return { .opcode = forms.register_constant, .op_a = instruction.op_a, .op_b = instruction.op_c,
+                    .op_c = constant };
+            }
+            if(instruction.op_b == temporary && forms.constant_register != Opcode::NO_OP
+                && constant <= WideInstruction::MAX_OP_B)
+            {
+                return { .opcode = forms.constant_register, .op_a = instruction.op_a, .op_b = constant,
+                    .op_c = instruction.op_c };
+            }
+            return {};
+        }
+        return {};
+    }
+
+    static bool fold_constant_operand(PeepholeOptimizer& optimizer)
+    {
+        const PeepholeInstruction& first = optimizer.get_first();
+        if(first.opcode != Opcode::LOAD_CONSTANT || !optimizer.has_second()) return false;
+
+        const PeepholeInstruction& second = optimizer.get_second();
+        const PeepholeInstruction folded = get_constant_operand_form(second, first.op_a, first.op_d);
+        if(folded.opcode == Opcode::NO_OP) return false;
+        // The second instruction was the only one to read the constant from the register.
+        if(second.op_a != first.op_a && optimizer.is_live_after_second(first.op_a)) return false;
+
+        optimizer.replace_second(folded);
+        optimizer.remove_first();
+        return true;
+    }
+
+    static bool fold_constant_conversion(PeepholeOptimizer& optimizer)
+    {
+        const PeepholeInstruction& first = optimizer.get_first();
+        if(first.opcode != Opcode::LOAD_CONSTANT || !optimizer.has_second()) return false;
+        if(optimizer.get_code().constant_type_infos[first.op_d] != ConstantType::INT) return false;
+
+        const PeepholeInstruction& second = optimizer.get_second();
+        if(second.opcode != Opcode::INT_TO_FLOAT || second.op_d != first.op_a) return false;
+        if(second.op_a != first.op_a && optimizer.is_live_after_second(first.op_a)) return false;
+
+        // Converted like INT_TO_FLOAT does at runtime.
+        const Float value = static_cast<Float>(static_cast<Int>(optimizer.get_code().constants[first.op_d].as_int));
+        optimizer.replace_second({
+            .opcode = Opcode::LOAD_CONSTANT,
+            .op_a = second.op_a,
+            .op_d = optimizer.get_float_constant(value)
+        });
+        optimizer.remove_first();
+        return true;
+    }
+
+    static bool fuse_return_constant(PeepholeOptimizer& optimizer)
+    {
+        const PeepholeInstruction& first = optimizer.get_first();
+        if(first.opcode != Opcode::LOAD_CONSTANT || !optimizer.has_second()) return false;
+
+        // Nothing runs after the return, so the register is dead.
+        const PeepholeInstruction& second = optimizer.get_second();
+        if(second.opcode != Opcode::RETURN_VALUE || second.op_a != first.op_a) return false;
+
+        optimizer.replace_second({ .opcode = Opcode::RETURN_CONSTANT, .op_d = first.op_d });
+        optimizer.remove_first();
+        return true;
+    }
+
+    static bool remove_double_negation(PeepholeOptimizer& optimizer)
+    {
+        const PeepholeInstruction& first = optimizer.get_first();
+        if(first.opcode != Opcode::NEGATION_INT && first.opcode != Opcode::NEGATION_FLOAT) return false;
+        if(!optimizer.has_second()) return false;
+
+        const PeepholeInstruction& second = optimizer.get_second();
+        if(second.opcode != first.opcode || second.op_d != first.op_a) return false;
+        if(second.op_a != first.op_a && optimizer.is_live_after_second(first.op_a)) return false;
+
+        // Without the first negation its operand still holds the original value.
+        if(second.op_a == first.op_d)
+        {
+            optimizer.remove_second();
+        }
+        else
+        {
+            optimizer.replace_second({ .opcode = Opcode::MOVE, .op_a = second.op_a, .op_d = first.op_d });
+        }
+        optimizer.remove_first();
+        return true;
+    }
+
+    static bool merge_reserves(PeepholeOptimizer& optimizer)
+    {
+        const PeepholeInstruction& first = optimizer.get_first();
+        if(first.opcode != Opcode::RESERVE || !optimizer.has_second()) return false;
+
+        const PeepholeInstruction& second = optimizer.get_second();
+        if(second.opcode != Opcode::RESERVE) return false;
+        if(static_cast<std::uint64_t>(first.op_long) + second.op_long > WideInstruction::MAX_OP_LONG) return false;
+
+        optimizer.replace_first({ .opcode = Opcode::RESERVE, .op_long = first.op_long + second.op_long });
+        optimizer.remove_second();
+        return true;
+    }
+
+    static constexpr PeepholeRule PEEPHOLE_RULES[] = {
+        { "unreachable-code", remove_unreachable_code },
+        { "dead-move", remove_dead_move },
+        { "constant-operand", fold_constant_operand },
+        { "constant-conversion", fold_constant_conversion },
+        { "return-constant", fuse_return_constant },
+        { "double-negation", remove_double_negation },
+        { "reserve-merge", merge_reserves },
+    };
+
+    static_assert(std::size(PEEPHOLE_RULES) == PEEPHOLE_RULE_COUNT);
+
+    std::span<const PeepholeRule> get_peephole_rules()
+    {
+        return PEEPHOLE_RULES;
+    }
+
+    PeepholeProfile& PeepholeProfile::get()
+    {
+        thread_local PeepholeProfile profile;
+        return profile;
+    }
+
+    void PeepholeProfile::record(std::span<const std::uint64_t> hit_counts, std::size_t code_size_before,
+            std::size_t code_size_after)
+    {
+        assert(hit_counts.size() == m_hit_counts.size());
+        for(std::size_t i = 0; i < m_hit_counts.size(); i++)
+        {
+            m_hit_counts[i] += hit_counts[i];
+        }
+        m_code_size_before += code_size_before;
+        m_code_size_after += code_size_after;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,143 @@
+#ifndef WF_PEEPHOLE_HPP
+#define WF_PEEPHOLE_HPP
+
+#include <limits>
+#include <span>
+#include <string_view>
+
+#include "Module.hpp"
+#include "Utils/Array.hpp"
+#include "Utils/HashMap.hpp"
+
+namespace wf
+{
+    // An instruction with its WIDE prefix folded in. Only the operands of the instruction's layout are
+    // meaningful: A, B and C, A and D, or the long operand of rsv.
+    struct PeepholeInstruction
+    {
+        Opcode opcode = Opcode::NO_OP;
+        std::uint32_t op_a = 0;
+        std::uint32_t op_b = 0;
+        std::uint32_t op_c = 0;
+        std::uint32_t op_d = 0;
+        std::uint32_t op_long = 0;
+    };
+
+    class PeepholeOptimizer;
+
+    // Returns true after rewriting the window of the optimizer, false if the rule does not match it.
+    struct PeepholeRule
+    {
+        std::string_view name;
+        bool (*apply)(PeepholeOptimizer& optimizer);
+    };
+
+    // Rewrites generated code with a set of rules, counting how often each of them matches. The optimizer
+    // walks the code backwards with a window of two adjacent instructions, first and second, and applies the
+    // rules to each window until none matches. Everything after the window has already been rewritten, so the
+    // liveness of registers after it is exact and a rewrite can expose a new match in the windows before it.
+    //
+    // Code never branches, so an instruction only ever continues to the next one.
+    class PeepholeOptimizer
+    {
+    public:
+        PeepholeOptimizer(State* state, BytecodeBuilder* code, std::span<const PeepholeRule> rules);
+
+        void run();
+
+        // Matches of each rule, in the order the rules were given in.
+        std::span<const std::uint64_t> get_hit_counts() const { return m_hit_counts; }
+
+        // The window, for use by rules.
+        const PeepholeInstruction& get_first() const { return m_instructions[m_first]; }
+        bool has_second() const { return m_second != NO_INSTRUCTION; }
+        const PeepholeInstruction& get_second() const { return m_instructions[m_second]; }
+        // Whether the value a register holds after the instruction is read by a later one.
+        bool is_live_after_first(std::uint32_t reg) const;
+        bool is_live_after_second(std::uint32_t reg) const;
+
+        void replace_first(const PeepholeInstruction& instruction) { m_instructions[m_first] = instruction; }
+        void replace_second(const PeepholeInstruction& instruction);
+        void remove_first();
+        // The instruction after the second one, if any, becomes the second instruction of the window.
+        void remove_second();
+
+        const BytecodeBuilder& get_code() const { return *m_code; }
+        // Index of a float constant with the given value, added to the code if it does not exist yet.
+        std::uint32_t get_float_constant(Float value);
+    private:
+        static constexpr std::uint32_t NO_INSTRUCTION = std::numeric_limits<std::uint32_t>::max();
+        // Registers an instruction accesses, in the order A, B, C, D. Unused operands hold NO_REGISTER.
+        static constexpr std::size_t OPERAND_COUNT = 4;
+        static constexpr std::uint32_t NO_REGISTER = std::numeric_limits<std::uint32_t>::max();
+
+        State* const m_state;
+        BytecodeBuilder* const m_code;
+        const std::span<const PeepholeRule> m_rules;
+        DynamicArray<std::uint64_t> m_hit_counts;
+
+        DynamicArray<PeepholeInstruction> m_instructions;
+        // Offset of each instruction in the code it was decoded from.
+        DynamicArray<std::uint32_t> m_code_offsets;
+        DynamicArray<bool> m_removed;
+        // Instruction following each instruction behind the window that has not been removed.
+        DynamicArray<std::uint32_t> m_next;
+        // Bit i is set if the register in operand i is live after each instruction behind the window.
+        DynamicArray<std::uint8_t> m_live_after;
+        // Registers live after the first instruction of the window, those whose epoch is the current one.
+        DynamicArray<std::uint32_t> m_live_epochs;
+        std::uint32_t m_epoch = 1;
+        HashMap<UInt, std::uint32_t> m_float_constants;
+        bool m_float_constants_mapped = false;
+
+        std::uint32_t m_first = NO_INSTRUCTION;
+        std::uint32_t m_second = NO_INSTRUCTION;
+
+        void decode();
+        void encode();
+        bool apply_rules();
+        // Makes the first instruction of the window its second one, recording which registers are live after it.
+        void advance();
+
+        bool is_live(std::uint32_t reg) const { return m_live_epochs[reg] == m_epoch; }
+        void set_live(std::uint32_t reg, bool live) { m_live_epochs[reg] = live? m_epoch : 0; }
+        static void get_registers(const PeepholeInstruction& instruction, std::uint32_t (&registers)[OPERAND_COUNT]);
+        static bool reads_operand(const PeepholeInstruction& instruction, std::size_t operand);
+    };
+
+    // The rules run after code generation. They only remove instructions or replace them by cheaper ones:
+    //
+    //  unreachable-code     instructions following a return
+    //  dead-move            mov whose destination is written again before being read, or equals its source
+    //  constant-operand     ldk into a register only the next instruction reads, which takes the constant instead
+    //  constant-conversion  ldk of an int followed by its conversion to a float, which loads the float instead
+    //  return-constant      ldk into a register that retv returns, which becomes a retk of the constant
+    //  double-negation      unm of a register holding a negation, which copies the original value instead
+    //  reserve-merge        rsv followed by another one, which reserve the sum instead
+    std::span<const PeepholeRule> get_peephole_rules();
+    constexpr std::size_t PEEPHOLE_RULE_COUNT = 7;
+
+    // Matches of each rule of get_peephole_rules() and the size of the code before and after the pass, summed over
+    // every Environment::compile() on the current thread that ran it. Benchmarks read it to profile the rules on
+    // exactly the code the library generates.
+    class PeepholeProfile
+    {
+    public:
+        static PeepholeProfile& get();
+
+        void record(std::span<const std::uint64_t> hit_counts, std::size_t code_size_before,
+            std::size_t code_size_after);
+
+        std::span<const std::uint64_t> get_hit_counts() const { return m_hit_counts; }
+        std::size_t get_code_size_before() const { return m_code_size_before; }
+        std::size_t get_code_size_after() const { return m_code_size_after; }
+
+        void reset() { *this = {}; }
+    private:
+        StaticArray<std::uint64_t, PEEPHOLE_RULE_COUNT> m_hit_counts = {};
+        std::size_t m_code_size_before = 0;
+        std::size_t m_code_size_after = 0;
+    };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,310 @@
+#include "Verifier.hpp"
+
+#include "Utils/Format.hpp"
+#include "Utils/IntRange.hpp"
+
+namespace wf
+{
+    enum class ValueType : std::uint8_t
+    {
+        // Registers not written yet may be read as any type, as may the operands of instructions that only copy
+        // or return a value.
+        ANY, INT, FLOAT, STRING,
+    };
+
+    static std::string_view value_type_to_string(ValueType type)
+    {
+        switch(type)
+        {
+            case ValueType::ANY: return "any value";
+            case ValueType::INT: return "an Int";
+            case ValueType::FLOAT: return "a Float";
+            case ValueType::STRING: return "a String";
+        }
+        return "";
+    }
+
+    static ValueType get_constant_value_type(ConstantType type)
+    {
+        switch(type)
+        {
+            case ConstantType::INT: return ValueType::INT;
+            case ConstantType::FLOAT: return ValueType::FLOAT;
+            case ConstantType::STRING: return ValueType::STRING;
+        }
+        return ValueType::ANY;
+    }
+
+    // Types an instruction reads its register and constant operands as, and writes its destination as. mov and
+    // ldk write the type of the value they copy.
+    struct OperandTypes
+    {
+        ValueType read;
+        ValueType written;
+    };
+
+    static OperandTypes get_operand_types(Opcode opcode)
+    {
+        switch(opcode)
+        {
+            case Opcode::NO_OP:
+            case Opcode::WIDE:
+            case Opcode::RETURN:
+            case Opcode::RETURN_VALUE:
+            case Opcode::RETURN_CONSTANT:
+            case Opcode::RESERVE:
+            case Opcode::MOVE:
+            case Opcode::LOAD_CONSTANT:
+                return { ValueType::ANY, ValueType::ANY };
+            case Opcode::NEGATION_INT:
+            case Opcode::ADD_INT:
+            case Opcode::SUBTRACT_INT:
+            case Opcode::MULTIPLY_INT:
+            case Opcode::DIVIDE_INT:
+            case Opcode::MODULO_INT:
+            case Opcode::ADD_INT_RK:
+            case Opcode::SUBTRACT_INT_RK:
+            case Opcode::MULTIPLY_INT_RK:
+            case Opcode::DIVIDE_INT_RK:
+            case Opcode::MODULO_INT_RK:
+            case Opcode::SUBTRACT_INT_KR:
+            case Opcode::DIVIDE_INT_KR:
+            case Opcode::MODULO_INT_KR:
+            case Opcode::ADD_INT_RI:
+            case Opcode::SUBTRACT_INT_RI:
+            case Opcode::MULTIPLY_INT_RI:
+            case Opcode::SHIFT_LEFT_INT_RI:
+            case Opcode::SHIFT_RIGHT_INT_RI:
+            case Opcode::AND_INT_RK:
+            case Opcode::DIVIDE_INT_MAGIC:
+            case Opcode::MODULO_INT_MAGIC:
+            case Opcode::DIVIDE_INT_NOCHECK:
+            case Opcode::MODULO_INT_NOCHECK:
+                return { ValueType::INT, ValueType::INT };
+            case Opcode::NEGATION_FLOAT:
+            case Opcode::ADD_FLOAT:
+            case Opcode::SUBTRACT_FLOAT:
+            case Opcode::MULTIPLY_FLOAT:
+            case Opcode::DIVIDE_FLOAT:
+            case Opcode::ADD_FLOAT_RK:
+            case Opcode::SUBTRACT_FLOAT_RK:
+            case Opcode::MULTIPLY_FLOAT_RK:
+            case Opcode::DIVIDE_FLOAT_RK:
+            case Opcode::SUBTRACT_FLOAT_KR:
+            case Opcode::DIVIDE_FLOAT_KR:
+            case Opcode::FMA_FLOAT:
+                return { ValueType::FLOAT, ValueType::FLOAT };
+            case Opcode::INT_TO_FLOAT:
+                return { ValueType::INT, ValueType::FLOAT };
+            case Opcode::FLOAT_TO_INT:
+                return { ValueType::FLOAT, ValueType::INT };
+        }
+        return { ValueType::ANY, ValueType::ANY };
+    }
+
+    // Range of the int an instruction writes, from the ranges of the registers it reads. Instructions that do not
+    // write an int write any value.
+    static IntRange get_written_range(const WideInstruction& instruction, std::span<const IntRange> register_ranges,
+            std::span<const Value> constants)
+    {
+        const auto reg = [&](std::uint32_t operand) { return register_ranges[operand]; };
+        const auto constant = [&](std::uint32_t operand) {
+            return IntRange{ constants[operand].as_int, constants[operand].as_int };
+        };
+        const auto value = [](UInt value) { return IntRange{ value, value }; };
+        const UInt immediate = static_cast<UInt>(static_cast<Int>(instruction.get_op_sc()));
+        // Adding a negative immediate subtracts its magnitude, and the other way around.
+        const bool is_negative_immediate = instruction.get_op_sc() < 0;
+
+        switch(instruction.get_opcode())
+        {
+            case Opcode::MOVE: return reg(instruction.get_op_d());
+            case Opcode::LOAD_CONSTANT: return constant(instruction.get_op_d());
+            case Opcode::NEGATION_INT: return negate_range(reg(instruction.get_op_d()));
+            case Opcode::ADD_INT: return add_ranges(reg(instruction.get_op_b()), reg(instruction.get_op_c()));
+            case Opcode::SUBTRACT_INT: return subtract_ranges(reg(instruction.get_op_b()), reg(instruction.get_op_c()));
+            case Opcode::MULTIPLY_INT: return multiply_ranges(reg(instruction.get_op_b()), reg(instruction.get_op_c()));
+            case Opcode::DIVIDE_INT:
+            case Opcode::DIVIDE_INT_NOCHECK:
+                return divide_ranges(reg(instruction.get_op_b()), reg(instruction.get_op_c()));
+            case Opcode::MODULO_INT:
+            case Opcode::MODULO_INT_NOCHECK:
+                return modulo_ranges(reg(instruction.get_op_b()), reg(instruction.get_op_c()));
+            case Opcode::ADD_INT_RK: return add_ranges(reg(instruction.get_op_b()), constant(instruction.get_op_c()));
+            case Opcode::SUBTRACT_INT_RK:
+                return subtract_ranges(reg(instruction.get_op_b()), constant(instruction.get_op_c()));
+            case Opcode::MULTIPLY_INT_RK:
+                return multiply_ranges(reg(instruction.get_op_b()), constant(instruction.get_op_c()));
+            case Opcode::DIVIDE_INT_RK:
+                return divide_ranges(reg(instruction.get_op_b()), constant(instruction.get_op_c()));
+            case Opcode::MODULO_INT_RK:
+                return modulo_ranges(reg(instruction.get_op_b()), constant(instruction.get_op_c()));
+            case Opcode::SUBTRACT_INT_KR:
+                return subtract_ranges(constant(instruction.get_op_b()), reg(instruction.get_op_c()));
+            case Opcode::DIVIDE_INT_KR:
+                return divide_ranges(constant(instruction.get_op_b()), reg(instruction.get_op_c()));
+            case Opcode::MODULO_INT_KR:
+                return modulo_ranges(constant(instruction.get_op_b()), reg(instruction.get_op_c()));
+            case Opcode::ADD_INT_RI:
+            case Opcode::SUBTRACT_INT_RI:
+            {
+                const IntRange magnitude = value(is_negative_immediate? 0 - immediate : immediate);
+                if((instruction.get_opcode() == Opcode::ADD_INT_RI) != is_negative_immediate)
+                {
+                    return add_ranges(reg(instruction.get_op_b()), magnitude);
+                }
+                return subtract_ranges(reg(instruction.get_op_b()), magnitude);
+            }
+            case Opcode::MULTIPLY_INT_RI: return multiply_ranges(reg(instruction.get_op_b()), value(immediate));
+            case Opcode::SHIFT_LEFT_INT_RI:
+                return multiply_ranges(reg(instruction.get_op_b()), value(UInt(1) << (instruction.get_op_c() & 63)));
+            case Opcode::SHIFT_RIGHT_INT_RI:
+                return divide_ranges(reg(instruction.get_op_b()), value(UInt(1) << (instruction.get_op_c() & 63)));
+            case Opcode::AND_INT_RK:
+            {
+                // A mask of the low bits takes the remainder of a division by a power of two.
+                const UInt mask = constants[instruction.get_op_c()].as_int;
+                const IntRange lhs = reg(instruction.get_op_b());
+                if((mask & (mask + 1)) == 0 && mask + 1 != 0) return modulo_ranges(lhs, value(mask + 1));
+                return { 0, std::min(lhs.max, mask) };
+            }
+            case Opcode::DIVIDE_INT_MAGIC:
+                return divide_ranges(reg(instruction.get_op_b()), constant(instruction.get_op_c()));
+            case Opcode::MODULO_INT_MAGIC:
+                return modulo_ranges(reg(instruction.get_op_b()), constant(instruction.get_op_c()));
+            default:
+                return {};
+        }
+    }
+
+    bool verify_bytecode(std::span<const Instruction> code, std::span<const ConstantType> constant_types,
+            std::span<const Value> constants, std::uint32_t& frame_size, String& error)
+    {
+        const std::size_t constant_count = constants.size();
+        std::uint32_t register_count = 0;
+        DynamicArray<ValueType> register_types(error.get_allocator().get_state());
+        DynamicArray<IntRange> register_ranges(error.get_allocator().get_state());
+        // Code following a return never runs, so only its operand bounds are checked.
+        bool is_reachable = true;
+
+        for(std::size_t i = 0; i < code.size(); i++)
+        {
+            const bool is_first_instruction = i == 0;
+
+            if(code[i].get_opcode() == Opcode::WIDE
+                && (i + 1 == code.size() || code[i + 1].get_opcode() == Opcode::WIDE))
+            {
+                format_to(error, "instruction {}: wide must be followed by another instruction", i);
+                return false;
+            }
+
+            const WideInstruction instruction = WideInstruction::decode(code, i);
+            if(to_underlying(instruction.get_opcode()) >= OPCODE_COUNT)
+            {
+                format_to(error, "instruction {}: unknown opcode {}", i, to_underlying(instruction.get_opcode()));
+                return false;
+            }
+
+            if((instruction.get_opcode() == Opcode::RESERVE) != is_first_instruction)
+            {
+                format_to(error, "instruction {}: code must start with, and only contain one, rsv", i);
+                return false;
+            }
+
+            if(instruction.get_opcode() == Opcode::RESERVE)
+            {
+                register_count = instruction.get_op_long();
+                register_types.assign(register_count, ValueType::ANY);
+                register_ranges.assign(register_count, IntRange());
+                continue;
+            }
+
+            const Opcode opcode = instruction.get_opcode();
+            const OperandTypes types = get_operand_types(opcode);
+            // Type of the value a mov or ldk copies.
+            ValueType copied_type = ValueType::ANY;
+
+            auto check_operand = [&](OperandKind kind, std::uint32_t operand, bool is_read) {
+                if(kind == OperandKind::REGISTER && operand >= register_count)
+                {
+                    format_to(error, "instruction {}: register {} is not reserved", i, operand);
+                    return false;
+                }
+                if(kind == OperandKind::CONSTANT && operand >= constant_count)
+                {
+                    format_to(error, "instruction {}: constant {} does not exist", i, operand);
+                    return false;
+                }
+
+                if(!is_reachable || !is_read) return true;
+
+                ValueType type = ValueType::ANY;
+                if(kind == OperandKind::REGISTER) type = register_types[operand];
+                if(kind == OperandKind::CONSTANT) type = get_constant_value_type(constant_types[operand]);
+                copied_type = type;
+
+                if(type != ValueType::ANY && types.read != ValueType::ANY && type != types.read)
+                {
+                    format_to(error, "instruction {}: {} {} holds {}, not {}", i,
+                        kind == OperandKind::REGISTER? "register" : "constant", operand, value_type_to_string(type),
+                        value_type_to_string(types.read));
+                    return false;
+                }
+                return true;
+            };
+
+            const OperandLayout layout = get_operand_layout(opcode);
+            if(!check_operand(layout.a, instruction.get_op_a(), reads_op_a(opcode))
+                || !check_operand(layout.b, instruction.get_op_b(), true)
+                || !check_operand(layout.c, instruction.get_op_c(), true)
+                || !check_operand(layout.d, instruction.get_op_d(), true))
+            {
+                return false;
+            }
+
+            if(opcode == Opcode::DIVIDE_INT_MAGIC || opcode == Opcode::MODULO_INT_MAGIC)
+            {
+                const std::uint32_t divisor = instruction.get_op_c();
+                if(divisor + 1 >= constant_count || constant_types[divisor + 1] != ConstantType::INT
+                    || constants[divisor].as_int < 2
+                    || constants[divisor + 1].as_int != get_division_magic(constants[divisor].as_int))
+                {
+                    format_to(error, "instruction {}: constant {} is not a divisor followed by its magic number", i,
+                        divisor);
+                    return false;
+                }
+            }
+
+            // Divisions that do not check their divisor need one the same rules the compiler used prove non-zero.
+            if(is_reachable && (opcode == Opcode::DIVIDE_INT_NOCHECK || opcode == Opcode::MODULO_INT_NOCHECK)
+                && !register_ranges[instruction.get_op_c()].excludes_zero())
+            {
+                format_to(error, "instruction {}: unchecked divisor register {} may hold 0", i,
+                    instruction.get_op_c());
+                return false;
+            }
+
+            if(layout.a == OperandKind::REGISTER && opcode != Opcode::RETURN_VALUE)
+            {
+                register_types[instruction.get_op_a()] = types.written == ValueType::ANY? copied_type : types.written;
+                register_ranges[instruction.get_op_a()] = get_written_range(instruction, register_ranges, constants);
+            }
+
+            if(opcode == Opcode::RETURN || opcode == Opcode::RETURN_VALUE || opcode == Opcode::RETURN_CONSTANT)
+            {
+                is_reachable = false;
+            }
+        }
+
+        const Opcode last_opcode = code.empty()? Opcode::NO_OP : code.back().get_opcode();
+        if(last_opcode != Opcode::RETURN && last_opcode != Opcode::RETURN_VALUE
+            && last_opcode != Opcode::RETURN_CONSTANT)
+        {
+            format_to(error, "code must end with a return");
+            return false;
+        }
+
+        frame_size = register_count;
+        return true;
+    }
+}
\ No newline at end of file
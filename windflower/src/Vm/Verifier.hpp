@@ -0,0 +1,23 @@
+#ifndef WF_VERIFIER_HPP
+#define WF_VERIFIER_HPP
+
+#include <span>
+
+#include "Object.hpp"
+#include "Utils/String.hpp"
+
+namespace wf
+{
+    // Checks that code is safe to run by a Vm that does not check anything itself. The code must reserve its
+    // registers up front with a single rsv and only access reserved registers and existing constants. Every
+    // register and constant an instruction reads must hold the type the instruction expects, and registers not
+    // written yet may be read as either. Divisions that do not check their divisor need a divisor register the
+    // rules of IntRange prove non-zero. The code must end with a return, which is enough for it to terminate
+    // since code never branches.
+    //
+    // Returns the number of registers the code reserves in `frame_size`, or false and a message in `error`.
+    bool verify_bytecode(std::span<const Instruction> code, std::span<const ConstantType> constant_types,
+            std::span<const Value> constants, std::uint32_t& frame_size, String& error);
+}
+
+#endif
\ No newline at end of file
@@ -1,158 +1,347 @@
 #include "Vm.hpp"
 
+#include <cassert>
+#include <cmath>
+
 #include "State.hpp"
+#include "Vm/Aot.hpp"
+#include "Vm/BatchVm.hpp"
+#include "Vm/OpcodeProfile.hpp"
 #include "Utils/Format.hpp"
 
+// Dispatch strategy for Vm::run(), selected at build time (see the "vm-dispatch" option in premake5.lua):
+//  - WF_VM_DISPATCH_COMPUTED_GOTO: direct threading through a label table (GCC/Clang only).
+//  - WF_VM_DISPATCH_TAIL_CALL: one function per opcode, chained through guaranteed tail calls (Clang only).
+//  - Neither: a portable switch inside a loop.
+#if defined(WF_VM_DISPATCH_TAIL_CALL)
+    #if !defined(__has_cpp_attribute) || !__has_cpp_attribute(clang::musttail)
+        #error "WF_VM_DISPATCH_TAIL_CALL requires a compiler that supports [[clang::musttail]]."
+    #endif
+    #define WF_VM_MUSTTAIL [[clang::musttail]]
+#elif defined(WF_VM_DISPATCH_COMPUTED_GOTO)
+    #if !defined(__GNUC__)
+        #error "WF_VM_DISPATCH_COMPUTED_GOTO requires a compiler that supports labels as values."
+    #endif
+#endif
+
+// Every fetched instruction is passed to WF_VM_PROFILE, which counts opcode pairs in profiling builds.
+#if defined(WF_VM_PROFILE_PAIRS)
+    #define WF_VM_PROFILE(instruction) OpcodePairProfile::get().record((instruction).get_opcode())
+#else
+    #define WF_VM_PROFILE(instruction) ((void)0)
+#endif
+
+// Operands are read through WF_VM_OPERANDS, which is `instruction` itself or, for the second copy of
+// the handlers that runs instructions following a WIDE prefix, the prefix and instruction combined.
+#define WF_VM_OP_A WF_VM_OPERANDS.get_op_a()
+#define WF_VM_OP_B WF_VM_OPERANDS.get_op_b()
+#define WF_VM_OP_C WF_VM_OPERANDS.get_op_c()
+#define WF_VM_OP_SC WF_VM_OPERANDS.get_op_sc()
+#define WF_VM_OP_D WF_VM_OPERANDS.get_op_d()
+#define WF_VM_OP_LONG WF_VM_OPERANDS.get_op_long()
+#define WF_VM_WIDE_OPERANDS WideInstruction(ip[-2], instruction)
+
 namespace wf
 {
     void Vm::call(std::size_t idx, std::size_t return_idx)
     {
         BytecodeObject* function = m_state->stack.index(idx).as_bytecode();
+        // None of the ways code is run checks its operands or types, see verify_bytecode().
+        assert(function->is_verified);
+        m_entry_frame_count = m_state->stack.get_frame_count();
+
+        if(!function->is_aot_function_resolved)
+        {
+            function->aot_function = AotRegistration::find(function);
+            function->is_aot_function_resolved = true;
+        }
+
+        if(function->aot_function != nullptr)
+        {
+            run_aot(function, return_idx);
+            return;
+        }
+
+        if(m_state->jit_enabled)
+        {
+            if(function->jit_code.status == JitStatus::NOT_COMPILED)
+            {
+                jit_compile(m_state, function);
+            }
+
+            if(function->jit_code.status == JitStatus::COMPILED)
+            {
+                run_jit(function, return_idx);
+                return;
+            }
+        }
+
         m_state->stack.push_frame(function, m_ip, return_idx);
 
         run();
     }
 
+    template<typename T>
+    void Vm::call_batch(std::size_t idx, T* output_column, std::size_t n)
+    {
+        BytecodeObject* function = m_state->stack.index(idx).as_bytecode();
+        assert(function->is_verified);
+        m_entry_frame_count = m_state->stack.get_frame_count();
+        m_state->stack.push_frame(function, m_ip, 0);
+
+        BatchVm batch_vm(m_state, function);
+        std::size_t error_row = 0;
+        const std::size_t error_offset = batch_vm.run(output_column, n, error_row);
+        if(error_offset != 0)
+        {
+            error(function->code.data() + error_offset,
+                format(m_state, "Cannot divide an integer by 0 in row {}.", error_row));
+        }
+
+        m_state->stack.pop_frame();
+    }
+
+    template void Vm::call_batch<Int>(std::size_t idx, Int* output_column, std::size_t n);
+    template void Vm::call_batch<Float>(std::size_t idx, Float* output_column, std::size_t n);
+
+    void Vm::run_jit(BytecodeObject* function, std::size_t return_idx)
+    {
+        // The return slot is relative to the caller's frame.
+        Value* const return_slot = &m_state->stack.index(return_idx);
+        m_state->stack.push_frame(function, m_ip, return_idx);
+        if(!m_state->stack.reserve(function->frame_size))
+        {
+            error(function->code.data() + 1, String("Stack overflow.", m_state));
+        }
+
+        const std::size_t error_offset = function->jit_code.entry(m_state->stack.get_frame_base(),
+                function->constants.data(), return_slot);
+        if(error_offset != 0)
+        {
+            error(function->code.data() + error_offset, String("Cannot divide an integer by 0.", m_state));
+        }
+
+        m_state->stack.pop_frame();
+    }
+
+    void Vm::run_aot(BytecodeObject* function, std::size_t return_idx)
+    {
+        Value* const return_slot = &m_state->stack.index(return_idx);
+        m_state->stack.push_frame(function, m_ip, return_idx);
+
+        const std::size_t error_offset = function->aot_function(&return_slot->as_int);
+        if(error_offset != 0)
+        {
+            error(function->code.data() + error_offset, String("Cannot divide an integer by 0.", m_state));
+        }
+
+        m_state->stack.pop_frame();
+    }
+
+#if defined(WF_VM_DISPATCH_TAIL_CALL)
+    struct Vm::TailCallHandlers
+    {
+        using Handler = void(*)(Vm& vm, Value* frame, const Instruction* ip, const Value* constants,
+                Instruction instruction);
+        static const StaticArray<Handler, OPCODE_COUNT> handlers;
+        static const StaticArray<Handler, OPCODE_COUNT> wide_handlers;
+
+        #define WF_VM_DISPATCH()                                                                            \
+            do                                                                                              \
+            {                                                                                               \
+                const Instruction next = *ip++;                                                             \
+                WF_VM_PROFILE(next);                                                                        \
+                WF_VM_MUSTTAIL return handlers[to_underlying(next.get_opcode())](vm, frame, ip, constants, next); \
+            } while(false)
+
+        #define WF_VM_TARGET(opcode)                                                                        \
+            static void handle_##opcode([[maybe_unused]] Vm& vm, [[maybe_unused]] Value* frame,           \
+                [[maybe_unused]] const Instruction* ip, [[maybe_unused]] const Value* constants,            \
+                [[maybe_unused]] Instruction instruction)
+        #define WF_VM_DISPATCH_WIDE()                                                                       \
+            do                                                                                              \
+            {                                                                                               \
+                const Instruction next = *ip++;                                                             \
+                WF_VM_PROFILE(next);                                                                        \
+                WF_VM_MUSTTAIL return wide_handlers[to_underlying(next.get_opcode())](vm, frame, ip, constants, next); \
+            } while(false)
+        #define WF_VM_OPERANDS instruction
+
+        #include "OpcodeHandlers.inl"
+
+        #undef WF_VM_TARGET
+        #undef WF_VM_DISPATCH_WIDE
+        #undef WF_VM_OPERANDS
+
+        // A WIDE prefix is never followed by another one, a stray prefix is skipped.
+        #define WF_VM_TARGET(opcode)                                                                        \
+            static void handle_wide_##opcode([[maybe_unused]] Vm& vm, [[maybe_unused]] Value* frame,      \
+                [[maybe_unused]] const Instruction* ip, [[maybe_unused]] const Value* constants,            \
+                [[maybe_unused]] Instruction instruction)
+        #define WF_VM_DISPATCH_WIDE() WF_VM_DISPATCH()
+        #define WF_VM_OPERANDS WF_VM_WIDE_OPERANDS
+
+        #include "OpcodeHandlers.inl"
+
+        #undef WF_VM_TARGET
+        #undef WF_VM_DISPATCH_WIDE
+        #undef WF_VM_OPERANDS
+        #undef WF_VM_DISPATCH
+    };
+
+    #define WF_VM_HANDLER_ENTRY(opcode) { Opcode::opcode, &Vm::TailCallHandlers::handle_##opcode },
+    const StaticArray<Vm::TailCallHandlers::Handler, OPCODE_COUNT> Vm::TailCallHandlers::handlers
+        = arr_from_designators<Vm::TailCallHandlers::Handler, OPCODE_COUNT, Opcode>({
+            WF_FOR_EACH_OPCODE(WF_VM_HANDLER_ENTRY)
+        });
+    #undef WF_VM_HANDLER_ENTRY
+
+    #define WF_VM_HANDLER_ENTRY(opcode) { Opcode::opcode, &Vm::TailCallHandlers::handle_wide_##opcode },
+    const StaticArray<Vm::TailCallHandlers::Handler, OPCODE_COUNT> Vm::TailCallHandlers::wide_handlers
+        = arr_from_designators<Vm::TailCallHandlers::Handler, OPCODE_COUNT, Opcode>({
+            WF_FOR_EACH_OPCODE(WF_VM_HANDLER_ENTRY)
+        });
+    #undef WF_VM_HANDLER_ENTRY
+#endif
+
     void Vm::run()
     {
-        m_ip = 0;
+        // The interpreter state lives in locals (or handler arguments) so that operand access is a
+        // single indexed load. They must be reloaded whenever the active frame changes.
+        BytecodeObject* const function = m_state->stack.get_frame_function();
+        Value* frame = m_state->stack.get_frame_base();
+        const Instruction* ip = function->code.data();
+        const Value* constants = function->constants.data();
+
+#if defined(WF_VM_PROFILE_PAIRS)
+        OpcodePairProfile::get().begin_function();
+#endif
+
+#if defined(WF_VM_DISPATCH_TAIL_CALL)
+        const Instruction first = *ip++;
+        WF_VM_PROFILE(first);
+        TailCallHandlers::handlers[to_underlying(first.get_opcode())](*this, frame, ip, constants, first);
+#elif defined(WF_VM_DISPATCH_COMPUTED_GOTO)
+        Vm& vm = *this;
+        Instruction instruction;
+
+        #define WF_VM_LABEL_ENTRY(opcode) { Opcode::opcode, &&target_##opcode },
+        static const auto targets = arr_from_designators<void*, OPCODE_COUNT, Opcode>({
+            WF_FOR_EACH_OPCODE(WF_VM_LABEL_ENTRY)
+        });
+        #undef WF_VM_LABEL_ENTRY
+
+        #define WF_VM_LABEL_ENTRY(opcode) { Opcode::opcode, &&wide_target_##opcode },
+        static const auto wide_targets = arr_from_designators<void*, OPCODE_COUNT, Opcode>({
+            WF_FOR_EACH_OPCODE(WF_VM_LABEL_ENTRY)
+        });
+        #undef WF_VM_LABEL_ENTRY
+
+        #define WF_VM_DISPATCH()                                                \
+            do                                                                  \
+            {                                                                   \
+                instruction = *ip++;                                            \
+                WF_VM_PROFILE(instruction);                                     \
+                goto *targets[to_underlying(instruction.get_opcode())];         \
+            } while(false)
+
+        WF_VM_DISPATCH();
+
+        #define WF_VM_TARGET(opcode) target_##opcode:
+        #define WF_VM_DISPATCH_WIDE()                                           \
+            do                                                                  \
+            {                                                                   \
+                instruction = *ip++;                                            \
+                WF_VM_PROFILE(instruction);                                     \
+                goto *wide_targets[to_underlying(instruction.get_opcode())];    \
+            } while(false)
+        #define WF_VM_OPERANDS instruction
+
+        #include "OpcodeHandlers.inl"
+
+        #undef WF_VM_TARGET
+        #undef WF_VM_DISPATCH_WIDE
+        #undef WF_VM_OPERANDS
+
+        // A WIDE prefix is never followed by another one, a stray prefix is skipped.
+        #define WF_VM_TARGET(opcode) wide_target_##opcode:
+        #define WF_VM_DISPATCH_WIDE() WF_VM_DISPATCH()
+        #define WF_VM_OPERANDS WF_VM_WIDE_OPERANDS
+
+        #include "OpcodeHandlers.inl"
+
+        #undef WF_VM_TARGET
+        #undef WF_VM_DISPATCH_WIDE
+        #undef WF_VM_OPERANDS
+        #undef WF_VM_DISPATCH
+#else
+        Vm& vm = *this;
+
+        #define WF_VM_TARGET(opcode) case Opcode::opcode:
+        #define WF_VM_DISPATCH() continue
+
         while(true)
         {
-            Instruction instruction = m_state->stack.get_frame_function()->code[m_ip++];
+            Instruction instruction = *ip++;
+            WF_VM_PROFILE(instruction);
+
+            #define WF_VM_DISPATCH_WIDE() goto dispatch_wide
+            #define WF_VM_OPERANDS instruction
 
             switch(instruction.get_opcode())
             {
-                case Opcode::NO_OP:
-                    break;
-                case Opcode::RESERVE:
-                    m_state->stack.reserve(instruction.get_op_long());
-                    break;
-                case Opcode::RETURN:
-                    m_ip = m_state->stack.get_saved_ip();
-                    m_state->stack.pop_frame();
-                    return;
-                case Opcode::RETURN_VALUE:
-                {
-                    const std::size_t saved_return_idx = m_state->stack.get_return_idx();
-                    const Value return_value = m_state->stack.index(instruction.get_op_long());
-
-                    m_ip = m_state->stack.get_saved_ip();
-                    m_state->stack.pop_frame();
-                    m_state->stack.index(saved_return_idx) = return_value;
-                    return;
-                }
-                case Opcode::MOVE:
-                    m_state->stack.index(instruction.get_op_a()) = m_state->stack.index(instruction.get_op_b());
-                    break;
-                case Opcode::LOAD_CONSTANT:
-                    m_state->stack.index(instruction.get_op_a())
-                        = m_state->stack.get_frame_function()->constants[instruction.get_op_b()];
-                    break;
-                case Opcode::NEGATION_INT:
-                {
-                    Value& value = m_state->stack.index(instruction.get_op_long());
-                    value.as_int = -static_cast<UInt>(static_cast<Int>(value.as_int));
-                    break;
-                }
-                case Opcode::NEGATION_FLOAT:
-                {
-                    Value& value = m_state->stack.index(instruction.get_op_long());
-                    value.as_float = -value.as_float;
-                    break;
-                }
-                case Opcode::INT_TO_FLOAT:
-                {
-                    Value& value = m_state->stack.index(instruction.get_op_long());
-                    value.as_float = static_cast<Float>(static_cast<Int>(value.as_int));
-                    break;
-                }
-                case Opcode::FLOAT_TO_INT:
-                {
-                    Value& value = m_state->stack.index(instruction.get_op_long());
-                    value.as_int = static_cast<UInt>(static_cast<Int>(value.as_float));
-                    break;
-                }
-                case Opcode::ADD_INT:
-                    m_state->stack.index(instruction.get_op_a()).as_int
-                        += m_state->stack.index(instruction.get_op_b()).as_int;
-                    break;
-                case Opcode::SUBTRACT_INT:
-                    m_state->stack.index(instruction.get_op_a()).as_int
-                        -= m_state->stack.index(instruction.get_op_b()).as_int;
-                    break;
-                case Opcode::MULTIPLY_INT:
-                    m_state->stack.index(instruction.get_op_a()).as_int
-                        *= m_state->stack.index(instruction.get_op_b()).as_int;
-                    break;
-                case Opcode::DIVIDE_INT:
-                {
-                    const Value& rhs_value = m_state->stack.index(instruction.get_op_b());
-
-                    if(rhs_value.as_int == 0)
-                    {
-                        error(String("Cannot divide an integer by 0.", m_state));
-                    }
-
-                    m_state->stack.index(instruction.get_op_a()).as_int
-                        /= rhs_value.as_int;
-                    break;
-                }
-                case Opcode::MODULO_INT:
-                {
-                    const Value& rhs_value = m_state->stack.index(instruction.get_op_b());
-
-                    if(rhs_value.as_int == 0)
-                    {
-                        error(String("Cannot divide an integer by 0.", m_state));
-                    }
-
-                    m_state->stack.index(instruction.get_op_a()).as_int
-                        %= rhs_value.as_int;
-                    break;
-                }
-                case Opcode::ADD_FLOAT:
-                    m_state->stack.index(instruction.get_op_a()).as_float
-                        += m_state->stack.index(instruction.get_op_b()).as_float;
-                    break;
-                case Opcode::SUBTRACT_FLOAT:
-                    m_state->stack.index(instruction.get_op_a()).as_float
-                        -= m_state->stack.index(instruction.get_op_b()).as_float;
-                    break;
-                case Opcode::MULTIPLY_FLOAT:
-                    m_state->stack.index(instruction.get_op_a()).as_float
-                        *= m_state->stack.index(instruction.get_op_b()).as_float;
-                    break;
-                case Opcode::DIVIDE_FLOAT:
-                    m_state->stack.index(instruction.get_op_a()).as_float
-                        /= m_state->stack.index(instruction.get_op_b()).as_float;
-                    break;
+                #include "OpcodeHandlers.inl"
             }
-        }
-    }
 
-    std::uint16_t Vm::get_current_line() const
-    {
-        std::size_t current_line_offset = 0;
-        std::uint16_t current_line = 0;
-        for(const BytecodeLineInfo& line_info : m_state->stack.get_frame_function()->line_info)
-        {
-            if(line_info.offset < m_ip && line_info.offset > current_line_offset)
+            #undef WF_VM_DISPATCH_WIDE
+            #undef WF_VM_OPERANDS
+
+        dispatch_wide:
+            instruction = *ip++;
+            WF_VM_PROFILE(instruction);
+
+            // A WIDE prefix is never followed by another one, a stray prefix is skipped.
+            #define WF_VM_DISPATCH_WIDE() WF_VM_DISPATCH()
+            #define WF_VM_OPERANDS WF_VM_WIDE_OPERANDS
+
+            switch(instruction.get_opcode())
             {
-                current_line_offset = line_info.offset;
-                current_line = line_info.line;
+                #include "OpcodeHandlers.inl"
             }
+
+            #undef WF_VM_DISPATCH_WIDE
+            #undef WF_VM_OPERANDS
         }
 
-        return current_line;
+        #undef WF_VM_TARGET
+        #undef WF_VM_DISPATCH
+#endif
     }
 
-    void Vm::error(const String& message)
+    std::uint32_t Vm::get_current_line() const
     {
-        const std::uint16_t current_line = get_current_line();
+        const BytecodeObject* function = m_state->stack.get_frame_function();
+        const std::size_t ip_offset = static_cast<std::size_t>(m_ip - function->code.data());
+
+        // The instruction pointer has already moved past the instruction being executed.
+        if(ip_offset == 0) return 0;
+        return function->line_table.get_line(ip_offset - 1);
+    }
+
+    void Vm::error(const Instruction* ip, const String& message)
+    {
+        m_ip = ip;
+        const std::uint32_t current_line = get_current_line();
+
+        while(m_state->stack.get_frame_count() > m_entry_frame_count)
+        {
+            m_ip = m_state->stack.get_saved_ip();
+            m_state->stack.pop_frame();
+        }
 
         if(current_line == 0)
         {
-            throw VmError(format(m_state, "runtime error(\?\?\?): {}", current_line, message));
+            throw VmError(format(m_state, "runtime error(\?\?\?): {}", message));
         }
         else
         {
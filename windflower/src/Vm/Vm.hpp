@@ -35,15 +35,28 @@ namespace wf
         Vm(State* state) : m_state(state) {};
 
         void call(std::size_t idx, std::size_t return_idx);
+
+        template<typename T>
+        void call_batch(std::size_t idx, T* output_column, std::size_t n);
     private:
+        struct TailCallHandlers;
+
         State* m_state;
 
-        std::uint64_t m_ip;
+        // Only synchronized with the interpreter's local instruction pointer when a frame is
+        // entered or left, or when an error is raised.
+        const Instruction* m_ip = nullptr;
+        // Frames that were active before the current call, errors unwind the stack back to them.
+        std::size_t m_entry_frame_count = 0;
 
         void run();
+        void run_jit(BytecodeObject* function, std::size_t return_idx);
+        void run_aot(BytecodeObject* function, std::size_t return_idx);
 
-        std::uint16_t get_current_line() const;
-        void error(const String& message);
+        std::uint32_t get_current_line() const;
+        // Throws a VmError for the instruction before `ip` after popping every frame of the current call, which
+        // leaves the Environment usable.
+        [[noreturn]] void error(const Instruction* ip, const String& message);
     };
 }
 
@@ -1,10 +1,100 @@
 #include "VmStack.hpp"
 
 #include <cassert>
+#include <new>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
 
 namespace wf
 {
-    void VmStack::push_frame(BytecodeObject* function, std::uint64_t saved_ip,std::size_t return_idx)
+    static std::size_t get_page_size()
+    {
+#if defined(_WIN32)
+        SYSTEM_INFO system_info;
+        GetSystemInfo(&system_info);
+        return system_info.dwPageSize;
+#else
+        return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    }
+
+    static std::size_t round_to_pages(std::size_t size, std::size_t page_size)
+    {
+        return (size + page_size - 1) / page_size * page_size;
+    }
+
+    // Reserves `size` bytes of inaccessible address space.
+    static void* reserve_address_space(std::size_t size)
+    {
+#if defined(_WIN32)
+        void* memory = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+        if(memory == nullptr) throw std::bad_alloc();
+#else
+        void* memory = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if(memory == MAP_FAILED) throw std::bad_alloc();
+#endif
+        return memory;
+    }
+
+    // Makes reserved pages usable. The system only backs them with memory once they are touched.
+    static void make_accessible(void* memory, std::size_t size)
+    {
+#if defined(_WIN32)
+        if(VirtualAlloc(memory, size, MEM_COMMIT, PAGE_READWRITE) == nullptr) throw std::bad_alloc();
+#else
+        if(mprotect(memory, size, PROT_READ | PROT_WRITE) != 0) throw std::bad_alloc();
+#endif
+    }
+
+    static void release_address_space(void* memory, std::size_t size)
+    {
+#if defined(_WIN32)
+        (void)size;
+        VirtualFree(memory, 0, MEM_RELEASE);
+#else
+        munmap(memory, size);
+#endif
+    }
+
+    VmStack::VmStack()
+    {
+        // [frames][guard page][registers][guard page], each array ends right before its guard page.
+        const std::size_t page_size = get_page_size();
+        const std::size_t frames_size = round_to_pages(MAX_FRAME_COUNT * sizeof(StackFrame), page_size);
+        const std::size_t registers_size = round_to_pages(REGISTER_COUNT * sizeof(Value), page_size);
+
+        m_memory_size = frames_size + page_size + registers_size + page_size;
+        m_memory = reserve_address_space(m_memory_size);
+
+        std::byte* const frames_area = static_cast<std::byte*>(m_memory);
+        std::byte* const registers_area = frames_area + frames_size + page_size;
+        try
+        {
+            make_accessible(frames_area, frames_size);
+            make_accessible(registers_area, registers_size);
+        }
+        catch(...)
+        {
+            release_address_space(m_memory, m_memory_size);
+            throw;
+        }
+
+        m_frames = reinterpret_cast<StackFrame*>(frames_area + frames_size) - MAX_FRAME_COUNT;
+        m_registers = reinterpret_cast<Value*>(registers_area + registers_size) - REGISTER_COUNT;
+    }
+
+    VmStack::~VmStack()
+    {
+        release_address_space(m_memory, m_memory_size);
+    }
+
+    void VmStack::push_frame(BytecodeObject* function, const Instruction* saved_ip, std::size_t return_idx)
     {
         std::size_t offset = 0;
 
@@ -32,7 +122,7 @@ namespace wf
         return get_top_frame().function;
     }
 
-    std::size_t VmStack::get_saved_ip() const
+    const Instruction* VmStack::get_saved_ip() const
     {
         return get_top_frame().saved_ip;
     }
@@ -42,9 +132,13 @@ namespace wf
         return get_top_frame().return_idx;
     }
 
-    void VmStack::reserve(std::size_t count)
+    bool VmStack::reserve(std::size_t count)
     {
-        get_top_frame().reserved_register_count += count;
+        StackFrame& frame = get_top_frame();
+        if(count > REGISTER_COUNT - frame.frame_offset - frame.reserved_register_count) return false;
+
+        frame.reserved_register_count += count;
+        return true;
     }
 
     void VmStack::release(std::size_t count)
@@ -68,14 +162,4 @@ namespace wf
         return m_registers[get_top_frame().frame_offset + position];
     }
 
-    StackFrame& VmStack::get_top_frame()
-    {
-        return m_frames[m_active_frame_count - 1];
-    }
-
-    const StackFrame& VmStack::get_top_frame() const
-    {
-        return m_frames[m_active_frame_count - 1];
-    }
-
 }
\ No newline at end of file
@@ -1,8 +1,8 @@
 #ifndef WF_VM_STACK_HPP
 #define WF_VM_STACK_HPP
 
-#include <array>
 #include <cstddef>
+#include <iterator>
 
 #include "Value.hpp"
 #include "Vm/Object.hpp"
@@ -12,55 +12,72 @@ namespace wf
     struct StackFrame
     {
         BytecodeObject* function = nullptr;
-        std::uint64_t saved_ip;
+        const Instruction* saved_ip;
         std::size_t return_idx;
 
         std::size_t reserved_register_count = 0;
         std::size_t frame_offset = 0;
     };
 
+    // The registers and frames live in address space reserved when the stack is created. Pages are only
+    // committed once touched, so an idle Environment costs a few pages. A guard page follows each array and
+    // faults on overflow, which is why neither push_frame() nor index() checks its bounds.
     class VmStack
     {
     public:
         static constexpr std::size_t REGISTER_COUNT = 1024 * 128;
         static constexpr std::size_t MAX_FRAME_COUNT = 256;
 
-        void push_frame(BytecodeObject* function, std::uint64_t saved_ip, std::size_t return_idx);
+        VmStack();
+        VmStack(const VmStack&) = delete;
+        VmStack& operator=(const VmStack&) = delete;
+        ~VmStack();
+
+        void push_frame(BytecodeObject* function, const Instruction* saved_ip, std::size_t return_idx);
         void pop_frame();
+        std::size_t get_frame_count() const { return m_active_frame_count; }
 
         BytecodeObject* get_frame_function() const;
-        std::size_t get_saved_ip() const;
+        const Instruction* get_saved_ip() const;
         std::size_t get_return_idx() const;
 
-        void reserve(std::size_t count);
+        // Pointer to register 0 of the active frame. Only valid until the next push_frame() or pop_frame().
+        Value* get_frame_base() { return m_registers + get_top_frame().frame_offset; }
+
+        // Frames can reserve far more registers than a guard page covers, so reservations are checked here.
+        // Returns false, reserving nothing, if the registers do not fit.
+        bool reserve(std::size_t count);
         void release(std::size_t count);
         std::size_t get_reserved_register_count() const;
 
         Value& index(std::size_t position);
         const Value& index(std::size_t position) const;
 
-        decltype(auto) begin() { return m_registers.begin(); }
-        decltype(auto) begin() const { return m_registers.begin(); }
-        decltype(auto) cbegin() const { return m_registers.cbegin(); }
+        Value* begin() { return m_registers; }
+        const Value* begin() const { return m_registers; }
+        const Value* cbegin() const { return m_registers; }
 
-        decltype(auto) rbegin() { return m_registers.rbegin(); }
-        decltype(auto) rbegin() const { return m_registers.rbegin(); }
-        decltype(auto) crbegin() const { return m_registers.crbegin(); }
+        decltype(auto) rbegin() { return std::make_reverse_iterator(end()); }
+        decltype(auto) rbegin() const { return std::make_reverse_iterator(end()); }
+        decltype(auto) crbegin() const { return std::make_reverse_iterator(cend()); }
 
-        decltype(auto) end() { return m_registers.cend(); }
-        decltype(auto) end() const { return m_registers.cend(); }
-        decltype(auto) cend() const { return m_registers.cend(); }
+        Value* end() { return m_registers + REGISTER_COUNT; }
+        const Value* end() const { return m_registers + REGISTER_COUNT; }
+        const Value* cend() const { return m_registers + REGISTER_COUNT; }
 
-        decltype(auto) rend() { return m_registers.rend(); }
-        decltype(auto) rend() const { return m_registers.rend(); }
-        decltype(auto) crend() const { return m_registers.crend(); }
+        decltype(auto) rend() { return std::make_reverse_iterator(begin()); }
+        decltype(auto) rend() const { return std::make_reverse_iterator(begin()); }
+        decltype(auto) crend() const { return std::make_reverse_iterator(cbegin()); }
     private:
-        std::array<Value, REGISTER_COUNT> m_registers;
-        std::array<StackFrame, MAX_FRAME_COUNT> m_frames;
+        void* m_memory;
+        std::size_t m_memory_size;
+
+        Value* m_registers;
+        StackFrame* m_frames;
         std::size_t m_active_frame_count = 0;
 
-        StackFrame& get_top_frame();
-        const StackFrame& get_top_frame() const;
+        StackFrame& get_top_frame() { return m_frames[m_active_frame_count - 1]; }
+        const StackFrame& get_top_frame() const { return m_frames[m_active_frame_count - 1]; }
     };
 }
 